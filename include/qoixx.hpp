@@ -12,15 +12,29 @@
 #include<numeric>
 #include<array>
 #include<utility>
+#include<algorithm>
+#include<optional>
+#include<ranges>
+#include<atomic>
+#include<chrono>
+#include<span>
 
+// the RVV kernels, and the NEON/SVE kernels for the inputs and entry points added after the original ones, have not been built or run
+// on their targets yet, so they are only selected with QOIXX_EXPERIMENTAL_SIMD
 #ifndef QOIXX_NO_SIMD
 #if defined(__ARM_FEATURE_SVE)
 #include<arm_sve.h>
 #include<arm_neon.h>
 #elif defined(__aarch64__)
 #include<arm_neon.h>
+#elif defined(__riscv_vector) && defined(QOIXX_EXPERIMENTAL_SIMD)
+#include<riscv_vector.h>
 #elif defined(__AVX2__)
 #include<immintrin.h>
+#elif defined(__SSE4_1__)
+#include<smmintrin.h>
+#elif defined(__SSE2__)
+#include<emmintrin.h>
 #endif
 #endif
 
@@ -44,6 +58,178 @@ struct contiguous_puller{
   }
 };
 
+template<typename T, std::size_t N>
+requires(sizeof(T) == 1 && !std::same_as<std::remove_const_t<T>, bool> && (N == 3 || N == 4))
+struct planar_puller{
+  static constexpr bool is_contiguous = false;
+  static constexpr bool is_planar = true;
+  static constexpr std::size_t channels = N;
+  std::array<const T*, N> t;
+  std::size_t c = 0;
+  inline std::uint8_t pull()noexcept{
+    const auto x = static_cast<std::uint8_t>(*t[c]++);
+    if(++c == N)
+      c = 0;
+    return x;
+  }
+  inline std::array<const std::uint8_t*, N> raw_pointer()noexcept{
+    std::array<const std::uint8_t*, N> ptr;
+    for(std::size_t i = 0; i < N; ++i)
+      ptr[i] = reinterpret_cast<const std::uint8_t*>(t[i]);
+    return ptr;
+  }
+  inline void advance(std::size_t n)noexcept{
+    for(auto& x : t)
+      x += n/N;
+  }
+};
+
+template<typename T>
+concept planar_accessor = requires{
+  requires T::is_planar;
+};
+
+template<typename T>
+concept pixel_pusher = requires(T& t, const std::uint8_t* px, std::size_t n){
+  t.template push_pixel<3>(px);
+  t.template fill<3>(px, n);
+};
+
+// a frame read as its XOR with the previous frame, so that the unchanged pixels become zeros
+struct delta_pointer{
+  const std::uint8_t* cur;
+  const std::uint8_t* prev;
+  inline delta_pointer operator+(std::size_t n)const noexcept{
+    return {cur + n, prev + n};
+  }
+};
+
+struct delta_puller{
+  static constexpr bool is_contiguous = false;
+  static constexpr bool is_delta = true;
+  const std::uint8_t* cur;
+  const std::uint8_t* prev;
+  inline std::uint8_t pull()noexcept{
+    return static_cast<std::uint8_t>(*cur++ ^ *prev++);
+  }
+  inline delta_pointer raw_pointer()noexcept{
+    return {cur, prev};
+  }
+  inline void advance(std::size_t n)noexcept{
+    cur += n;
+    prev += n;
+  }
+};
+
+template<typename T>
+concept delta_accessor = requires{
+  requires T::is_delta;
+};
+
+// applies decoded delta pixels onto the previous frame in place; a run of zeros leaves the pixels untouched
+struct delta_pusher{
+  static constexpr bool is_contiguous = false;
+  std::uint8_t* p;
+  template<std::size_t Size>
+  inline void push_pixel(const std::uint8_t* px)noexcept{
+    for(std::size_t i = 0; i < Size; ++i)
+      p[i] ^= px[i];
+    p += Size;
+  }
+  template<std::size_t Size>
+  inline void fill(const std::uint8_t* px, std::size_t n)noexcept{
+    bool zero = true;
+    for(std::size_t i = 0; i < Size; ++i)
+      zero = zero && px[i] == 0;
+    if(zero){
+      p += n*Size;
+      return;
+    }
+    while(n--)
+      push_pixel<Size>(px);
+  }
+};
+
+// gray (N == 1) or gray+alpha (N == 2) pixels, read as RGB(A) with the gray value broadcast
+template<std::size_t N>
+requires(N == 1 || N == 2)
+struct gray_pointer{
+  const std::uint8_t* p;
+};
+
+template<std::size_t N, typename Puller>
+requires(N == 1 || N == 2)
+struct gray_puller{
+  static constexpr bool is_contiguous = false;
+  static constexpr bool is_gray = Puller::is_contiguous;
+  Puller* src;
+  std::uint8_t px[N] = {};
+  std::size_t c = 0;
+  inline std::uint8_t pull()noexcept{
+    if(c == 0)
+      for(auto& x : px)
+        x = src->pull();
+    const auto x = c < 3 ? px[0] : px[N-1];
+    if(++c == N+2)
+      c = 0;
+    return x;
+  }
+  inline gray_pointer<N> raw_pointer()noexcept requires Puller::is_contiguous{
+    return {src->raw_pointer()};
+  }
+  inline void advance(std::size_t n)noexcept requires Puller::is_contiguous{
+    src->advance(n/(N+2)*N);
+  }
+};
+
+template<typename T>
+concept gray_accessor = requires{
+  requires T::is_gray;
+};
+
+// writes the gray value (and the alpha) of RGB(A) pixels, and throws at the first pixel which is not gray
+template<std::size_t N, typename Pusher>
+requires(N == 1 || N == 2)
+struct gray_pusher{
+  static constexpr bool is_contiguous = false;
+  Pusher* out;
+  [[noreturn]] static void not_gray(){
+    throw std::runtime_error("qoixx::qoi::decode: the image is not gray");
+  }
+  static inline void check(const std::uint8_t* px){
+    if(px[0] != px[1] || px[0] != px[2])[[unlikely]]
+      not_gray();
+  }
+  template<std::size_t Size>
+  inline void push_pixel(const std::uint8_t* px){
+    check(px);
+    const std::uint8_t x[2] = {px[0], px[Size-1]};
+    if constexpr(Pusher::is_contiguous){
+      std::memcpy(out->raw_pointer(), x, N);
+      out->advance(N);
+    }
+    else if constexpr(pixel_pusher<Pusher>)
+      out->template push_pixel<N>(x);
+    else
+      for(std::size_t i = 0; i < N; ++i)
+        out->push(x[i]);
+  }
+  template<std::size_t Size>
+  inline void fill(const std::uint8_t* px, std::size_t n){
+    check(px);
+    if constexpr(Pusher::is_contiguous && N == 1){
+      std::memset(out->raw_pointer(), px[0], n);
+      out->advance(n);
+    }
+    else
+      while(n--)
+        push_pixel<Size>(px);
+  }
+};
+
+template<typename T>
+concept simd_accessor = T::is_contiguous || planar_accessor<T> || delta_accessor<T> || gray_accessor<T>;
+
 template<typename T>
 struct default_container_operator;
 
@@ -55,6 +241,10 @@ struct default_container_operator<std::vector<T, A>>{
     target_type t(size);
     return t;
   }
+  static inline target_type construct(std::size_t size, const A& alloc){
+    target_type t(size, alloc);
+    return t;
+  }
   struct pusher{
     static constexpr bool is_contiguous = true;
     target_type* t;
@@ -152,12 +342,131 @@ struct default_container_operator<std::pair<T*, std::size_t>>{
   }
 };
 
+template<typename T, std::size_t N>
+requires(sizeof(T) == 1 && !std::same_as<T, bool>)
+struct default_container_operator<std::array<T, N>>{
+  using target_type = std::array<T, N>;
+  using puller = contiguous_puller<T>;
+  static constexpr puller create_puller(const target_type& t)noexcept{
+    return {t.data()};
+  }
+  static constexpr std::size_t size(const target_type&)noexcept{
+    return N;
+  }
+  static constexpr bool valid(const target_type&)noexcept{
+    return N != 0;
+  }
+};
+
+template<typename T, typename A, std::size_t N>
+requires((sizeof(T) == 1 && !std::same_as<T, bool>) || std::floating_point<T>) && (N == 3 || N == 4)
+struct default_container_operator<std::array<std::vector<T, A>, N>>{
+  using target_type = std::array<std::vector<T, A>, N>;
+  static inline target_type construct(std::size_t size){
+    target_type t;
+    for(auto& x : t)
+      x.resize(size/N);
+    return t;
+  }
+  static inline target_type construct(std::size_t size, const A& alloc){
+    return [&]<std::size_t... I>(std::index_sequence<I...>){
+      return target_type{(static_cast<void>(I), std::vector<T, A>(size/N, alloc))...};
+    }(std::make_index_sequence<N>{});
+  }
+  struct pusher{
+    static constexpr bool is_contiguous = false;
+    static constexpr bool is_planar = true;
+    static constexpr std::size_t channels = N;
+    static constexpr std::array<T, 256> create_table(){
+      std::array<T, 256> table = {};
+      for(std::size_t i = 0; i < table.size(); ++i)
+        if constexpr(std::floating_point<T>)
+          table[i] = static_cast<T>(i) / static_cast<T>(255);
+        else
+          table[i] = static_cast<T>(i);
+      return table;
+    }
+    static inline T convert(std::uint8_t x)noexcept{
+      static constexpr auto table = create_table();
+      return table[x];
+    }
+    target_type* t;
+    std::size_t i = 0;
+    std::size_t c = 0;
+    inline void push(std::uint8_t x)noexcept{
+      (*t)[c][i] = convert(x);
+      if(++c == N){
+        c = 0;
+        ++i;
+      }
+    }
+    template<typename U>
+    requires std::unsigned_integral<U> && (sizeof(U) != 1)
+    inline void push(U t)noexcept{
+      this->push(static_cast<std::uint8_t>(t));
+    }
+    template<std::size_t Size>
+    inline void push_pixel(const std::uint8_t* px)noexcept{
+      for(std::size_t k = 0; k < std::min(Size, N); ++k)
+        (*t)[k][i] = convert(px[k]);
+      ++i;
+    }
+    template<std::size_t Size>
+    inline void fill(const std::uint8_t* px, std::size_t n)noexcept{
+      for(std::size_t k = 0; k < std::min(Size, N); ++k)
+        std::fill_n((*t)[k].data()+i, n, convert(px[k]));
+      i += n;
+    }
+    inline target_type finalize()noexcept{
+      for(auto& x : *t)
+        x.resize(i);
+      return std::move(*t);
+    }
+  };
+  static constexpr pusher create_pusher(target_type& t)noexcept{
+    return {&t};
+  }
+};
+
+template<typename T, std::size_t N>
+requires(sizeof(T) == 1)
+struct default_container_operator<std::pair<std::array<T*, N>, std::size_t>>{
+  using target_type = std::pair<std::array<T*, N>, std::size_t>;
+  using puller = planar_puller<T, N>;
+  static constexpr puller create_puller(const target_type& t)noexcept{
+    puller p;
+    for(std::size_t i = 0; i < N; ++i)
+      p.t[i] = t.first[i];
+    return p;
+  }
+  static inline std::size_t size(const target_type& t)noexcept{
+    return t.second * N;
+  }
+  static inline bool valid(const target_type& t)noexcept{
+    for(auto x : t.first)
+      if(x == nullptr)
+        return false;
+    return true;
+  }
+};
+
 }
 
 template<typename T>
 struct container_operator : detail::default_container_operator<T>{};
 
+namespace detail{
+
+template<typename T, typename Allocator>
+concept allocator_constructible = requires(std::size_t n, const Allocator& alloc){
+  {container_operator<T>::construct(n, alloc)} -> std::same_as<T>;
+};
+
+}
+
 class qoi{
+  // src/qoimicrobench.cpp times the internal stages of the encoders and decoders
+  friend struct microbench;
   template<std::size_t Size>
   static inline void efficient_memcpy(void* dst, const void* src){
     if constexpr(Size == 3){
@@ -174,6 +483,8 @@ class qoi{
       dst.advance(Size);
       efficient_memcpy<Size>(ptr, src);
     }
+    else if constexpr(detail::pixel_pusher<T>)
+      dst.template push_pixel<Size>(static_cast<const std::uint8_t*>(src));
     else{
       const auto* ptr = static_cast<const std::uint8_t*>(src);
       auto size = Size;
@@ -195,6 +506,88 @@ class qoi{
         *ptr++ = src.pull();
     }
   }
+  template<std::uint_fast8_t Channels>
+  static inline void read_pixel(void* dst, const std::uint8_t*& src){
+    efficient_memcpy<Channels>(dst, src);
+    src += Channels;
+  }
+  template<std::uint_fast8_t Channels, std::size_t N>
+  static inline void read_pixel(void* dst, std::array<const std::uint8_t*, N>& src){
+    auto* ptr = static_cast<std::uint8_t*>(dst);
+    for(std::size_t i = 0; i < std::min<std::size_t>(Channels, N); ++i)
+      ptr[i] = *src[i];
+    for(auto& x : src)
+      ++x;
+  }
+  template<std::uint_fast8_t Channels>
+  static inline void read_pixel(void* dst, detail::delta_pointer& src){
+    auto* ptr = static_cast<std::uint8_t*>(dst);
+    for(std::size_t i = 0; i < Channels; ++i)
+      ptr[i] = static_cast<std::uint8_t>(src.cur[i] ^ src.prev[i]);
+    src = src + Channels;
+  }
+  template<std::uint_fast8_t Channels, std::size_t N>
+  static inline void read_pixel(void* dst, detail::gray_pointer<N>& src){
+    auto* ptr = static_cast<std::uint8_t*>(dst);
+    ptr[0] = ptr[1] = ptr[2] = src.p[0];
+    if constexpr(Channels == 4)
+      ptr[3] = src.p[N-1];
+    src.p += N;
+  }
+  template<std::uint_fast8_t Channels>
+  static inline void advance_pixels(const std::uint8_t*& src, std::size_t n){
+    src += n*Channels;
+  }
+  template<std::uint_fast8_t Channels, std::size_t N>
+  static inline void advance_pixels(detail::gray_pointer<N>& src, std::size_t n){
+    src.p += n*N;
+  }
+  template<std::uint_fast8_t Channels>
+  static inline void advance_pixels(detail::delta_pointer& src, std::size_t n){
+    src = src + n*Channels;
+  }
+  template<std::uint_fast8_t Channels, std::size_t N>
+  static inline void advance_pixels(std::array<const std::uint8_t*, N>& src, std::size_t n){
+    for(auto& x : src)
+      x += n;
+  }
+  // the last partial block of the SIMD encoders, padded with the last pixel so that the padding only extends the run
+  template<std::uint_fast8_t Channels, std::size_t Lanes>
+  struct padded_tail{
+    alignas(64) std::uint8_t data[Lanes*4];
+    const std::uint8_t* pad(const std::uint8_t* src, std::size_t n)noexcept{
+      std::memcpy(data, src, n*Channels);
+      for(std::size_t i = n; i < Lanes; ++i)
+        std::memcpy(data + i*Channels, data + (n-1)*Channels, Channels);
+      return data;
+    }
+    template<std::size_t N>
+    std::array<const std::uint8_t*, N> pad(const std::array<const std::uint8_t*, N>& src, std::size_t n)noexcept{
+      std::array<const std::uint8_t*, N> planes;
+      for(std::size_t c = 0; c < N; ++c){
+        std::memcpy(data + c*Lanes, src[c], n);
+        std::memset(data + c*Lanes + n, src[c][n-1], Lanes-n);
+        planes[c] = data + c*Lanes;
+      }
+      return planes;
+    }
+    // the deltas are applied here, and the padded block is read against zeros
+    detail::delta_pointer pad(const detail::delta_pointer& src, std::size_t n)noexcept{
+      static constexpr std::uint8_t zeros[Lanes*4] = {};
+      for(std::size_t i = 0; i < n*Channels; ++i)
+        data[i] = static_cast<std::uint8_t>(src.cur[i] ^ src.prev[i]);
+      for(std::size_t i = n; i < Lanes; ++i)
+        std::memcpy(data + i*Channels, data + (n-1)*Channels, Channels);
+      return {data, zeros};
+    }
+    template<std::size_t N>
+    detail::gray_pointer<N> pad(const detail::gray_pointer<N>& src, std::size_t n)noexcept{
+      std::memcpy(data, src.p, n*N);
+      for(std::size_t i = n; i < Lanes; ++i)
+        std::memcpy(data + i*N, data + (n-1)*N, N);
+      return {data};
+    }
+  };
   enum chunk_tag : std::uint32_t{
     index = 0b0000'0000u,
     diff  = 0b0100'0000u,
@@ -209,6 +602,12 @@ class qoi{
     srgb = 0,
     linear = 1,
   };
+  enum class decoder : std::uint8_t{
+    arithmetic = 0,
+    tables = 1,
+    dispatch = 2,
+    automatic = 3,
+  };
   struct desc{
     std::uint32_t width;
     std::uint32_t height;
@@ -216,6 +615,35 @@ class qoi{
     qoi::colorspace colorspace;
     constexpr bool operator==(const desc&)const noexcept = default;
   };
+  // the largest absolute error per channel that encode_near_lossless may introduce
+  struct tolerance{
+    std::uint8_t r = 0, g = 0, b = 0, a = 0;
+    constexpr bool operator==(const tolerance&)const noexcept = default;
+  };
+#ifdef QOIXX_STATS
+  static constexpr bool stats_enabled = true;
+#else
+  static constexpr bool stats_enabled = false;
+#endif
+  // counters of the encodes and decodes on the calling thread, collected only with QOIXX_STATS (see take_stats)
+  struct stats{
+    // chunks written by the encoders (counted from their output) and read by the decoders
+    std::uint64_t index = 0;
+    std::uint64_t diff = 0;
+    std::uint64_t luma = 0;
+    std::uint64_t run = 0;
+    std::uint64_t rgb = 0;
+    std::uint64_t rgba = 0;
+    // run_lengths[n-1] is the number of runs of n pixels
+    std::array<std::uint64_t, 62> run_lengths = {};
+    // pixels encoded by the SIMD encoders and by the scalar one
+    std::uint64_t simd_pixels = 0;
+    std::uint64_t scalar_pixels = 0;
+    // blocks of the SIMD encoders, and those skipped as a whole because they only extend a run
+    std::uint64_t simd_blocks = 0;
+    std::uint64_t run_blocks = 0;
+    constexpr bool operator==(const stats&)const noexcept = default;
+  };
   struct rgba_t{
     std::uint8_t r, g, b, a;
     inline std::uint32_t v()const{
@@ -331,9 +759,154 @@ class qoi{
     local_rgba_pixel_t<Alpha> v;
   };
   static_assert(std::has_unique_object_representations_v<local_pixel<true>> and std::has_unique_object_representations_v<local_pixel<false>>);
+  struct encode_state{
+    rgba_t index[index_size] = {};
+    rgba_t px = default_pixel<true>();
+    std::uint8_t prev_hash = static_cast<std::uint8_t>(index_size);
+    std::size_t run = 0;
+  };
+  static inline stats& thread_stats()noexcept{
+    static thread_local stats st;
+    return st;
+  }
+  template<auto Member>
+  static inline void count([[maybe_unused]] std::uint64_t n = 1)noexcept{
+    if constexpr(stats_enabled)
+      thread_stats().*Member += n;
+  }
+  static inline void count_run([[maybe_unused]] std::size_t length)noexcept{
+    if constexpr(stats_enabled){
+      auto& st = thread_stats();
+      ++st.run;
+      ++st.run_lengths[length-1];
+    }
+  }
+  // the SIMD encoders emit the chunks of a block at once, so the encoded chunks are counted from the output
+  static inline void count_chunks([[maybe_unused]] const std::uint8_t* p, [[maybe_unused]] const std::uint8_t* end)noexcept{
+    if constexpr(stats_enabled)
+      while(p < end){
+        const auto b = *p;
+        if(b == chunk_tag::rgb){
+          count<&stats::rgb>();
+          p += 4;
+        }
+        else if(b == chunk_tag::rgba){
+          count<&stats::rgba>();
+          p += 5;
+        }
+        else if(b >= chunk_tag::run){
+          count_run((b & 0b0011'1111u) + 1u);
+          ++p;
+        }
+        else if(b >= chunk_tag::luma){
+          count<&stats::luma>();
+          p += 2;
+        }
+        else{
+          if(b >= chunk_tag::diff)
+            count<&stats::diff>();
+          else
+            count<&stats::index>();
+          ++p;
+        }
+      }
+  }
+  template<typename Pusher>
+  static inline void push_run(Pusher& p, std::size_t run){
+    while(run >= 62)[[unlikely]]{
+      static constexpr std::uint8_t x = chunk_tag::run | 61;
+      p.push(x);
+      run -= 62;
+    }
+    if(run > 0)
+      p.push(chunk_tag::run | (run-1));
+  }
+  // tracks the pixel and the index the way a decoder reconstructs them, so the error never accumulates beyond the tolerance;
+  // this serial dependency is why there is no SIMD variant
+  template<std::uint_fast8_t Channels, typename Pusher, typename Puller>
+  static inline void encode_near_lossless_body(Pusher& p, Puller& pixels, std::size_t px_len, const tolerance& tol){
+    rgba_t index[index_size] = {};
+    // the decoders don't start from a zeroed index, so only the slots written so far may be referenced
+    std::uint64_t written = 0;
+    rgba_t prev = default_pixel<true>();
+    std::size_t run = 0;
+    const auto error = [](std::uint8_t x, std::uint8_t y){
+      return static_cast<std::uint8_t>(x < y ? y - x : x - y);
+    };
+    const auto within = [&](const rgba_t& x, const rgba_t& y){
+      return error(x.r, y.r) <= tol.r && error(x.g, y.g) <= tol.g && error(x.b, y.b) <= tol.b && error(x.a, y.a) <= tol.a;
+    };
+    while(px_len--)[[likely]]{
+      rgba_t px = default_pixel<true>();
+      pull<Channels>(&px, pixels);
+      if(within(px, prev)){
+        ++run;
+        continue;
+      }
+      push_run(p, run);
+      run = 0;
+
+      const auto index_pos = px.hash() % index_size;
+      if((written >> index_pos & 1) && within(px, index[index_pos])){
+        p.push(chunk_tag::index | index_pos);
+        prev = index[index_pos];
+        continue;
+      }
+
+      rgba_t rec = px;
+      do{
+        if constexpr(Channels == 4)
+          if(error(px.a, prev.a) > tol.a){
+            p.push(chunk_tag::rgba);
+            push<4>(p, &px);
+            break;
+          }
+        rec.a = prev.a;
+        const auto dr = static_cast<int>(px.r) - static_cast<int>(prev.r);
+        const auto dg = static_cast<int>(px.g) - static_cast<int>(prev.g);
+        const auto db = static_cast<int>(px.b) - static_cast<int>(prev.b);
+        {
+          const auto vr = std::clamp(dr, -2, 1), vg = std::clamp(dg, -2, 1), vb = std::clamp(db, -2, 1);
+          rec.r = static_cast<std::uint8_t>(prev.r + vr);
+          rec.g = static_cast<std::uint8_t>(prev.g + vg);
+          rec.b = static_cast<std::uint8_t>(prev.b + vb);
+          if(within(px, rec)){
+            p.push(chunk_tag::diff | (vr+2) << 4 | (vg+2) << 2 | (vb+2));
+            break;
+          }
+        }
+        {
+          const auto vg = std::clamp(dg, -32, 31);
+          const auto vg_r = std::clamp(dr - vg, -8, 7), vg_b = std::clamp(db - vg, -8, 7);
+          rec.r = static_cast<std::uint8_t>(prev.r + vg + vg_r);
+          rec.g = static_cast<std::uint8_t>(prev.g + vg);
+          rec.b = static_cast<std::uint8_t>(prev.b + vg + vg_b);
+          if(within(px, rec)){
+            p.push(chunk_tag::luma | (vg+32));
+            p.push((vg_r+8) << 4 | (vg_b+8));
+            break;
+          }
+        }
+        rec = {px.r, px.g, px.b, prev.a};
+        p.push(chunk_tag::rgb);
+        push<3>(p, &rec);
+      }while(false);
+      const auto rec_pos = rec.hash() % index_size;
+      index[rec_pos] = rec;
+      written |= std::uint64_t{1} << rec_pos;
+      prev = rec;
+    }
+    push_run(p, run);
+  }
   template<std::uint_fast8_t Channels, typename Pusher, typename Puller>
-  static inline void encode_body(Pusher& p, Puller& pixels, rgba_t (&index)[index_size], std::size_t px_len, local_rgba_pixel_t<Channels == 4u> px_prev = default_pixel<Channels == 4u>(), std::uint8_t prev_hash = static_cast<std::uint8_t>(index_size), std::size_t run = 0){
+  static inline void encode_body(Pusher& p, Puller& pixels, encode_state& state, std::size_t px_len){
+    auto& index = state.index;
     local_pixel<Channels == 4u> px;
+    local_rgba_pixel_t<Channels == 4u> px_prev;
+    efficient_memcpy<Channels>(&px_prev, &state.px);
+    auto prev_hash = state.prev_hash;
+    auto run = state.run;
+    count<&stats::scalar_pixels>(px_len);
     while(px_len--)[[likely]]{
       pull<Channels>(&px.v, pixels);
       if(px.v.v() == px_prev.v()){
@@ -401,14 +974,20 @@ class qoi{
       }while(false);
       efficient_memcpy<Channels>(&px_prev, &px.v);
     }
-    while(run >= 62)[[unlikely]]{
-      static constexpr std::uint8_t x = chunk_tag::run | 61;
-      p.push(x);
-      run -= 62;
-    }
-    if(run > 0)
-      p.push(chunk_tag::run | (run-1));
+    efficient_memcpy<Channels>(&state.px, &px_prev);
+    state.prev_hash = prev_hash;
+    state.run = run;
   }
+#ifndef QOIXX_ENCODE_REGISTER_INDEX
+#define QOIXX_HPP_ENCODE_REGISTER_INDEX_NOT_DEFINED
+#define QOIXX_ENCODE_REGISTER_INDEX 0
+#endif
+  // whether the AVX2 and NEON encoders keep the index in registers (see resolve_index) instead of resolving its hits serially through memory
+  static constexpr bool default_register_index = QOIXX_ENCODE_REGISTER_INDEX;
+#ifdef QOIXX_HPP_ENCODE_REGISTER_INDEX_NOT_DEFINED
+#undef QOIXX_ENCODE_REGISTER_INDEX
+#undef QOIXX_HPP_ENCODE_REGISTER_INDEX_NOT_DEFINED
+#endif
 #ifndef QOIXX_NO_SIMD
 #if defined(__ARM_FEATURE_SVE)
   template<bool Alpha>
@@ -436,30 +1015,64 @@ class qoi{
     else
       return svld3_u8(pg, ptr);
   }
-  template<std::size_t SVERegisterSize, std::uint_fast8_t Channels, typename Pusher, typename Puller>
-  static inline void encode_sve(Pusher& p_, Puller& pixels_, const desc& desc){
+#ifdef QOIXX_EXPERIMENTAL_SIMD
+  template<bool Alpha, std::size_t N>
+  static inline pixels_type<Alpha> load(svbool_t pg, const std::array<const std::uint8_t*, N>& ptr)noexcept{
+    if constexpr(!Alpha)
+      return create(svld1_u8(pg, ptr[0]), svld1_u8(pg, ptr[1]), svld1_u8(pg, ptr[2]));
+    else if constexpr(N == 4)
+      return create(svld1_u8(pg, ptr[0]), svld1_u8(pg, ptr[1]), svld1_u8(pg, ptr[2]), svld1_u8(pg, ptr[3]));
+    else
+      return create(svld1_u8(pg, ptr[0]), svld1_u8(pg, ptr[1]), svld1_u8(pg, ptr[2]), svdup_n_u8(255));
+  }
+  template<bool Alpha>
+  static inline pixels_type<Alpha> load(svbool_t pg, const detail::delta_pointer& ptr)noexcept{
+    const auto x = load<Alpha>(pg, ptr.cur);
+    const auto y = load<Alpha>(pg, ptr.prev);
+    if constexpr(Alpha)
+      return create(sveor_u8_z(pg, get<0>(x), get<0>(y)), sveor_u8_z(pg, get<1>(x), get<1>(y)), sveor_u8_z(pg, get<2>(x), get<2>(y)), sveor_u8_z(pg, get<3>(x), get<3>(y)));
+    else
+      return create(sveor_u8_z(pg, get<0>(x), get<0>(y)), sveor_u8_z(pg, get<1>(x), get<1>(y)), sveor_u8_z(pg, get<2>(x), get<2>(y)));
+  }
+  template<bool Alpha, std::size_t N>
+  requires(Alpha == (N == 2))
+  static inline pixels_type<Alpha> load(svbool_t pg, const detail::gray_pointer<N>& ptr)noexcept{
+    if constexpr(N == 1){
+      const auto g = svld1_u8(pg, ptr.p);
+      return create(g, g, g);
+    }
+    else{
+      const auto ga = svld2_u8(pg, ptr.p);
+      const auto g = svget2_u8(ga, 0);
+      return create(g, g, g, svget2_u8(ga, 1));
+    }
+  }
+  template<std::size_t SVERegisterSize, std::uint_fast8_t Channels, typename Pusher, typename Puller, typename Length>
+  static inline void encode_sve(Pusher& p_, Puller& pixels_, encode_state& state, Length px_len){
     static constexpr bool Alpha = Channels == 4;
     std::uint8_t* p = p_.raw_pointer();
-    const std::uint8_t* pixels = pixels_.raw_pointer();
+    auto pixels = pixels_.raw_pointer();
 
-    rgba_t index[index_size] = {};
+    rgba_t index[index_size];
+    std::memcpy(index, state.index, sizeof(index));
 
     const auto zero = svdup_n_u8(0);
     const auto iota = svindex_u8(0, 1);
 
     pixels_type<Alpha> prev;
     if constexpr(Alpha)
-      prev = create(zero, zero, zero, svdup_n_u8(255));
+      prev = create(svdup_n_u8(state.px.r), svdup_n_u8(state.px.g), svdup_n_u8(state.px.b), svdup_n_u8(state.px.a));
     else
-      prev = create(zero, zero, zero);
+      prev = create(svdup_n_u8(state.px.r), svdup_n_u8(state.px.g), svdup_n_u8(state.px.b));
 
-    std::size_t run = 0;
-    rgba_t px = {0, 0, 0, 255};
-    auto prev_hash = static_cast<std::uint8_t>(index_size);
+    std::size_t run = state.run;
+    rgba_t px = state.px;
+    auto prev_hash = state.prev_hash;
 
-    const std::size_t px_len = desc.width * desc.height;
     static constexpr auto vector_lanes = SVERegisterSize/8;
+    count<&stats::simd_pixels>(px_len);
     for(std::size_t i = 0; i < px_len; i += vector_lanes){
+      count<&stats::simd_blocks>();
       const auto mask = svwhilelt_b8_u64(i, px_len);
       const auto num = std::min(px_len-i, vector_lanes);
       const auto pxs = load<Alpha>(mask, pixels);
@@ -478,13 +1091,14 @@ class qoi{
         runv = svand_b_z(mask, runv, av);
       const auto not_runv = svnot_b_z(mask, runv);
       if(!svptest_any(mask, not_runv)){
+        count<&stats::run_blocks>();
         run += num;
-        pixels += num*Channels;
+        advance_pixels<Channels>(pixels, num);
         continue;
       }
       const auto r = svminv_u8(not_runv, iota);
       run += r;
-      pixels += r*Channels;
+      advance_pixels<Channels>(pixels, r);
       if(run > 0){
         while(run >= 62)[[unlikely]]{
           static constexpr std::uint8_t x = chunk_tag::run | 61;
@@ -530,7 +1144,7 @@ class qoi{
       for(std::size_t i = r; i < num; ++i){
         if(runs[i]){
           ++run;
-          pixels += Channels;
+          advance_pixels<Channels>(pixels, 1);
           continue;
         }
         if(run > 1){
@@ -546,8 +1160,7 @@ class qoi{
         }
         const auto index_pos = hashs[i];
         prev_hash = index_pos;
-        efficient_memcpy<Channels>(&px, pixels);
-        pixels += Channels;
+        read_pixel<Channels>(&px, pixels);
         if(index[index_pos] == px){
           *p++ = chunk_tag::index | index_pos;
           continue;
@@ -575,78 +1188,62 @@ class qoi{
       }
       prev = pxs;
     }
-    while(run >= 62)[[unlikely]]{
-      static constexpr std::uint8_t x = chunk_tag::run | 61;
-      *p++ = x;
-      run -= 62;
-    }
-    if(run > 0){
-      *p++ = chunk_tag::run | (run-1);
-      run = 0;
-    }
     p_.advance(p-p_.raw_pointer());
     pixels_.advance(px_len*Channels);
 
-    push<sizeof(padding)>(p_, padding);
-  }
-#elif defined(__aarch64__)
-  template<bool Alpha>
-  using pixels_type = std::conditional_t<Alpha, uint8x16x4_t, uint8x16x3_t>;
-  template<bool Alpha>
-  static inline pixels_type<Alpha> load(const std::uint8_t* ptr)noexcept{
-    if constexpr(Alpha)
-      return vld4q_u8(ptr);
-    else
-      return vld3q_u8(ptr);
+    std::memcpy(state.index, index, sizeof(index));
+    state.px = px;
+    state.prev_hash = prev_hash;
+    state.run = run;
   }
-  static constexpr std::size_t simd_lanes = 16;
-  template<std::uint_fast8_t Channels, typename Pusher, typename Puller>
-  static inline void encode_neon(Pusher& p_, Puller& pixels_, const desc& desc){
+#else
+  template<std::size_t SVERegisterSize, std::uint_fast8_t Channels, typename Pusher, typename Puller>
+  static inline void encode_sve(Pusher& p_, Puller& pixels_, const desc& desc){
     static constexpr bool Alpha = Channels == 4;
     std::uint8_t* p = p_.raw_pointer();
     const std::uint8_t* pixels = pixels_.raw_pointer();
 
     rgba_t index[index_size] = {};
 
-    const auto zero = vdupq_n_u8(0);
-    static constexpr std::uint8_t iota_[simd_lanes] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-    const auto iota = vld1q_u8(iota_);
+    const auto zero = svdup_n_u8(0);
+    const auto iota = svindex_u8(0, 1);
 
     pixels_type<Alpha> prev;
-    prev.val[0] = prev.val[1] = prev.val[2] = zero;
     if constexpr(Alpha)
-      prev.val[3] = vdupq_n_u8(255);
+      prev = create(zero, zero, zero, svdup_n_u8(255));
+    else
+      prev = create(zero, zero, zero);
 
     std::size_t run = 0;
     rgba_t px = {0, 0, 0, 255};
     auto prev_hash = static_cast<std::uint8_t>(index_size);
 
-    std::size_t px_len = desc.width * desc.height;
-    std::size_t simd_len = px_len / simd_lanes;
-    const std::size_t simd_len_16 = simd_len * simd_lanes;
-    px_len -= simd_len_16;
-    pixels_.advance(simd_len_16*Channels);
-    while(simd_len--){
-      const auto pxs = load<Alpha>(pixels);
-      pixels_type<Alpha> diff;
-      diff.val[0] = vsubq_u8(pxs.val[0], vextq_u8(prev.val[0], pxs.val[0], simd_lanes-1));
-      diff.val[1] = vsubq_u8(pxs.val[1], vextq_u8(prev.val[1], pxs.val[1], simd_lanes-1));
-      diff.val[2] = vsubq_u8(pxs.val[2], vextq_u8(prev.val[2], pxs.val[2], simd_lanes-1));
+    const std::size_t px_len = desc.width * desc.height;
+    static constexpr auto vector_lanes = SVERegisterSize/8;
+    for(std::size_t i = 0; i < px_len; i += vector_lanes){
+      const auto mask = svwhilelt_b8_u64(i, px_len);
+      const auto num = std::min(px_len-i, vector_lanes);
+      const auto pxs = load<Alpha>(mask, pixels);
+      static constexpr std::uint64_t imm = SVERegisterSize/8-1;
+      auto rv = svsub_u8_x(mask, get<0>(pxs), svext_u8(get<0>(prev), get<0>(pxs), imm));
+      auto gv = svsub_u8_x(mask, get<1>(pxs), svext_u8(get<1>(prev), get<1>(pxs), imm));
+      auto bv = svsub_u8_x(mask, get<2>(pxs), svext_u8(get<2>(prev), get<2>(pxs), imm));
+      [[maybe_unused]] svbool_t av;
       bool alpha = true;
       if constexpr(Alpha){
-        diff.val[3] = vsubq_u8(pxs.val[3], vextq_u8(prev.val[3], pxs.val[3], simd_lanes-1));
-        diff.val[3] = vceqq_u8(diff.val[3], zero);
-        alpha = vminvq_u8(diff.val[3]) != 0;
+        av = svcmpeq_n_u8(mask, svsub_u8_x(mask, get<3>(pxs), svext_u8(get<3>(prev), get<3>(pxs), imm)), 0);
+        alpha = !svptest_any(mask, svnot_b_z(mask, av));
       }
-      auto runv = vceqq_u8(vorrq_u8(vorrq_u8(diff.val[0], diff.val[1]), diff.val[2]), zero);
-      if(vminvq_u8(runv) != 0 && alpha){
-        run += simd_lanes;
-        pixels += simd_lanes*Channels;
+      auto runv = svcmpeq_n_u8(mask, svorr_u8_x(mask, svorr_u8_x(mask, rv, gv), bv), 0);
+      if constexpr(Alpha)
+        runv = svand_b_z(mask, runv, av);
+      const auto not_runv = svnot_b_z(mask, runv);
+      if(!svptest_any(mask, not_runv)){
+        run += num;
+        pixels += num*Channels;
         continue;
       }
-      if constexpr(Alpha)
-        runv = vandq_u8(runv, diff.val[3]);
-      const auto r = vminvq_u8(vorrq_u8(vandq_u8(vmvnq_u8(runv), iota), runv));
+      const auto r = svminv_u8(not_runv, iota);
       run += r;
       pixels += r*Channels;
       if(run > 0){
@@ -667,33 +1264,31 @@ class qoi{
           run = 0;
         }
       }
-      const auto two = vdupq_n_u8(2);
-      diff.val[0] = vaddq_u8(diff.val[0], two);
-      diff.val[1] = vaddq_u8(diff.val[1], two);
-      diff.val[2] = vaddq_u8(diff.val[2], two);
-      const auto four = vdupq_n_u8(4);
-      const auto diffv = vandq_u8(vorrq_u8(vorrq_u8(vdupq_n_u8(chunk_tag::diff), vshlq_n_u8(diff.val[0], 4)), vorrq_u8(vshlq_n_u8(diff.val[1], 2), diff.val[2])), vcltq_u8(vorrq_u8(vorrq_u8(diff.val[0], diff.val[1]), diff.val[2]), four));
-      const auto eight = vdupq_n_u8(8);
-      diff.val[0] = vaddq_u8(vsubq_u8(diff.val[0], diff.val[1]), eight);
-      diff.val[2] = vaddq_u8(vsubq_u8(diff.val[2], diff.val[1]), eight);
-      diff.val[1] = vaddq_u8(diff.val[1], vdupq_n_u8(30));
-      const auto lu = vandq_u8(vorrq_u8(vdupq_n_u8(chunk_tag::luma), diff.val[1]), vceqq_u8(vorrq_u8(vandq_u8(vorrq_u8(diff.val[0], diff.val[2]), vdupq_n_u8(0xf0)), vandq_u8(diff.val[1], vdupq_n_u8(0xc0))), zero));
-      const auto ma = vorrq_u8(vshlq_n_u8(diff.val[0], 4), diff.val[2]);
-      uint8x16_t hash;
+      rv = svadd_n_u8_x(mask, rv, 2);
+      gv = svadd_n_u8_x(mask, gv, 2);
+      bv = svadd_n_u8_x(mask, bv, 2);
+      const auto diffv = svorr_u8_z(svcmplt_n_u8(mask, svorr_u8_z(mask, svorr_u8_x(mask, rv, gv), bv), 4), svorr_n_u8_x(mask, svlsl_n_u8_x(mask, rv, 4), chunk_tag::diff), svorr_u8_x(mask, svlsl_n_u8_x(mask, gv, 2), bv));
+      rv = svadd_n_u8_x(mask, svsub_u8_x(mask, rv, gv), 8);
+      bv = svadd_n_u8_x(mask, svsub_u8_x(mask, bv, gv), 8);
+      gv = svadd_n_u8_x(mask, gv, 30);
+      const auto lu = svorr_n_u8_z(svcmpeq_n_u8(mask, svorr_u8_x(mask, svand_n_u8_x(mask, svorr_u8_x(mask, rv, bv), 0xf0), svand_n_u8_x(mask, gv, 0xc0)), 0), gv, chunk_tag::luma);
+      const auto ma = svorr_u8_x(mask, svlsl_n_u8_x(mask, rv, 4), bv);
+      svuint8_t hash;
       if constexpr(Alpha)
-        hash = vandq_u8(vaddq_u8(vaddq_u8(vmulq_u8(pxs.val[0], vdupq_n_u8(3)), vmulq_u8(pxs.val[1], vdupq_n_u8(5))), vaddq_u8(vmulq_u8(pxs.val[2], vdupq_n_u8(7)), vmulq_u8(pxs.val[3], vdupq_n_u8(11)))), vdupq_n_u8(63));
+        hash = svand_n_u8_x(mask, svadd_u8_x(mask, svadd_u8_x(mask, svmul_n_u8_x(mask, get<0>(pxs), 3), svmul_n_u8_x(mask, get<1>(pxs), 5)), svadd_u8_x(mask, svmul_n_u8_x(mask, get<2>(pxs), 7), svmul_n_u8_x(mask, get<3>(pxs), 11))), 63);
       else
-        hash = vandq_u8(vaddq_u8(vaddq_u8(vmulq_u8(pxs.val[0], vdupq_n_u8(3)), vmulq_u8(pxs.val[1], vdupq_n_u8(5))), vaddq_u8(vmulq_u8(pxs.val[2], vdupq_n_u8(7)), vdupq_n_u8(static_cast<std::uint8_t>(255*11)))), vdupq_n_u8(63));
-      std::uint8_t runs[simd_lanes], diffs[simd_lanes], lumas[simd_lanes*2], hashs[simd_lanes];
-      [[maybe_unused]] std::uint8_t alphas[simd_lanes];
-      vst1q_u8(runs, runv);
-      vst1q_u8(diffs, diffv);
-      vst2q_u8(lumas, (uint8x16x2_t{lu, ma}));
-      vst1q_u8(hashs, hash);
+        hash = svand_n_u8_x(mask, svadd_u8_x(mask, svadd_u8_x(mask, svmul_n_u8_x(mask, get<0>(pxs), 3), svmul_n_u8_x(mask, get<1>(pxs), 5)), svadd_n_u8_x(mask, svmul_n_u8_x(mask, get<2>(pxs), 7), static_cast<std::uint8_t>(255*11))), 63);
+      std::uint8_t runs[SVERegisterSize/8], diffs[SVERegisterSize/8], lumas[SVERegisterSize/8*2], hashs[SVERegisterSize/8];
+      [[maybe_unused]] std::uint8_t alphas[SVERegisterSize/8];
+      svst1_u8(mask, runs, svadd_n_u8_m(runv, zero, 1));
+      svst1_u8(mask, diffs, diffv);
+      const auto luma = svcreate2_u8(lu, ma);
+      svst2_u8(mask, lumas, luma);
+      svst1_u8(mask, hashs, hash);
       if constexpr(Alpha)
         if(!alpha)
-          vst1q_u8(alphas, diff.val[3]);
-      for(std::size_t i = r; i < simd_lanes; ++i){
+          svst1_u8(mask, alphas, svadd_n_u8_m(av, zero, 1));
+      for(std::size_t i = r; i < num; ++i){
         if(runs[i]){
           ++run;
           pixels += Channels;
@@ -741,191 +1336,185 @@ class qoi{
       }
       prev = pxs;
     }
+    while(run >= 62)[[unlikely]]{
+      static constexpr std::uint8_t x = chunk_tag::run | 61;
+      *p++ = x;
+      run -= 62;
+    }
+    if(run > 0){
+      *p++ = chunk_tag::run | (run-1);
+      run = 0;
+    }
     p_.advance(p-p_.raw_pointer());
+    pixels_.advance(px_len*Channels);
 
+    push<sizeof(padding)>(p_, padding);
+  }
+#endif
+#elif defined(__aarch64__)
+  template<bool Alpha>
+  using pixels_type = std::conditional_t<Alpha, uint8x16x4_t, uint8x16x3_t>;
+  template<bool Alpha>
+  static inline pixels_type<Alpha> load(const std::uint8_t* ptr)noexcept{
     if constexpr(Alpha)
-      encode_body<Channels>(p_, pixels_, index, px_len, px, prev_hash, run);
+      return vld4q_u8(ptr);
+    else
+      return vld3q_u8(ptr);
+  }
+#ifdef QOIXX_EXPERIMENTAL_SIMD
+  template<bool Alpha, std::size_t N>
+  static inline pixels_type<Alpha> load(const std::array<const std::uint8_t*, N>& ptr)noexcept{
+    pixels_type<Alpha> pxs;
+    pxs.val[0] = vld1q_u8(ptr[0]);
+    pxs.val[1] = vld1q_u8(ptr[1]);
+    pxs.val[2] = vld1q_u8(ptr[2]);
+    if constexpr(Alpha){
+      if constexpr(N == 4)
+        pxs.val[3] = vld1q_u8(ptr[3]);
+      else
+        pxs.val[3] = vdupq_n_u8(255);
+    }
+    return pxs;
+  }
+  template<bool Alpha>
+  static inline pixels_type<Alpha> load(const detail::delta_pointer& ptr)noexcept{
+    auto pxs = load<Alpha>(ptr.cur);
+    const auto prev = load<Alpha>(ptr.prev);
+    pxs.val[0] = veorq_u8(pxs.val[0], prev.val[0]);
+    pxs.val[1] = veorq_u8(pxs.val[1], prev.val[1]);
+    pxs.val[2] = veorq_u8(pxs.val[2], prev.val[2]);
+    if constexpr(Alpha)
+      pxs.val[3] = veorq_u8(pxs.val[3], prev.val[3]);
+    return pxs;
+  }
+  template<bool Alpha, std::size_t N>
+  requires(Alpha == (N == 2))
+  static inline pixels_type<Alpha> load(const detail::gray_pointer<N>& ptr)noexcept{
+    pixels_type<Alpha> pxs;
+    if constexpr(N == 1)
+      pxs.val[0] = vld1q_u8(ptr.p);
     else{
-      rgb_t px_prev;
-      efficient_memcpy<3>(&px_prev, &px);
-      encode_body<Channels>(p_, pixels_, index, px_len, px_prev, prev_hash, run);
+      const auto ga = vld2q_u8(ptr.p);
+      pxs.val[0] = ga.val[0];
+      pxs.val[3] = ga.val[1];
     }
-
-    push<sizeof(padding)>(p_, padding);
+    pxs.val[1] = pxs.val[0];
+    pxs.val[2] = pxs.val[0];
+    return pxs;
   }
-#elif defined(__AVX2__)
-  static constexpr unsigned de_bruijn_bit_position_sequence[32] = {
-    0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8, 31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+  static constexpr std::size_t simd_lanes = 16;
+  // the index as byte planes, entries 16k to 16k+15 in the k-th register of each channel
+  struct index_registers{
+    uint8x16x4_t planes[4];
   };
-  static constexpr unsigned lsb32(std::uint32_t x)noexcept{
-    return de_bruijn_bit_position_sequence[(static_cast<std::uint32_t>(x&-static_cast<std::int32_t>(x))*0x077cb531u) >> 27];
-  }
-  template<std::uint8_t M>
-  static inline __m256i slli_epi8(__m256i v)noexcept{
-    const auto mask = _mm256_set1_epi8(static_cast<std::uint8_t>(0xff << M) >> M);
-    return _mm256_slli_epi16(_mm256_and_si256(v, mask), M);
+  static_assert(index_size == simd_lanes*4);
+  static inline index_registers load_index(const rgba_t (&index)[index_size])noexcept{
+    index_registers x;
+    for(std::size_t k = 0; k < 4; ++k){
+      const auto v = vld4q_u8(reinterpret_cast<const std::uint8_t*>(index + k*simd_lanes));
+      for(std::size_t c = 0; c < 4; ++c)
+        x.planes[c].val[k] = v.val[c];
+    }
+    return x;
   }
-  template<std::uint8_t M>
-  static inline __m256i mul_epi8(__m256i v)noexcept{
-    if constexpr(M == 0)
-      return _mm256_setzero_si256();
-    else if constexpr(M == 1)
-      return v;
-    else if constexpr(M == 2)
-      return slli_epi8<1>(v);
-    else if constexpr(M == 3)
-      return _mm256_add_epi8(slli_epi8<1>(v), v);
-    else if constexpr(M == 4)
-      return slli_epi8<2>(v);
-    else if constexpr(M == 5)
-      return _mm256_add_epi8(slli_epi8<2>(v), v);
-    else if constexpr(M == 6)
-      return _mm256_add_epi8(slli_epi8<2>(v), slli_epi8<1>(v));
-    else if constexpr(M == 7)
-      return _mm256_sub_epi8(slli_epi8<3>(v), v);
-    else if constexpr(M == 8)
-      return slli_epi8<3>(v);
-    else if constexpr(M == 9)
-      return _mm256_add_epi8(slli_epi8<3>(v), v);
-    else if constexpr(M == 10)
-      return _mm256_add_epi8(slli_epi8<3>(v), slli_epi8<1>(v));
-    else if constexpr(M == 11)
-      return _mm256_add_epi8(_mm256_add_epi8(slli_epi8<3>(v), slli_epi8<1>(v)), v);
-    else if constexpr(M == 12)
-      return _mm256_add_epi8(slli_epi8<3>(v), slli_epi8<2>(v));
-    else if constexpr(M == 13)
-      return _mm256_add_epi8(_mm256_add_epi8(slli_epi8<3>(v), slli_epi8<2>(v)), v);
-    else if constexpr(M == 14)
-      return _mm256_sub_epi8(slli_epi8<4>(v), slli_epi8<1>(v));
-    else if constexpr(M == 15)
-      return _mm256_sub_epi8(slli_epi8<4>(v), v);
-    else
-      static_assert(M <= 15);
+  static inline void store_index(rgba_t (&index)[index_size], const index_registers& x)noexcept{
+    for(std::size_t k = 0; k < 4; ++k)
+      vst4q_u8(reinterpret_cast<std::uint8_t*>(index + k*simd_lanes), (uint8x16x4_t{x.planes[0].val[k], x.planes[1].val[k], x.planes[2].val[k], x.planes[3].val[k]}));
   }
-  static inline __m256i prev_vector(__m256i pxs, __m256i prev)noexcept{
-    const auto permute = _mm256_permute2x128_si256(pxs, pxs, 0x08);
-    const auto inserted = _mm256_inserti128_si256(permute, _mm256_extracti128_si256(prev, 1), 0);
-    return _mm256_alignr_epi8(pxs, inserted, 15);
+  // the bytes selected by idx from the 64 entries of an index plane followed by the 16 lanes of the block (64-79)
+  static inline uint8x16_t index_lookup(const uint8x16x4_t& plane, uint8x16_t block, uint8x16_t idx)noexcept{
+    return vqtbx1q_u8(vqtbl4q_u8(plane, idx), block, vsubq_u8(idx, vdupq_n_u8(index_size)));
   }
+  // resolves the index hits of a block without the index in memory: each non-run lane reads the entry of its hash from the last
+  // preceding lane with that hash, or from the index when there is none, and each entry takes the last lane hashed to it;
+  // returns 0xf in the nibble of each lane that hits
   template<bool Alpha>
-  struct pixels_type{
-    __m256i val[3+Alpha];
-  };
-  static constexpr std::size_t simd_lanes = 256/8;
-  template<bool Alpha>
-  static inline pixels_type<Alpha> load(const std::uint8_t* ptr)noexcept{
-    if constexpr(Alpha){
-      const auto t1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
-      const auto t2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr+simd_lanes));
-      const auto t3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr+simd_lanes*2));
-      const auto t4 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr+simd_lanes*3));
-      const auto lo12 = _mm256_unpacklo_epi8(t1, t2);
-      const auto lo34 = _mm256_unpacklo_epi8(t3, t4);
-      const auto lolo12lo34 = _mm256_unpacklo_epi16(lo12, lo34);
-      const auto hilo12lo34 = _mm256_unpackhi_epi16(lo12, lo34);
-      const auto lololo12lo34hilo12lo34 = _mm256_unpacklo_epi32(lolo12lo34, hilo12lo34);
-      const auto hilolo12lo34hilo12lo34 = _mm256_unpackhi_epi32(lolo12lo34, hilo12lo34);
-      const auto hi12 = _mm256_unpackhi_epi8(t1, t2);
-      const auto hi34 = _mm256_unpackhi_epi8(t3, t4);
-      const auto lohi12hi34 = _mm256_unpacklo_epi16(hi12, hi34);
-      const auto hihi12hi34 = _mm256_unpackhi_epi16(hi12, hi34);
-      const auto lolohi12hi34hihi12hi34 = _mm256_unpacklo_epi32(lohi12hi34, hihi12hi34);
-      const auto lolololo12lo34hilo12lo34lolohi12hi34hihi12hi34 = _mm256_unpacklo_epi64(lololo12lo34hilo12lo34, lolohi12hi34hihi12hi34);
-      const auto hilololo12lo34hilo12lo34lolohi12hi34hihi12hi34 = _mm256_unpackhi_epi64(lololo12lo34hilo12lo34, lolohi12hi34hihi12hi34);
-      const auto hilohi12hi34hihi12hi34 = _mm256_unpackhi_epi32(lohi12hi34, hihi12hi34);
-      const auto lohilolo12lo34hilo12lo34hilohi12hi34hihi12hi34 = _mm256_unpacklo_epi64(hilolo12lo34hilo12lo34, hilohi12hi34hihi12hi34);
-      const auto hihilolo12lo34hilo12lo34hilohi12hi34hihi12hi34 = _mm256_unpackhi_epi64(hilolo12lo34hilo12lo34, hilohi12hi34hihi12hi34);
-      const auto mask1 = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
-      const auto mask2 = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
-      const auto r = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(lolololo12lo34hilo12lo34lolohi12hi34hihi12hi34, mask1), mask2);
-      const auto g = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(hilololo12lo34hilo12lo34lolohi12hi34hihi12hi34, mask1), mask2);
-      const auto b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(lohilolo12lo34hilo12lo34hilohi12hi34hihi12hi34, mask1), mask2);
-      const auto a = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(hihilolo12lo34hilo12lo34hilohi12hi34hihi12hi34, mask1), mask2);
-      return {{r, g, b, a}};
+  static inline std::uint64_t resolve_index(index_registers& index, const pixels_type<Alpha>& pxs, uint8x16_t hash, const std::uint8_t (&runs)[simd_lanes], const std::uint8_t (&hashs)[simd_lanes])noexcept{
+    static constexpr std::uint8_t iota_[simd_lanes] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    const auto lane = vld1q_u8(iota_);
+    uint8x16_t position[4], src_position[4];
+    for(std::size_t k = 0; k < 4; ++k)
+      src_position[k] = position[k] = vaddq_u8(lane, vdupq_n_u8(static_cast<std::uint8_t>(k*simd_lanes)));
+    auto src = hash;
+    for(std::size_t i = 0; i < simd_lanes; ++i){
+      if(runs[i])
+        continue;
+      const auto h = vdupq_n_u8(hashs[i]);
+      const auto from = vdupq_n_u8(static_cast<std::uint8_t>(index_size + i));
+      src = vbslq_u8(vandq_u8(vceqq_u8(hash, h), vcgtq_u8(lane, vdupq_n_u8(static_cast<std::uint8_t>(i)))), from, src);
+      for(std::size_t k = 0; k < 4; ++k)
+        src_position[k] = vbslq_u8(vceqq_u8(position[k], h), from, src_position[k]);
     }
-    else{
-      const auto t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
-      const auto t2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr+simd_lanes/2));
-      const auto t3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr+simd_lanes));
-      const auto t4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr+simd_lanes*3/2));
-      const auto t5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr+simd_lanes*2));
-      const auto t6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr+simd_lanes*5/2));
-      const auto mask01 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, 1, 4, 7, 10, 13, 2, 5, 8, 11, 14);
-      const auto mask02 = _mm_setr_epi8(2, 5, 8, 11, 14, 0, 3, 6, 9, 12, 15, 1, 4, 7, 10, 13);
-      const auto mask03 = _mm_setr_epi8(1, 4, 7, 10, 13, 2, 5, 8, 11, 14, 0, 3, 6, 9, 12, 15);
-      static constexpr char _128 = static_cast<char>(0b1000'0000);
-      const auto mask11 = _mm_setr_epi8(0, 0, 0, 0, 0, 0, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128);
-      const auto mask21 = _mm_setr_epi8(_128, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128, 0, 0, 0, 0, 0);
-      const auto mask12 = _mm_setr_epi8(_128, _128, _128, _128, _128, 0, 0, 0, 0, 0, 0, _128, _128, _128, _128, _128);
-      const auto mask22 = _mm_setr_epi8(0, 0, 0, 0, 0, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128);
-      const auto mask13 = _mm_setr_epi8(_128, _128, _128, _128, _128, _128, _128, _128, _128, _128, 0, 0, 0, 0, 0, 0);
-      const auto mask23 = _mm_setr_epi8(_128, _128, _128, _128, _128, 0, 0, 0, 0, 0, _128, _128, _128, _128, _128, _128);
-      const auto x1 = _mm_shuffle_epi8(t1, mask01);
-      const auto x2 = _mm_shuffle_epi8(t2, mask02);
-      const auto x3 = _mm_shuffle_epi8(t3, mask03);
-      const auto x4 = _mm_shuffle_epi8(t4, mask01);
-      const auto x5 = _mm_shuffle_epi8(t5, mask02);
-      const auto x6 = _mm_shuffle_epi8(t6, mask03);
-      const auto r1 = _mm_blendv_epi8(_mm_alignr_epi8(x3, x3, 5), _mm_blendv_epi8(x1, _mm_alignr_epi8(x2, x2, 10), mask11), mask21);
-      const auto g1 = _mm_blendv_epi8(_mm_alignr_epi8(x1, x1, 6), _mm_blendv_epi8(x2, _mm_alignr_epi8(x3, x3, 10), mask12), mask22);
-      const auto b1 = _mm_blendv_epi8(_mm_alignr_epi8(x2, x2, 6), _mm_blendv_epi8(x3, _mm_alignr_epi8(x1, x1, 11), mask13), mask23);
-      const auto r2 = _mm_blendv_epi8(_mm_alignr_epi8(x6, x6, 5), _mm_blendv_epi8(x4, _mm_alignr_epi8(x5, x5, 10), mask11), mask21);
-      const auto g2 = _mm_blendv_epi8(_mm_alignr_epi8(x4, x4, 6), _mm_blendv_epi8(x5, _mm_alignr_epi8(x6, x6, 10), mask12), mask22);
-      const auto b2 = _mm_blendv_epi8(_mm_alignr_epi8(x5, x5, 6), _mm_blendv_epi8(x6, _mm_alignr_epi8(x4, x4, 11), mask13), mask23);
-      const auto r = _mm256_inserti128_si256(_mm256_castsi128_si256(r1), r2, 1);
-      const auto g = _mm256_inserti128_si256(_mm256_castsi128_si256(g1), g2, 1);
-      const auto b = _mm256_inserti128_si256(_mm256_castsi128_si256(b1), b2, 1);
-      return {{r, g, b}};
+    const uint8x16_t block[4] = {pxs.val[0], pxs.val[1], pxs.val[2], Alpha ? pxs.val[3] : vdupq_n_u8(255)};
+    auto eq = vceqq_u8(vld1q_u8(runs), vdupq_n_u8(0));
+    for(std::size_t c = 0; c < 4; ++c){
+      eq = vandq_u8(eq, vceqq_u8(index_lookup(index.planes[c], block[c], src), block[c]));
+      uint8x16x4_t plane;
+      for(std::size_t k = 0; k < 4; ++k)
+        plane.val[k] = index_lookup(index.planes[c], block[c], src_position[k]);
+      index.planes[c] = plane;
     }
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
   }
-  template<std::uint_fast8_t Channels, typename Pusher, typename Puller>
-  static inline void encode_avx2(Pusher& p_, Puller& pixels_, const desc& desc){
+  template<std::uint_fast8_t Channels, bool RegisterIndex = default_register_index, typename Pusher, typename Puller, typename Length>
+  static inline void encode_neon(Pusher& p_, Puller& pixels_, encode_state& state, Length px_len){
     static constexpr bool Alpha = Channels == 4;
     std::uint8_t* p = p_.raw_pointer();
-    const std::uint8_t* pixels = pixels_.raw_pointer();
+    auto pixels = pixels_.raw_pointer();
 
-    rgba_t index[index_size] = {};
+    rgba_t index[index_size];
+    std::memcpy(index, state.index, sizeof(index));
+    [[maybe_unused]] index_registers registers;
+    if constexpr(RegisterIndex)
+      registers = load_index(index);
 
-    const auto zero = _mm256_setzero_si256();
+    const auto zero = vdupq_n_u8(0);
+    static constexpr std::uint8_t iota_[simd_lanes] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    const auto iota = vld1q_u8(iota_);
 
     pixels_type<Alpha> prev;
-    prev.val[0] = prev.val[1] = prev.val[2] = zero;
+    prev.val[0] = vdupq_n_u8(state.px.r);
+    prev.val[1] = vdupq_n_u8(state.px.g);
+    prev.val[2] = vdupq_n_u8(state.px.b);
     if constexpr(Alpha)
-      prev.val[3] = _mm256_set1_epi8(static_cast<char>(0xff));
+      prev.val[3] = vdupq_n_u8(state.px.a);
 
-    std::size_t run = 0;
-    rgba_t px = {0, 0, 0, 255};
-    auto prev_hash = static_cast<std::uint8_t>(index_size);
+    std::size_t run = state.run;
+    rgba_t px = state.px;
+    auto prev_hash = state.prev_hash;
 
-    std::size_t px_len = desc.width * desc.height;
-    std::size_t simd_len = px_len / simd_lanes;
-    const std::size_t simd_len_32 = simd_len * simd_lanes;
-    px_len -= simd_len_32;
-    pixels_.advance(simd_len_32*Channels);
+    const std::size_t tail = px_len % simd_lanes;
+    std::size_t simd_len = px_len / simd_lanes + (tail != 0);
+    pixels_.advance(px_len*Channels);
+    padded_tail<Channels, simd_lanes> tail_buffer;
+    count<&stats::simd_pixels>(px_len);
     while(simd_len--){
+      count<&stats::simd_blocks>();
+      if(simd_len == 0 && tail != 0)
+        pixels = tail_buffer.pad(pixels, tail);
       const auto pxs = load<Alpha>(pixels);
       pixels_type<Alpha> diff;
-      diff.val[0] = _mm256_sub_epi8(pxs.val[0], prev_vector(pxs.val[0], prev.val[0]));
-      diff.val[1] = _mm256_sub_epi8(pxs.val[1], prev_vector(pxs.val[1], prev.val[1]));
-      diff.val[2] = _mm256_sub_epi8(pxs.val[2], prev_vector(pxs.val[2], prev.val[2]));
+      diff.val[0] = vsubq_u8(pxs.val[0], vextq_u8(prev.val[0], pxs.val[0], simd_lanes-1));
+      diff.val[1] = vsubq_u8(pxs.val[1], vextq_u8(prev.val[1], pxs.val[1], simd_lanes-1));
+      diff.val[2] = vsubq_u8(pxs.val[2], vextq_u8(prev.val[2], pxs.val[2], simd_lanes-1));
       bool alpha = true;
       if constexpr(Alpha){
-        diff.val[3] = _mm256_sub_epi8(pxs.val[3], prev_vector(pxs.val[3], prev.val[3]));
-        alpha = _mm256_testz_si256(diff.val[3], diff.val[3]);
-        diff.val[3] = _mm256_cmpeq_epi8(diff.val[3], zero);
+        diff.val[3] = vsubq_u8(pxs.val[3], vextq_u8(prev.val[3], pxs.val[3], simd_lanes-1));
+        diff.val[3] = vceqq_u8(diff.val[3], zero);
+        alpha = vminvq_u8(diff.val[3]) != 0;
       }
-      const auto ored = _mm256_or_si256(_mm256_or_si256(diff.val[0], diff.val[1]), diff.val[2]);
-      auto runv = _mm256_cmpeq_epi8(ored, zero);
-      if(_mm256_testz_si256(ored, ored) && alpha){
+      auto runv = vceqq_u8(vorrq_u8(vorrq_u8(diff.val[0], diff.val[1]), diff.val[2]), zero);
+      if(vminvq_u8(runv) != 0 && alpha){
+        count<&stats::run_blocks>();
         run += simd_lanes;
-        pixels += simd_lanes*Channels;
+        advance_pixels<Channels>(pixels, simd_lanes);
         continue;
       }
       if constexpr(Alpha)
-        runv = _mm256_and_si256(runv, diff.val[3]);
-      const auto r = lsb32(~_mm256_movemask_epi8(runv));
+        runv = vandq_u8(runv, diff.val[3]);
+      const auto r = vminvq_u8(vorrq_u8(vandq_u8(vmvnq_u8(runv), iota), runv));
       run += r;
-      pixels += r*Channels;
+      advance_pixels<Channels>(pixels, r);
       if(run > 0){
         while(run >= 62)[[unlikely]]{
           static constexpr std::uint8_t x = chunk_tag::run | 61;
@@ -933,7 +1522,7 @@ class qoi{
           run -= 62;
         }
         if(run > 1){
-          *p++ = static_cast<std::uint8_t>(chunk_tag::run | (run-1));
+          *p++ = chunk_tag::run | (run-1);
           run = 0;
         }
         else if(run == 1){
@@ -944,34 +1533,205 @@ class qoi{
           run = 0;
         }
       }
-      const auto two = _mm256_set1_epi8(2);
-      diff.val[0] = _mm256_add_epi8(diff.val[0], two);
-      diff.val[1] = _mm256_add_epi8(diff.val[1], two);
-      diff.val[2] = _mm256_add_epi8(diff.val[2], two);
-      const auto diffor = _mm256_or_si256(_mm256_or_si256(diff.val[0], diff.val[1]), diff.val[2]);
-      const auto diffv = _mm256_and_si256(_mm256_or_si256(_mm256_or_si256(_mm256_set1_epi8(chunk_tag::diff), slli_epi8<4>(diff.val[0])), _mm256_or_si256(slli_epi8<2>(diff.val[1]), diff.val[2])), _mm256_cmpeq_epi8(_mm256_and_si256(diffor, _mm256_set1_epi8(0b11)), diffor));
-      const auto eight = _mm256_set1_epi8(8);
-      diff.val[0] = _mm256_add_epi8(_mm256_sub_epi8(diff.val[0], diff.val[1]), eight);
-      diff.val[2] = _mm256_add_epi8(_mm256_sub_epi8(diff.val[2], diff.val[1]), eight);
-      diff.val[1] = _mm256_add_epi8(diff.val[1], _mm256_set1_epi8(30));
-      const auto luma_mask = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
-      const auto lu = _mm256_permutevar8x32_epi32(_mm256_and_si256(_mm256_or_si256(_mm256_set1_epi8(static_cast<char>(chunk_tag::luma)), diff.val[1]), _mm256_cmpeq_epi8(_mm256_or_si256(_mm256_and_si256(_mm256_or_si256(diff.val[0], diff.val[2]), _mm256_set1_epi8(static_cast<char>(0xf0))), _mm256_and_si256(diff.val[1], _mm256_set1_epi8(static_cast<char>(0xc0)))), zero)), luma_mask);
-      const auto ma = _mm256_permutevar8x32_epi32(_mm256_or_si256(slli_epi8<4>(diff.val[0]), diff.val[2]), luma_mask);
-      __m256i hash;
+      const auto two = vdupq_n_u8(2);
+      diff.val[0] = vaddq_u8(diff.val[0], two);
+      diff.val[1] = vaddq_u8(diff.val[1], two);
+      diff.val[2] = vaddq_u8(diff.val[2], two);
+      const auto four = vdupq_n_u8(4);
+      const auto diffv = vandq_u8(vorrq_u8(vorrq_u8(vdupq_n_u8(chunk_tag::diff), vshlq_n_u8(diff.val[0], 4)), vorrq_u8(vshlq_n_u8(diff.val[1], 2), diff.val[2])), vcltq_u8(vorrq_u8(vorrq_u8(diff.val[0], diff.val[1]), diff.val[2]), four));
+      const auto eight = vdupq_n_u8(8);
+      diff.val[0] = vaddq_u8(vsubq_u8(diff.val[0], diff.val[1]), eight);
+      diff.val[2] = vaddq_u8(vsubq_u8(diff.val[2], diff.val[1]), eight);
+      diff.val[1] = vaddq_u8(diff.val[1], vdupq_n_u8(30));
+      const auto lu = vandq_u8(vorrq_u8(vdupq_n_u8(chunk_tag::luma), diff.val[1]), vceqq_u8(vorrq_u8(vandq_u8(vorrq_u8(diff.val[0], diff.val[2]), vdupq_n_u8(0xf0)), vandq_u8(diff.val[1], vdupq_n_u8(0xc0))), zero));
+      const auto ma = vorrq_u8(vshlq_n_u8(diff.val[0], 4), diff.val[2]);
+      uint8x16_t hash;
       if constexpr(Alpha)
-        hash = _mm256_and_si256(_mm256_add_epi8(_mm256_add_epi8(mul_epi8<3>(pxs.val[0]), mul_epi8<5>(pxs.val[1])), _mm256_add_epi8(mul_epi8<7>(pxs.val[2]), mul_epi8<11>(pxs.val[3]))), _mm256_set1_epi8(63));
+        hash = vandq_u8(vaddq_u8(vaddq_u8(vmulq_u8(pxs.val[0], vdupq_n_u8(3)), vmulq_u8(pxs.val[1], vdupq_n_u8(5))), vaddq_u8(vmulq_u8(pxs.val[2], vdupq_n_u8(7)), vmulq_u8(pxs.val[3], vdupq_n_u8(11)))), vdupq_n_u8(63));
       else
-        hash = _mm256_and_si256(_mm256_add_epi8(_mm256_add_epi8(mul_epi8<3>(pxs.val[0]), mul_epi8<5>(pxs.val[1])), _mm256_add_epi8(mul_epi8<7>(pxs.val[2]), _mm256_set1_epi8(static_cast<std::uint8_t>(255*11)))), _mm256_set1_epi8(63));
-      alignas(alignof(__m256i)) std::uint8_t runs[simd_lanes], diffs[simd_lanes], lumas[simd_lanes*2], hashs[simd_lanes];
-      [[maybe_unused]] alignas(alignof(__m256i)) std::uint8_t alphas[simd_lanes];
-      _mm256_store_si256(reinterpret_cast<__m256i*>(runs), runv);
-      _mm256_store_si256(reinterpret_cast<__m256i*>(diffs), diffv);
-      _mm256_store_si256(reinterpret_cast<__m256i*>(lumas), _mm256_unpacklo_epi8(lu, ma));
-      _mm256_store_si256(reinterpret_cast<__m256i*>(lumas)+1, _mm256_unpackhi_epi8(lu, ma));
-      _mm256_store_si256(reinterpret_cast<__m256i*>(hashs), hash);
-      if constexpr(Alpha)
+        hash = vandq_u8(vaddq_u8(vaddq_u8(vmulq_u8(pxs.val[0], vdupq_n_u8(3)), vmulq_u8(pxs.val[1], vdupq_n_u8(5))), vaddq_u8(vmulq_u8(pxs.val[2], vdupq_n_u8(7)), vdupq_n_u8(static_cast<std::uint8_t>(255*11)))), vdupq_n_u8(63));
+      std::uint8_t runs[simd_lanes], diffs[simd_lanes], lumas[simd_lanes*2], hashs[simd_lanes];
+      [[maybe_unused]] std::uint8_t alphas[simd_lanes];
+      vst1q_u8(runs, runv);
+      vst1q_u8(diffs, diffv);
+      vst2q_u8(lumas, (uint8x16x2_t{lu, ma}));
+      vst1q_u8(hashs, hash);
+      if constexpr(Alpha)
+        if(!alpha)
+          vst1q_u8(alphas, diff.val[3]);
+      [[maybe_unused]] std::uint64_t hits;
+      if constexpr(RegisterIndex)
+        hits = resolve_index<Alpha>(registers, pxs, hash, runs, hashs);
+      for(std::size_t i = r; i < simd_lanes; ++i){
+        if(runs[i]){
+          ++run;
+          advance_pixels<Channels>(pixels, 1);
+          continue;
+        }
+        if(run > 1){
+          *p++ = chunk_tag::run | (run-1);
+          run = 0;
+        }
+        else if(run == 1){
+          if(prev_hash == index_size)[[unlikely]]
+            *p++ = chunk_tag::run;
+          else
+            *p++ = chunk_tag::index | prev_hash;
+          run = 0;
+        }
+        const auto index_pos = hashs[i];
+        prev_hash = index_pos;
+        read_pixel<Channels>(&px, pixels);
+        if constexpr(RegisterIndex){
+          if(hits >> i*4 & 1){
+            *p++ = chunk_tag::index | index_pos;
+            continue;
+          }
+        }
+        else{
+          if(index[index_pos] == px){
+            *p++ = chunk_tag::index | index_pos;
+            continue;
+          }
+          index[index_pos] = px;
+        }
+
+        if constexpr(Alpha)
+          if(!alpha && !alphas[i]){
+            *p++ = chunk_tag::rgba;
+            std::memcpy(p, &px, 4);
+            p += 4;
+            continue;
+          }
+        if(diffs[i])
+          *p++ = diffs[i];
+        else if(lumas[i*2]){
+          std::memcpy(p, lumas + i*2, 2);
+          p += 2;
+        }
+        else{
+          *p++ = chunk_tag::rgb;
+          efficient_memcpy<3>(p, &px);
+          p += 3;
+        }
+      }
+      prev = pxs;
+    }
+    p_.advance(p-p_.raw_pointer());
+
+    if constexpr(RegisterIndex)
+      store_index(index, registers);
+    std::memcpy(state.index, index, sizeof(index));
+    state.px = px;
+    state.prev_hash = prev_hash;
+    state.run = run - (tail != 0 ? simd_lanes - tail : 0);
+  }
+#else
+  // the remaining pixels and the trailing run, in the form the original kernel hands them over
+  template<std::uint_fast8_t Channels, typename Pusher, typename Puller>
+  static inline void encode_body(Pusher& p, Puller& pixels, rgba_t (&index)[index_size], std::size_t px_len, local_rgba_pixel_t<Channels == 4u> px_prev, std::uint8_t prev_hash, std::size_t run){
+    encode_state state;
+    std::memcpy(state.index, index, sizeof(index));
+    efficient_memcpy<Channels>(&state.px, &px_prev);
+    state.prev_hash = prev_hash;
+    state.run = run;
+    encode_body<Channels>(p, pixels, state, px_len);
+    push_run(p, state.run);
+  }
+  static constexpr std::size_t simd_lanes = 16;
+  template<std::uint_fast8_t Channels, typename Pusher, typename Puller>
+  static inline void encode_neon(Pusher& p_, Puller& pixels_, const desc& desc){
+    static constexpr bool Alpha = Channels == 4;
+    std::uint8_t* p = p_.raw_pointer();
+    const std::uint8_t* pixels = pixels_.raw_pointer();
+
+    rgba_t index[index_size] = {};
+
+    const auto zero = vdupq_n_u8(0);
+    static constexpr std::uint8_t iota_[simd_lanes] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    const auto iota = vld1q_u8(iota_);
+
+    pixels_type<Alpha> prev;
+    prev.val[0] = prev.val[1] = prev.val[2] = zero;
+    if constexpr(Alpha)
+      prev.val[3] = vdupq_n_u8(255);
+
+    std::size_t run = 0;
+    rgba_t px = {0, 0, 0, 255};
+    auto prev_hash = static_cast<std::uint8_t>(index_size);
+
+    std::size_t px_len = desc.width * desc.height;
+    std::size_t simd_len = px_len / simd_lanes;
+    const std::size_t simd_len_16 = simd_len * simd_lanes;
+    px_len -= simd_len_16;
+    pixels_.advance(simd_len_16*Channels);
+    while(simd_len--){
+      const auto pxs = load<Alpha>(pixels);
+      pixels_type<Alpha> diff;
+      diff.val[0] = vsubq_u8(pxs.val[0], vextq_u8(prev.val[0], pxs.val[0], simd_lanes-1));
+      diff.val[1] = vsubq_u8(pxs.val[1], vextq_u8(prev.val[1], pxs.val[1], simd_lanes-1));
+      diff.val[2] = vsubq_u8(pxs.val[2], vextq_u8(prev.val[2], pxs.val[2], simd_lanes-1));
+      bool alpha = true;
+      if constexpr(Alpha){
+        diff.val[3] = vsubq_u8(pxs.val[3], vextq_u8(prev.val[3], pxs.val[3], simd_lanes-1));
+        diff.val[3] = vceqq_u8(diff.val[3], zero);
+        alpha = vminvq_u8(diff.val[3]) != 0;
+      }
+      auto runv = vceqq_u8(vorrq_u8(vorrq_u8(diff.val[0], diff.val[1]), diff.val[2]), zero);
+      if(vminvq_u8(runv) != 0 && alpha){
+        run += simd_lanes;
+        pixels += simd_lanes*Channels;
+        continue;
+      }
+      if constexpr(Alpha)
+        runv = vandq_u8(runv, diff.val[3]);
+      const auto r = vminvq_u8(vorrq_u8(vandq_u8(vmvnq_u8(runv), iota), runv));
+      run += r;
+      pixels += r*Channels;
+      if(run > 0){
+        while(run >= 62)[[unlikely]]{
+          static constexpr std::uint8_t x = chunk_tag::run | 61;
+          *p++ = x;
+          run -= 62;
+        }
+        if(run > 1){
+          *p++ = chunk_tag::run | (run-1);
+          run = 0;
+        }
+        else if(run == 1){
+          if(prev_hash == index_size)[[unlikely]]
+            *p++ = chunk_tag::run;
+          else
+            *p++ = chunk_tag::index | prev_hash;
+          run = 0;
+        }
+      }
+      const auto two = vdupq_n_u8(2);
+      diff.val[0] = vaddq_u8(diff.val[0], two);
+      diff.val[1] = vaddq_u8(diff.val[1], two);
+      diff.val[2] = vaddq_u8(diff.val[2], two);
+      const auto four = vdupq_n_u8(4);
+      const auto diffv = vandq_u8(vorrq_u8(vorrq_u8(vdupq_n_u8(chunk_tag::diff), vshlq_n_u8(diff.val[0], 4)), vorrq_u8(vshlq_n_u8(diff.val[1], 2), diff.val[2])), vcltq_u8(vorrq_u8(vorrq_u8(diff.val[0], diff.val[1]), diff.val[2]), four));
+      const auto eight = vdupq_n_u8(8);
+      diff.val[0] = vaddq_u8(vsubq_u8(diff.val[0], diff.val[1]), eight);
+      diff.val[2] = vaddq_u8(vsubq_u8(diff.val[2], diff.val[1]), eight);
+      diff.val[1] = vaddq_u8(diff.val[1], vdupq_n_u8(30));
+      const auto lu = vandq_u8(vorrq_u8(vdupq_n_u8(chunk_tag::luma), diff.val[1]), vceqq_u8(vorrq_u8(vandq_u8(vorrq_u8(diff.val[0], diff.val[2]), vdupq_n_u8(0xf0)), vandq_u8(diff.val[1], vdupq_n_u8(0xc0))), zero));
+      const auto ma = vorrq_u8(vshlq_n_u8(diff.val[0], 4), diff.val[2]);
+      uint8x16_t hash;
+      if constexpr(Alpha)
+        hash = vandq_u8(vaddq_u8(vaddq_u8(vmulq_u8(pxs.val[0], vdupq_n_u8(3)), vmulq_u8(pxs.val[1], vdupq_n_u8(5))), vaddq_u8(vmulq_u8(pxs.val[2], vdupq_n_u8(7)), vmulq_u8(pxs.val[3], vdupq_n_u8(11)))), vdupq_n_u8(63));
+      else
+        hash = vandq_u8(vaddq_u8(vaddq_u8(vmulq_u8(pxs.val[0], vdupq_n_u8(3)), vmulq_u8(pxs.val[1], vdupq_n_u8(5))), vaddq_u8(vmulq_u8(pxs.val[2], vdupq_n_u8(7)), vdupq_n_u8(static_cast<std::uint8_t>(255*11)))), vdupq_n_u8(63));
+      std::uint8_t runs[simd_lanes], diffs[simd_lanes], lumas[simd_lanes*2], hashs[simd_lanes];
+      [[maybe_unused]] std::uint8_t alphas[simd_lanes];
+      vst1q_u8(runs, runv);
+      vst1q_u8(diffs, diffv);
+      vst2q_u8(lumas, (uint8x16x2_t{lu, ma}));
+      vst1q_u8(hashs, hash);
+      if constexpr(Alpha)
         if(!alpha)
-          _mm256_store_si256(reinterpret_cast<__m256i*>(alphas), diff.val[3]);
+          vst1q_u8(alphas, diff.val[3]);
       for(std::size_t i = r; i < simd_lanes; ++i){
         if(runs[i]){
           ++run;
@@ -979,7 +1739,7 @@ class qoi{
           continue;
         }
         if(run > 1){
-          *p++ = static_cast<std::uint8_t>(chunk_tag::run | (run-1));
+          *p++ = chunk_tag::run | (run-1);
           run = 0;
         }
         else if(run == 1){
@@ -1033,99 +1793,1275 @@ class qoi{
     push<sizeof(padding)>(p_, padding);
   }
 #endif
-#endif
-
-  template<std::uint_fast8_t Channels, typename Pusher, typename Puller>
-  static inline void encode_impl(Pusher& p, Puller& pixels, const desc& desc){
-    rgba_t index[index_size] = {};
-
-    std::size_t px_len = desc.width * desc.height;
-    encode_body<Channels>(p, pixels, index, px_len);
-
-    push<sizeof(padding)>(p, padding);
+#elif defined(__riscv_vector) && defined(QOIXX_EXPERIMENTAL_SIMD)
+  template<bool Alpha>
+  using pixels_type = std::conditional_t<Alpha, vuint8m1x4_t, vuint8m1x3_t>;
+  template<std::size_t ImmIndex>
+  static inline vuint8m1_t get(vuint8m1x4_t t)noexcept{
+    return __riscv_vget_v_u8m1x4_u8m1(t, ImmIndex);
   }
-
-  template<typename Puller>
-  static inline desc decode_header(Puller& p){
-    desc d;
-    const auto magic_ = read_32(p);
-    d.width = read_32(p);
-    d.height = read_32(p);
-    d.channels = p.pull();
-    d.colorspace = static_cast<qoi::colorspace>(p.pull());
-    if(
-      d.width == 0 || d.height == 0 || magic_ != magic ||
-      d.channels < 3 || d.channels > 4 ||
-      d.height >= pixels_max / d.width
-    )[[unlikely]]
-      throw std::runtime_error("qoixx::qoi::decode: invalid header");
-    return d;
+  template<std::size_t ImmIndex>
+  static inline vuint8m1_t get(vuint8m1x3_t t)noexcept{
+    return __riscv_vget_v_u8m1x3_u8m1(t, ImmIndex);
   }
-
-#ifndef QOIXX_DECODE_WITH_TABLES
-#define QOIXX_HPP_DECODE_WITH_TABLES_NOT_DEFINED
-#ifdef __aarch64__
-#define QOIXX_DECODE_WITH_TABLES 0
-#else
-#define QOIXX_DECODE_WITH_TABLES 1
-#endif
-#endif
-
-#if QOIXX_DECODE_WITH_TABLES
-  static constexpr std::size_t hash_table_offset = std::numeric_limits<std::uint8_t>::max()+1 - chunk_tag::diff;
-  static constexpr std::array<int, std::numeric_limits<std::uint8_t>::max()+1+chunk_tag::run-chunk_tag::diff> create_hash_diff_table(){
-    std::array<int, std::numeric_limits<std::uint8_t>::max()+1+chunk_tag::run-chunk_tag::diff> table = {};
-    for(std::size_t i = 0; i <= std::numeric_limits<std::uint8_t>::max(); ++i){
-      constexpr std::uint32_t mask_tail_4 = 0b0000'1111u;
-      const auto vr = (i >> 4);
-      const auto vb = (i & mask_tail_4);
-      table[i] = (vr*3 + vb*7) % index_size;
-    }
-    for(std::size_t i = chunk_tag::diff; i < chunk_tag::luma; ++i){
-      constexpr std::uint32_t mask_tail_2 = 0b0000'0011u;
-      const auto vr = static_cast<int>((i >> 4) & mask_tail_2) - 2;
-      const auto vg = static_cast<int>((i >> 2) & mask_tail_2) - 2;
-      const auto vb = static_cast<int>( i       & mask_tail_2) - 2;
-      table[i+hash_table_offset] = static_cast<std::uint8_t>((vr*3 + vg*5 + vb*7) % index_size);
-    }
-    for(std::size_t i = chunk_tag::luma; i < chunk_tag::run; ++i){
-        constexpr int vgv = chunk_tag::luma+40;
-        const int vg = i - vgv;
-        table[i+hash_table_offset] = static_cast<std::uint8_t>((vg*3 + (vg+8)*5 + vg*7) % index_size);
-    }
-    return table;
+  template<bool Alpha>
+  static inline pixels_type<Alpha> load(const std::uint8_t* ptr, std::size_t vl)noexcept{
+    if constexpr(Alpha)
+      return __riscv_vlseg4e8_v_u8m1x4(ptr, vl);
+    else
+      return __riscv_vlseg3e8_v_u8m1x3(ptr, vl);
   }
-  static constexpr std::array<std::array<std::uint8_t, 2>, std::numeric_limits<std::uint8_t>::max()+1> create_luma_table(){
-    std::array<std::array<std::uint8_t, 2>, std::numeric_limits<std::uint8_t>::max()+1> table = {};
-    for(std::size_t i = 0; i <= std::numeric_limits<std::uint8_t>::max(); ++i){
-      constexpr std::uint32_t mask_tail_4 = 0b0000'1111u;
-      const auto vr = (i >> 4);
-      const auto vb = (i & mask_tail_4);
-      table[i][0] = static_cast<uint8_t>(vr);
-      table[i][1] = static_cast<uint8_t>(vb);
-    }
-    return table;
+  template<bool Alpha, std::size_t N>
+  static inline pixels_type<Alpha> load(const std::array<const std::uint8_t*, N>& ptr, std::size_t vl)noexcept{
+    if constexpr(!Alpha)
+      return __riscv_vcreate_v_u8m1x3(__riscv_vle8_v_u8m1(ptr[0], vl), __riscv_vle8_v_u8m1(ptr[1], vl), __riscv_vle8_v_u8m1(ptr[2], vl));
+    else if constexpr(N == 4)
+      return __riscv_vcreate_v_u8m1x4(__riscv_vle8_v_u8m1(ptr[0], vl), __riscv_vle8_v_u8m1(ptr[1], vl), __riscv_vle8_v_u8m1(ptr[2], vl), __riscv_vle8_v_u8m1(ptr[3], vl));
+    else
+      return __riscv_vcreate_v_u8m1x4(__riscv_vle8_v_u8m1(ptr[0], vl), __riscv_vle8_v_u8m1(ptr[1], vl), __riscv_vle8_v_u8m1(ptr[2], vl), __riscv_vmv_v_x_u8m1(255, vl));
   }
-  static constexpr std::array<std::array<std::int8_t, 3>, chunk_tag::luma> create_diff_table(){
-    std::array<std::array<std::int8_t, 3>, chunk_tag::luma> table = {};
-    for(std::size_t i = chunk_tag::diff; i < chunk_tag::luma; ++i){
-      constexpr std::uint32_t mask_tail_2 = 0b0000'0011u;
-      const auto vr = ((i >> 4) & mask_tail_2) - 2;
-      const auto vg = ((i >> 2) & mask_tail_2) - 2;
-      const auto vb = ( i       & mask_tail_2) - 2;
-      table[i][0] = static_cast<uint8_t>(vr);
-      table[i][1] = static_cast<uint8_t>(vg);
-      table[i][2] = static_cast<uint8_t>(vb);
+  template<bool Alpha>
+  static inline pixels_type<Alpha> load(const detail::delta_pointer& ptr, std::size_t vl)noexcept{
+    const auto x = load<Alpha>(ptr.cur, vl);
+    const auto y = load<Alpha>(ptr.prev, vl);
+    if constexpr(Alpha)
+      return __riscv_vcreate_v_u8m1x4(__riscv_vxor_vv_u8m1(get<0>(x), get<0>(y), vl), __riscv_vxor_vv_u8m1(get<1>(x), get<1>(y), vl), __riscv_vxor_vv_u8m1(get<2>(x), get<2>(y), vl), __riscv_vxor_vv_u8m1(get<3>(x), get<3>(y), vl));
+    else
+      return __riscv_vcreate_v_u8m1x3(__riscv_vxor_vv_u8m1(get<0>(x), get<0>(y), vl), __riscv_vxor_vv_u8m1(get<1>(x), get<1>(y), vl), __riscv_vxor_vv_u8m1(get<2>(x), get<2>(y), vl));
+  }
+  template<bool Alpha, std::size_t N>
+  requires(Alpha == (N == 2))
+  static inline pixels_type<Alpha> load(const detail::gray_pointer<N>& ptr, std::size_t vl)noexcept{
+    if constexpr(N == 1){
+      const auto g = __riscv_vle8_v_u8m1(ptr.p, vl);
+      return __riscv_vcreate_v_u8m1x3(g, g, g);
+    }
+    else{
+      const auto ga = __riscv_vlseg2e8_v_u8m1x2(ptr.p, vl);
+      const auto g = __riscv_vget_v_u8m1x2_u8m1(ga, 0);
+      return __riscv_vcreate_v_u8m1x4(g, g, g, __riscv_vget_v_u8m1x2_u8m1(ga, 1));
     }
-    return table;
   }
-#endif
+  // upper bound of the lanes processed per block, whatever VLEN is
+  static constexpr std::size_t simd_lanes = 64;
+  template<std::uint_fast8_t Channels, typename Pusher, typename Puller, typename Length>
+  static inline void encode_rvv(Pusher& p_, Puller& pixels_, encode_state& state, Length px_len){
+    static constexpr bool Alpha = Channels == 4;
+    std::uint8_t* p = p_.raw_pointer();
+    auto pixels = pixels_.raw_pointer();
 
-  template<std::size_t Channels, typename Pusher, typename Puller>
-  static inline void decode_impl(Pusher& pixels, Puller& p, std::size_t px_len, std::size_t size){
-#ifndef __aarch64__
-    using rgba_t = std::conditional_t<Channels == 4, qoi::rgba_t, qoi::rgb_t>;
-#endif
+    rgba_t index[index_size];
+    std::memcpy(index, state.index, sizeof(index));
+
+    std::size_t run = state.run;
+    rgba_t px = state.px;
+    auto prev_hash = state.prev_hash;
+
+    count<&stats::simd_pixels>(px_len);
+    for(std::size_t done = 0; done < px_len;){
+      count<&stats::simd_blocks>();
+      const auto vl = __riscv_vsetvl_e8m1(std::min(px_len - done, simd_lanes));
+      done += vl;
+      const auto zero = __riscv_vmv_v_x_u8m1(0, vl);
+      const auto pxs = load<Alpha>(pixels, vl);
+      // px is the last pixel of the previous block
+      auto rv = __riscv_vsub_vv_u8m1(get<0>(pxs), __riscv_vslide1up_vx_u8m1(get<0>(pxs), px.r, vl), vl);
+      auto gv = __riscv_vsub_vv_u8m1(get<1>(pxs), __riscv_vslide1up_vx_u8m1(get<1>(pxs), px.g, vl), vl);
+      auto bv = __riscv_vsub_vv_u8m1(get<2>(pxs), __riscv_vslide1up_vx_u8m1(get<2>(pxs), px.b, vl), vl);
+      [[maybe_unused]] vbool8_t av;
+      bool alpha = true;
+      if constexpr(Alpha){
+        av = __riscv_vmseq_vv_u8m1_b8(get<3>(pxs), __riscv_vslide1up_vx_u8m1(get<3>(pxs), px.a, vl), vl);
+        alpha = __riscv_vcpop_m_b8(av, vl) == vl;
+      }
+      auto runv = __riscv_vmseq_vx_u8m1_b8(__riscv_vor_vv_u8m1(__riscv_vor_vv_u8m1(rv, gv, vl), bv, vl), 0, vl);
+      if constexpr(Alpha)
+        runv = __riscv_vmand_mm_b8(runv, av, vl);
+      const auto first = __riscv_vfirst_m_b8(__riscv_vmnot_m_b8(runv, vl), vl);
+      if(first < 0){
+        count<&stats::run_blocks>();
+        run += vl;
+        advance_pixels<Channels>(pixels, vl);
+        continue;
+      }
+      const auto r = static_cast<std::size_t>(first);
+      run += r;
+      advance_pixels<Channels>(pixels, r);
+      if(run > 0){
+        while(run >= 62)[[unlikely]]{
+          static constexpr std::uint8_t x = chunk_tag::run | 61;
+          *p++ = x;
+          run -= 62;
+        }
+        if(run > 1){
+          *p++ = static_cast<std::uint8_t>(chunk_tag::run | (run-1));
+          run = 0;
+        }
+        else if(run == 1){
+          if(prev_hash == index_size)[[unlikely]]
+            *p++ = chunk_tag::run;
+          else
+            *p++ = chunk_tag::index | prev_hash;
+          run = 0;
+        }
+      }
+      rv = __riscv_vadd_vx_u8m1(rv, 2, vl);
+      gv = __riscv_vadd_vx_u8m1(gv, 2, vl);
+      bv = __riscv_vadd_vx_u8m1(bv, 2, vl);
+      const auto is_diff = __riscv_vmsltu_vx_u8m1_b8(__riscv_vor_vv_u8m1(__riscv_vor_vv_u8m1(rv, gv, vl), bv, vl), 4, vl);
+      const auto diffv = __riscv_vmerge_vvm_u8m1(zero, __riscv_vor_vv_u8m1(__riscv_vor_vx_u8m1(__riscv_vsll_vx_u8m1(rv, 4, vl), static_cast<std::uint8_t>(chunk_tag::diff), vl), __riscv_vor_vv_u8m1(__riscv_vsll_vx_u8m1(gv, 2, vl), bv, vl), vl), is_diff, vl);
+      rv = __riscv_vadd_vx_u8m1(__riscv_vsub_vv_u8m1(rv, gv, vl), 8, vl);
+      bv = __riscv_vadd_vx_u8m1(__riscv_vsub_vv_u8m1(bv, gv, vl), 8, vl);
+      gv = __riscv_vadd_vx_u8m1(gv, 30, vl);
+      const auto is_luma = __riscv_vmseq_vx_u8m1_b8(__riscv_vor_vv_u8m1(__riscv_vand_vx_u8m1(__riscv_vor_vv_u8m1(rv, bv, vl), 0xf0, vl), __riscv_vand_vx_u8m1(gv, 0xc0, vl), vl), 0, vl);
+      const auto lu = __riscv_vmerge_vvm_u8m1(zero, __riscv_vor_vx_u8m1(gv, static_cast<std::uint8_t>(chunk_tag::luma), vl), is_luma, vl);
+      const auto ma = __riscv_vor_vv_u8m1(__riscv_vsll_vx_u8m1(rv, 4, vl), bv, vl);
+      vuint8m1_t hash;
+      if constexpr(Alpha)
+        hash = __riscv_vand_vx_u8m1(__riscv_vadd_vv_u8m1(__riscv_vadd_vv_u8m1(__riscv_vmul_vx_u8m1(get<0>(pxs), 3, vl), __riscv_vmul_vx_u8m1(get<1>(pxs), 5, vl), vl), __riscv_vadd_vv_u8m1(__riscv_vmul_vx_u8m1(get<2>(pxs), 7, vl), __riscv_vmul_vx_u8m1(get<3>(pxs), 11, vl), vl), vl), 63, vl);
+      else
+        hash = __riscv_vand_vx_u8m1(__riscv_vadd_vv_u8m1(__riscv_vadd_vv_u8m1(__riscv_vmul_vx_u8m1(get<0>(pxs), 3, vl), __riscv_vmul_vx_u8m1(get<1>(pxs), 5, vl), vl), __riscv_vadd_vx_u8m1(__riscv_vmul_vx_u8m1(get<2>(pxs), 7, vl), static_cast<std::uint8_t>(255*11), vl), vl), 63, vl);
+      std::uint8_t runs[simd_lanes], diffs[simd_lanes], lumas[simd_lanes*2], hashs[simd_lanes];
+      [[maybe_unused]] std::uint8_t alphas[simd_lanes];
+      __riscv_vse8_v_u8m1(runs, __riscv_vmerge_vxm_u8m1(zero, 1, runv, vl), vl);
+      __riscv_vse8_v_u8m1(diffs, diffv, vl);
+      __riscv_vsseg2e8_v_u8m1x2(lumas, __riscv_vcreate_v_u8m1x2(lu, ma), vl);
+      __riscv_vse8_v_u8m1(hashs, hash, vl);
+      if constexpr(Alpha)
+        if(!alpha)
+          __riscv_vse8_v_u8m1(alphas, __riscv_vmerge_vxm_u8m1(zero, 1, av, vl), vl);
+      for(std::size_t i = r; i < vl; ++i){
+        if(runs[i]){
+          ++run;
+          advance_pixels<Channels>(pixels, 1);
+          continue;
+        }
+        if(run > 1){
+          *p++ = static_cast<std::uint8_t>(chunk_tag::run | (run-1));
+          run = 0;
+        }
+        else if(run == 1){
+          if(prev_hash == index_size)[[unlikely]]
+            *p++ = chunk_tag::run;
+          else
+            *p++ = chunk_tag::index | prev_hash;
+          run = 0;
+        }
+        const auto index_pos = hashs[i];
+        prev_hash = index_pos;
+        read_pixel<Channels>(&px, pixels);
+        if(index[index_pos] == px){
+          *p++ = chunk_tag::index | index_pos;
+          continue;
+        }
+        index[index_pos] = px;
+
+        if constexpr(Alpha)
+          if(!alpha && !alphas[i]){
+            *p++ = chunk_tag::rgba;
+            std::memcpy(p, &px, 4);
+            p += 4;
+            continue;
+          }
+        if(diffs[i])
+          *p++ = diffs[i];
+        else if(lumas[i*2]){
+          std::memcpy(p, lumas + i*2, 2);
+          p += 2;
+        }
+        else{
+          *p++ = chunk_tag::rgb;
+          efficient_memcpy<3>(p, &px);
+          p += 3;
+        }
+      }
+    }
+    p_.advance(p-p_.raw_pointer());
+    pixels_.advance(px_len*Channels);
+
+    std::memcpy(state.index, index, sizeof(index));
+    state.px = px;
+    state.prev_hash = prev_hash;
+    state.run = run;
+  }
+#elif defined(__AVX2__) || defined(__SSE4_1__)
+  // encode_x86 and its stages are written once against the operations below, which are AVX2 or SSE4.1 at the vector width of the build
+#if defined(__AVX2__)
+  using vector_type = __m256i;
+  static constexpr std::size_t simd_lanes = 256/8;
+  static constexpr bool default_serial_emit = false;
+#else
+  using vector_type = __m128i;
+  static constexpr std::size_t simd_lanes = 128/8;
+  // SSE4.1-only cores (Silvermont, Goldmont) run pshufb and pblendvb as several uops, so the chunks are emitted lane by lane
+  // as encode_neon does instead of packed with compaction_table; the "emit" rows of qoimicrobench compare the two
+  static constexpr bool default_serial_emit = true;
+#endif
+  template<bool Alpha>
+  struct pixels_type{
+    vector_type val[3+Alpha];
+  };
+  // pshufb masks packing two 8-byte slots of a 128-bit lane, indexed by the length of the first one
+  alignas(16) static constexpr std::uint8_t compaction_table[8][16] = {
+    {8, 9, 10, 11, 12, 13, 14, 15, 128, 128, 128, 128, 128, 128, 128, 128},
+    {0, 8, 9, 10, 11, 12, 13, 14, 15, 128, 128, 128, 128, 128, 128, 128},
+    {0, 1, 8, 9, 10, 11, 12, 13, 14, 15, 128, 128, 128, 128, 128, 128},
+    {0, 1, 2, 8, 9, 10, 11, 12, 13, 14, 15, 128, 128, 128, 128, 128},
+    {0, 1, 2, 3, 8, 9, 10, 11, 12, 13, 14, 15, 128, 128, 128, 128},
+    {0, 1, 2, 3, 4, 8, 9, 10, 11, 12, 13, 14, 15, 128, 128, 128},
+    {0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, 14, 15, 128, 128},
+    {0, 1, 2, 3, 4, 5, 6, 8, 9, 10, 11, 12, 13, 14, 15, 128},
+  };
+#if defined(__AVX2__)
+  static inline vector_type setzero()noexcept{
+    return _mm256_setzero_si256();
+  }
+  static inline vector_type set1_epi8(std::uint8_t x)noexcept{
+    return _mm256_set1_epi8(static_cast<char>(x));
+  }
+  static inline vector_type set1_epi32(std::uint32_t x)noexcept{
+    return _mm256_set1_epi32(static_cast<int>(x));
+  }
+  static inline vector_type set1_epi64x(std::uint64_t x)noexcept{
+    return _mm256_set1_epi64x(static_cast<long long>(x));
+  }
+  static inline vector_type load_si(const void* ptr)noexcept{
+    return _mm256_load_si256(static_cast<const __m256i*>(ptr));
+  }
+  static inline void store_si(void* ptr, vector_type v)noexcept{
+    _mm256_store_si256(static_cast<__m256i*>(ptr), v);
+  }
+  static inline void storeu_si(void* ptr, vector_type v)noexcept{
+    _mm256_storeu_si256(static_cast<__m256i*>(ptr), v);
+  }
+  static inline vector_type add_epi8(vector_type a, vector_type b)noexcept{
+    return _mm256_add_epi8(a, b);
+  }
+  static inline vector_type sub_epi8(vector_type a, vector_type b)noexcept{
+    return _mm256_sub_epi8(a, b);
+  }
+  static inline vector_type and_si(vector_type a, vector_type b)noexcept{
+    return _mm256_and_si256(a, b);
+  }
+  static inline vector_type or_si(vector_type a, vector_type b)noexcept{
+    return _mm256_or_si256(a, b);
+  }
+  static inline vector_type andnot_si(vector_type a, vector_type b)noexcept{
+    return _mm256_andnot_si256(a, b);
+  }
+  static inline vector_type cmpeq_epi8(vector_type a, vector_type b)noexcept{
+    return _mm256_cmpeq_epi8(a, b);
+  }
+  static inline vector_type cmpgt_epi8(vector_type a, vector_type b)noexcept{
+    return _mm256_cmpgt_epi8(a, b);
+  }
+  static inline vector_type max_epu8(vector_type a, vector_type b)noexcept{
+    return _mm256_max_epu8(a, b);
+  }
+  static inline vector_type blendv_epi8(vector_type a, vector_type b, vector_type mask)noexcept{
+    return _mm256_blendv_epi8(a, b, mask);
+  }
+  static inline vector_type shuffle_epi8(vector_type a, vector_type b)noexcept{
+    return _mm256_shuffle_epi8(a, b);
+  }
+  static inline vector_type unpacklo_epi8(vector_type a, vector_type b)noexcept{
+    return _mm256_unpacklo_epi8(a, b);
+  }
+  static inline vector_type unpackhi_epi8(vector_type a, vector_type b)noexcept{
+    return _mm256_unpackhi_epi8(a, b);
+  }
+  static inline vector_type unpacklo_epi16(vector_type a, vector_type b)noexcept{
+    return _mm256_unpacklo_epi16(a, b);
+  }
+  static inline vector_type unpackhi_epi16(vector_type a, vector_type b)noexcept{
+    return _mm256_unpackhi_epi16(a, b);
+  }
+  template<int N>
+  static inline vector_type slli_epi16(vector_type v)noexcept{
+    return _mm256_slli_epi16(v, N);
+  }
+  template<int N>
+  static inline vector_type srli_epi16(vector_type v)noexcept{
+    return _mm256_srli_epi16(v, N);
+  }
+  // shifts each 128-bit lane left by N bytes
+  template<int N>
+  static inline vector_type bslli_si(vector_type v)noexcept{
+    return _mm256_slli_si256(v, N);
+  }
+  static inline bool testz(vector_type v)noexcept{
+    return _mm256_testz_si256(v, v);
+  }
+  static inline std::uint32_t movemask_epi8(vector_type v)noexcept{
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(v));
+  }
+  static inline std::uint8_t extract_last(vector_type v)noexcept{
+    return static_cast<std::uint8_t>(_mm256_extract_epi8(v, simd_lanes-1));
+  }
+  // the last lane of prev followed by all lanes of pxs but the last
+  static inline vector_type prev_vector(vector_type pxs, vector_type prev)noexcept{
+    const auto permute = _mm256_permute2x128_si256(pxs, pxs, 0x08);
+    const auto inserted = _mm256_inserti128_si256(permute, _mm256_extracti128_si256(prev, 1), 0);
+    return _mm256_alignr_epi8(pxs, inserted, 15);
+  }
+  // the last byte of the lower 128-bit lane in every byte of the upper one, which carries the prefix operations across the lanes
+  static inline vector_type carry_lanes(vector_type v)noexcept{
+    return _mm256_shuffle_epi8(_mm256_permute2x128_si256(v, v, 0x08), _mm256_set1_epi8(15));
+  }
+  // each 128-bit lane of v in both lanes of a vector
+  static inline void broadcast_quarters(vector_type* dst, vector_type v)noexcept{
+    dst[0] = _mm256_permute2x128_si256(v, v, 0x00);
+    dst[1] = _mm256_permute2x128_si256(v, v, 0x11);
+  }
+  static inline void store_rgba(std::uint32_t* dst, vector_type r, vector_type g, vector_type b, vector_type a)noexcept{
+    const auto rgl = _mm256_unpacklo_epi8(r, g), rgh = _mm256_unpackhi_epi8(r, g);
+    const auto bal = _mm256_unpacklo_epi8(b, a), bah = _mm256_unpackhi_epi8(b, a);
+    const auto x0 = _mm256_unpacklo_epi16(rgl, bal), x1 = _mm256_unpackhi_epi16(rgl, bal);
+    const auto x2 = _mm256_unpacklo_epi16(rgh, bah), x3 = _mm256_unpackhi_epi16(rgh, bah);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(dst), _mm256_permute2x128_si256(x0, x1, 0x20));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(dst)+1, _mm256_permute2x128_si256(x2, x3, 0x20));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(dst)+2, _mm256_permute2x128_si256(x0, x1, 0x31));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(dst)+3, _mm256_permute2x128_si256(x2, x3, 0x31));
+  }
+  // writes the 8-byte slots of the lanes packed at their offsets, in lane order; slots[i] holds lanes 2i and 2i+1 in its lower 128-bit lane
+  // and the lanes 16 above those in its upper one
+  static inline void compact_slots(std::uint8_t* out, const vector_type (&s0123)[4], const vector_type (&s45)[4], const std::uint8_t* lens, const std::uint8_t* offsets)noexcept{
+    __m256i slots[simd_lanes/4];
+    for(std::size_t i = 0; i < simd_lanes/4; ++i){
+      const auto slot = (i & 1) ? _mm256_unpackhi_epi32(s0123[i/2], s45[i/2]) : _mm256_unpacklo_epi32(s0123[i/2], s45[i/2]);
+      const auto mask = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(compaction_table[lens[i*2]]))), _mm_load_si128(reinterpret_cast<const __m128i*>(compaction_table[lens[i*2+simd_lanes/2]])), 1);
+      slots[i] = _mm256_shuffle_epi8(slot, mask);
+    }
+    for(std::size_t i = 0; i < simd_lanes/4; ++i)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + offsets[i*2]), _mm256_castsi256_si128(slots[i]));
+    for(std::size_t i = 0; i < simd_lanes/4; ++i)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + offsets[i*2+simd_lanes/2]), _mm256_extracti128_si256(slots[i], 1));
+  }
+  static inline __m128i loadu_si128(const std::uint8_t* ptr)noexcept{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+  }
+  static inline __m128i loadu_si128(const detail::delta_pointer& ptr)noexcept{
+    return _mm_xor_si128(loadu_si128(ptr.cur), loadu_si128(ptr.prev));
+  }
+  static inline __m256i loadu_si256(const std::uint8_t* ptr)noexcept{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+  }
+  static inline __m256i loadu_si256(const detail::delta_pointer& ptr)noexcept{
+    return _mm256_xor_si256(loadu_si256(ptr.cur), loadu_si256(ptr.prev));
+  }
+  template<bool Alpha, typename Pointer>
+  requires(std::same_as<Pointer, const std::uint8_t*> || std::same_as<Pointer, detail::delta_pointer>)
+  static inline pixels_type<Alpha> load(Pointer ptr)noexcept{
+    if constexpr(Alpha){
+      const auto t1 = loadu_si256(ptr);
+      const auto t2 = loadu_si256(ptr+simd_lanes);
+      const auto t3 = loadu_si256(ptr+simd_lanes*2);
+      const auto t4 = loadu_si256(ptr+simd_lanes*3);
+      const auto lo12 = _mm256_unpacklo_epi8(t1, t2);
+      const auto lo34 = _mm256_unpacklo_epi8(t3, t4);
+      const auto lolo12lo34 = _mm256_unpacklo_epi16(lo12, lo34);
+      const auto hilo12lo34 = _mm256_unpackhi_epi16(lo12, lo34);
+      const auto lololo12lo34hilo12lo34 = _mm256_unpacklo_epi32(lolo12lo34, hilo12lo34);
+      const auto hilolo12lo34hilo12lo34 = _mm256_unpackhi_epi32(lolo12lo34, hilo12lo34);
+      const auto hi12 = _mm256_unpackhi_epi8(t1, t2);
+      const auto hi34 = _mm256_unpackhi_epi8(t3, t4);
+      const auto lohi12hi34 = _mm256_unpacklo_epi16(hi12, hi34);
+      const auto hihi12hi34 = _mm256_unpackhi_epi16(hi12, hi34);
+      const auto lolohi12hi34hihi12hi34 = _mm256_unpacklo_epi32(lohi12hi34, hihi12hi34);
+      const auto lolololo12lo34hilo12lo34lolohi12hi34hihi12hi34 = _mm256_unpacklo_epi64(lololo12lo34hilo12lo34, lolohi12hi34hihi12hi34);
+      const auto hilololo12lo34hilo12lo34lolohi12hi34hihi12hi34 = _mm256_unpackhi_epi64(lololo12lo34hilo12lo34, lolohi12hi34hihi12hi34);
+      const auto hilohi12hi34hihi12hi34 = _mm256_unpackhi_epi32(lohi12hi34, hihi12hi34);
+      const auto lohilolo12lo34hilo12lo34hilohi12hi34hihi12hi34 = _mm256_unpacklo_epi64(hilolo12lo34hilo12lo34, hilohi12hi34hihi12hi34);
+      const auto hihilolo12lo34hilo12lo34hilohi12hi34hihi12hi34 = _mm256_unpackhi_epi64(hilolo12lo34hilo12lo34, hilohi12hi34hihi12hi34);
+      const auto mask1 = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+      const auto mask2 = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+      const auto r = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(lolololo12lo34hilo12lo34lolohi12hi34hihi12hi34, mask1), mask2);
+      const auto g = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(hilololo12lo34hilo12lo34lolohi12hi34hihi12hi34, mask1), mask2);
+      const auto b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(lohilolo12lo34hilo12lo34hilohi12hi34hihi12hi34, mask1), mask2);
+      const auto a = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(hihilolo12lo34hilo12lo34hilohi12hi34hihi12hi34, mask1), mask2);
+      return {{r, g, b, a}};
+    }
+    else{
+      const auto t1 = loadu_si128(ptr);
+      const auto t2 = loadu_si128(ptr+simd_lanes/2);
+      const auto t3 = loadu_si128(ptr+simd_lanes);
+      const auto t4 = loadu_si128(ptr+simd_lanes*3/2);
+      const auto t5 = loadu_si128(ptr+simd_lanes*2);
+      const auto t6 = loadu_si128(ptr+simd_lanes*5/2);
+      const auto mask01 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, 1, 4, 7, 10, 13, 2, 5, 8, 11, 14);
+      const auto mask02 = _mm_setr_epi8(2, 5, 8, 11, 14, 0, 3, 6, 9, 12, 15, 1, 4, 7, 10, 13);
+      const auto mask03 = _mm_setr_epi8(1, 4, 7, 10, 13, 2, 5, 8, 11, 14, 0, 3, 6, 9, 12, 15);
+      static constexpr char _128 = static_cast<char>(0b1000'0000);
+      const auto mask11 = _mm_setr_epi8(0, 0, 0, 0, 0, 0, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128);
+      const auto mask21 = _mm_setr_epi8(_128, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128, 0, 0, 0, 0, 0);
+      const auto mask12 = _mm_setr_epi8(_128, _128, _128, _128, _128, 0, 0, 0, 0, 0, 0, _128, _128, _128, _128, _128);
+      const auto mask22 = _mm_setr_epi8(0, 0, 0, 0, 0, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128);
+      const auto mask13 = _mm_setr_epi8(_128, _128, _128, _128, _128, _128, _128, _128, _128, _128, 0, 0, 0, 0, 0, 0);
+      const auto mask23 = _mm_setr_epi8(_128, _128, _128, _128, _128, 0, 0, 0, 0, 0, _128, _128, _128, _128, _128, _128);
+      const auto x1 = _mm_shuffle_epi8(t1, mask01);
+      const auto x2 = _mm_shuffle_epi8(t2, mask02);
+      const auto x3 = _mm_shuffle_epi8(t3, mask03);
+      const auto x4 = _mm_shuffle_epi8(t4, mask01);
+      const auto x5 = _mm_shuffle_epi8(t5, mask02);
+      const auto x6 = _mm_shuffle_epi8(t6, mask03);
+      const auto r1 = _mm_blendv_epi8(_mm_alignr_epi8(x3, x3, 5), _mm_blendv_epi8(x1, _mm_alignr_epi8(x2, x2, 10), mask11), mask21);
+      const auto g1 = _mm_blendv_epi8(_mm_alignr_epi8(x1, x1, 6), _mm_blendv_epi8(x2, _mm_alignr_epi8(x3, x3, 10), mask12), mask22);
+      const auto b1 = _mm_blendv_epi8(_mm_alignr_epi8(x2, x2, 6), _mm_blendv_epi8(x3, _mm_alignr_epi8(x1, x1, 11), mask13), mask23);
+      const auto r2 = _mm_blendv_epi8(_mm_alignr_epi8(x6, x6, 5), _mm_blendv_epi8(x4, _mm_alignr_epi8(x5, x5, 10), mask11), mask21);
+      const auto g2 = _mm_blendv_epi8(_mm_alignr_epi8(x4, x4, 6), _mm_blendv_epi8(x5, _mm_alignr_epi8(x6, x6, 10), mask12), mask22);
+      const auto b2 = _mm_blendv_epi8(_mm_alignr_epi8(x5, x5, 6), _mm_blendv_epi8(x6, _mm_alignr_epi8(x4, x4, 11), mask13), mask23);
+      const auto r = _mm256_inserti128_si256(_mm256_castsi128_si256(r1), r2, 1);
+      const auto g = _mm256_inserti128_si256(_mm256_castsi128_si256(g1), g2, 1);
+      const auto b = _mm256_inserti128_si256(_mm256_castsi128_si256(b1), b2, 1);
+      return {{r, g, b}};
+    }
+  }
+  template<bool Alpha, std::size_t N>
+  static inline pixels_type<Alpha> load(const std::array<const std::uint8_t*, N>& ptr)noexcept{
+    const auto r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr[0]));
+    const auto g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr[1]));
+    const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr[2]));
+    if constexpr(!Alpha)
+      return {{r, g, b}};
+    else if constexpr(N == 4)
+      return {{r, g, b, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr[3]))}};
+    else
+      return {{r, g, b, _mm256_set1_epi8(static_cast<char>(0xff))}};
+  }
+  template<bool Alpha, std::size_t N>
+  requires(Alpha == (N == 2))
+  static inline pixels_type<Alpha> load(const detail::gray_pointer<N>& ptr)noexcept{
+    if constexpr(N == 1){
+      const auto g = loadu_si256(ptr.p);
+      return {{g, g, g}};
+    }
+    else{
+      // gray to the low and alpha to the high half of every 128 bit lane, then the halves are gathered
+      const auto mask = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15, 0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+      const auto x0 = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(loadu_si256(ptr.p), mask), 0b11'01'10'00);
+      const auto x1 = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(loadu_si256(ptr.p+simd_lanes), mask), 0b11'01'10'00);
+      const auto g = _mm256_permute2x128_si256(x0, x1, 0x20);
+      return {{g, g, g, _mm256_permute2x128_si256(x0, x1, 0x31)}};
+    }
+  }
+#else
+  static inline vector_type setzero()noexcept{
+    return _mm_setzero_si128();
+  }
+  static inline vector_type set1_epi8(std::uint8_t x)noexcept{
+    return _mm_set1_epi8(static_cast<char>(x));
+  }
+  static inline vector_type set1_epi32(std::uint32_t x)noexcept{
+    return _mm_set1_epi32(static_cast<int>(x));
+  }
+  static inline vector_type set1_epi64x(std::uint64_t x)noexcept{
+    return _mm_set1_epi64x(static_cast<long long>(x));
+  }
+  static inline vector_type load_si(const void* ptr)noexcept{
+    return _mm_load_si128(static_cast<const __m128i*>(ptr));
+  }
+  static inline void store_si(void* ptr, vector_type v)noexcept{
+    _mm_store_si128(static_cast<__m128i*>(ptr), v);
+  }
+  static inline void storeu_si(void* ptr, vector_type v)noexcept{
+    _mm_storeu_si128(static_cast<__m128i*>(ptr), v);
+  }
+  static inline vector_type add_epi8(vector_type a, vector_type b)noexcept{
+    return _mm_add_epi8(a, b);
+  }
+  static inline vector_type sub_epi8(vector_type a, vector_type b)noexcept{
+    return _mm_sub_epi8(a, b);
+  }
+  static inline vector_type and_si(vector_type a, vector_type b)noexcept{
+    return _mm_and_si128(a, b);
+  }
+  static inline vector_type or_si(vector_type a, vector_type b)noexcept{
+    return _mm_or_si128(a, b);
+  }
+  static inline vector_type andnot_si(vector_type a, vector_type b)noexcept{
+    return _mm_andnot_si128(a, b);
+  }
+  static inline vector_type cmpeq_epi8(vector_type a, vector_type b)noexcept{
+    return _mm_cmpeq_epi8(a, b);
+  }
+  static inline vector_type cmpgt_epi8(vector_type a, vector_type b)noexcept{
+    return _mm_cmpgt_epi8(a, b);
+  }
+  static inline vector_type max_epu8(vector_type a, vector_type b)noexcept{
+    return _mm_max_epu8(a, b);
+  }
+  static inline vector_type blendv_epi8(vector_type a, vector_type b, vector_type mask)noexcept{
+    return _mm_blendv_epi8(a, b, mask);
+  }
+  static inline vector_type shuffle_epi8(vector_type a, vector_type b)noexcept{
+    return _mm_shuffle_epi8(a, b);
+  }
+  static inline vector_type unpacklo_epi8(vector_type a, vector_type b)noexcept{
+    return _mm_unpacklo_epi8(a, b);
+  }
+  static inline vector_type unpackhi_epi8(vector_type a, vector_type b)noexcept{
+    return _mm_unpackhi_epi8(a, b);
+  }
+  static inline vector_type unpacklo_epi16(vector_type a, vector_type b)noexcept{
+    return _mm_unpacklo_epi16(a, b);
+  }
+  static inline vector_type unpackhi_epi16(vector_type a, vector_type b)noexcept{
+    return _mm_unpackhi_epi16(a, b);
+  }
+  template<int N>
+  static inline vector_type slli_epi16(vector_type v)noexcept{
+    return _mm_slli_epi16(v, N);
+  }
+  template<int N>
+  static inline vector_type srli_epi16(vector_type v)noexcept{
+    return _mm_srli_epi16(v, N);
+  }
+  template<int N>
+  static inline vector_type bslli_si(vector_type v)noexcept{
+    return _mm_slli_si128(v, N);
+  }
+  static inline bool testz(vector_type v)noexcept{
+    return _mm_testz_si128(v, v);
+  }
+  static inline std::uint32_t movemask_epi8(vector_type v)noexcept{
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(v));
+  }
+  static inline std::uint8_t extract_last(vector_type v)noexcept{
+    return static_cast<std::uint8_t>(_mm_extract_epi8(v, simd_lanes-1));
+  }
+  static inline vector_type prev_vector(vector_type pxs, vector_type prev)noexcept{
+    return _mm_alignr_epi8(pxs, prev, simd_lanes-1);
+  }
+  // a single 128-bit lane has nothing to carry
+  static inline vector_type carry_lanes(vector_type)noexcept{
+    return _mm_setzero_si128();
+  }
+  static inline void broadcast_quarters(vector_type* dst, vector_type v)noexcept{
+    dst[0] = v;
+  }
+  static inline void store_rgba(std::uint32_t* dst, vector_type r, vector_type g, vector_type b, vector_type a)noexcept{
+    const auto rgl = _mm_unpacklo_epi8(r, g), rgh = _mm_unpackhi_epi8(r, g);
+    const auto bal = _mm_unpacklo_epi8(b, a), bah = _mm_unpackhi_epi8(b, a);
+    _mm_store_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(rgl, bal));
+    _mm_store_si128(reinterpret_cast<__m128i*>(dst)+1, _mm_unpackhi_epi16(rgl, bal));
+    _mm_store_si128(reinterpret_cast<__m128i*>(dst)+2, _mm_unpacklo_epi16(rgh, bah));
+    _mm_store_si128(reinterpret_cast<__m128i*>(dst)+3, _mm_unpackhi_epi16(rgh, bah));
+  }
+  // writes the 8-byte slots of the lanes packed at their offsets, in lane order; slot i holds lanes 2i and 2i+1
+  static inline void compact_slots(std::uint8_t* out, const vector_type (&s0123)[4], const vector_type (&s45)[4], const std::uint8_t* lens, const std::uint8_t* offsets)noexcept{
+    for(std::size_t i = 0; i < simd_lanes/2; ++i){
+      const auto slot = (i & 1) ? _mm_unpackhi_epi32(s0123[i/2], s45[i/2]) : _mm_unpacklo_epi32(s0123[i/2], s45[i/2]);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + offsets[i*2]), _mm_shuffle_epi8(slot, _mm_load_si128(reinterpret_cast<const __m128i*>(compaction_table[lens[i*2]]))));
+    }
+  }
+  static inline __m128i loadu_si128(const std::uint8_t* ptr)noexcept{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+  }
+  static inline __m128i loadu_si128(const detail::delta_pointer& ptr)noexcept{
+    return _mm_xor_si128(loadu_si128(ptr.cur), loadu_si128(ptr.prev));
+  }
+  template<bool Alpha, typename Pointer>
+  requires(std::same_as<Pointer, const std::uint8_t*> || std::same_as<Pointer, detail::delta_pointer>)
+  static inline pixels_type<Alpha> load(Pointer ptr)noexcept{
+    if constexpr(Alpha){
+      const auto mask = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+      const auto x0 = _mm_shuffle_epi8(loadu_si128(ptr), mask);
+      const auto x1 = _mm_shuffle_epi8(loadu_si128(ptr+simd_lanes), mask);
+      const auto x2 = _mm_shuffle_epi8(loadu_si128(ptr+simd_lanes*2), mask);
+      const auto x3 = _mm_shuffle_epi8(loadu_si128(ptr+simd_lanes*3), mask);
+      const auto rg01 = _mm_unpacklo_epi32(x0, x1);
+      const auto ba01 = _mm_unpackhi_epi32(x0, x1);
+      const auto rg23 = _mm_unpacklo_epi32(x2, x3);
+      const auto ba23 = _mm_unpackhi_epi32(x2, x3);
+      return {{_mm_unpacklo_epi64(rg01, rg23), _mm_unpackhi_epi64(rg01, rg23), _mm_unpacklo_epi64(ba01, ba23), _mm_unpackhi_epi64(ba01, ba23)}};
+    }
+    else{
+      const auto t1 = loadu_si128(ptr);
+      const auto t2 = loadu_si128(ptr+simd_lanes);
+      const auto t3 = loadu_si128(ptr+simd_lanes*2);
+      const auto mask01 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, 1, 4, 7, 10, 13, 2, 5, 8, 11, 14);
+      const auto mask02 = _mm_setr_epi8(2, 5, 8, 11, 14, 0, 3, 6, 9, 12, 15, 1, 4, 7, 10, 13);
+      const auto mask03 = _mm_setr_epi8(1, 4, 7, 10, 13, 2, 5, 8, 11, 14, 0, 3, 6, 9, 12, 15);
+      static constexpr char _128 = static_cast<char>(0b1000'0000);
+      const auto mask11 = _mm_setr_epi8(0, 0, 0, 0, 0, 0, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128);
+      const auto mask21 = _mm_setr_epi8(_128, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128, 0, 0, 0, 0, 0);
+      const auto mask12 = _mm_setr_epi8(_128, _128, _128, _128, _128, 0, 0, 0, 0, 0, 0, _128, _128, _128, _128, _128);
+      const auto mask22 = _mm_setr_epi8(0, 0, 0, 0, 0, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128, _128);
+      const auto mask13 = _mm_setr_epi8(_128, _128, _128, _128, _128, _128, _128, _128, _128, _128, 0, 0, 0, 0, 0, 0);
+      const auto mask23 = _mm_setr_epi8(_128, _128, _128, _128, _128, 0, 0, 0, 0, 0, _128, _128, _128, _128, _128, _128);
+      const auto x1 = _mm_shuffle_epi8(t1, mask01);
+      const auto x2 = _mm_shuffle_epi8(t2, mask02);
+      const auto x3 = _mm_shuffle_epi8(t3, mask03);
+      const auto r = _mm_blendv_epi8(_mm_alignr_epi8(x3, x3, 5), _mm_blendv_epi8(x1, _mm_alignr_epi8(x2, x2, 10), mask11), mask21);
+      const auto g = _mm_blendv_epi8(_mm_alignr_epi8(x1, x1, 6), _mm_blendv_epi8(x2, _mm_alignr_epi8(x3, x3, 10), mask12), mask22);
+      const auto b = _mm_blendv_epi8(_mm_alignr_epi8(x2, x2, 6), _mm_blendv_epi8(x3, _mm_alignr_epi8(x1, x1, 11), mask13), mask23);
+      return {{r, g, b}};
+    }
+  }
+  template<bool Alpha, std::size_t N>
+  static inline pixels_type<Alpha> load(const std::array<const std::uint8_t*, N>& ptr)noexcept{
+    const auto r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr[0]));
+    const auto g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr[1]));
+    const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr[2]));
+    if constexpr(!Alpha)
+      return {{r, g, b}};
+    else if constexpr(N == 4)
+      return {{r, g, b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr[3]))}};
+    else
+      return {{r, g, b, _mm_set1_epi8(static_cast<char>(0xff))}};
+  }
+  template<bool Alpha, std::size_t N>
+  requires(Alpha == (N == 2))
+  static inline pixels_type<Alpha> load(const detail::gray_pointer<N>& ptr)noexcept{
+    if constexpr(N == 1){
+      const auto g = loadu_si128(ptr.p);
+      return {{g, g, g}};
+    }
+    else{
+      const auto mask = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+      const auto x0 = _mm_shuffle_epi8(loadu_si128(ptr.p), mask);
+      const auto x1 = _mm_shuffle_epi8(loadu_si128(ptr.p+simd_lanes), mask);
+      const auto g = _mm_unpacklo_epi64(x0, x1);
+      return {{g, g, g, _mm_unpackhi_epi64(x0, x1)}};
+    }
+  }
+#endif
+  alignas(32) static constexpr std::uint8_t lane_numbers[32] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31
+  };
+  static constexpr std::uint32_t all_lanes = static_cast<std::uint32_t>((std::uint64_t{1} << simd_lanes) - 1);
+  template<std::uint8_t M>
+  static inline vector_type slli_epi8(vector_type v)noexcept{
+    const auto mask = set1_epi8(static_cast<std::uint8_t>(0xff << M) >> M);
+    return slli_epi16<M>(and_si(v, mask));
+  }
+  template<std::uint8_t M>
+  static inline vector_type mul_epi8(vector_type v)noexcept{
+    if constexpr(M == 0)
+      return setzero();
+    else if constexpr(M == 1)
+      return v;
+    else if constexpr(M == 2)
+      return slli_epi8<1>(v);
+    else if constexpr(M == 3)
+      return add_epi8(slli_epi8<1>(v), v);
+    else if constexpr(M == 4)
+      return slli_epi8<2>(v);
+    else if constexpr(M == 5)
+      return add_epi8(slli_epi8<2>(v), v);
+    else if constexpr(M == 6)
+      return add_epi8(slli_epi8<2>(v), slli_epi8<1>(v));
+    else if constexpr(M == 7)
+      return sub_epi8(slli_epi8<3>(v), v);
+    else if constexpr(M == 8)
+      return slli_epi8<3>(v);
+    else if constexpr(M == 9)
+      return add_epi8(slli_epi8<3>(v), v);
+    else if constexpr(M == 10)
+      return add_epi8(slli_epi8<3>(v), slli_epi8<1>(v));
+    else if constexpr(M == 11)
+      return add_epi8(add_epi8(slli_epi8<3>(v), slli_epi8<1>(v)), v);
+    else if constexpr(M == 12)
+      return add_epi8(slli_epi8<3>(v), slli_epi8<2>(v));
+    else if constexpr(M == 13)
+      return add_epi8(add_epi8(slli_epi8<3>(v), slli_epi8<2>(v)), v);
+    else if constexpr(M == 14)
+      return sub_epi8(slli_epi8<4>(v), slli_epi8<1>(v));
+    else if constexpr(M == 15)
+      return sub_epi8(slli_epi8<4>(v), v);
+    else
+      static_assert(M <= 15);
+  }
+  // 0xff in the lanes whose bit is set in m
+  static inline vector_type expand_mask(std::uint32_t m)noexcept{
+    alignas(32) static constexpr std::uint8_t byte_of_lane[32] = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3
+    };
+    const auto bytes = shuffle_epi8(set1_epi32(m), load_si(byte_of_lane));
+    const auto bits = set1_epi64x(0x8040201008040201ull);
+    return cmpeq_epi8(and_si(bytes, bits), bits);
+  }
+  static inline vector_type prefix_max_epu8(vector_type v)noexcept{
+    v = max_epu8(v, bslli_si<1>(v));
+    v = max_epu8(v, bslli_si<2>(v));
+    v = max_epu8(v, bslli_si<4>(v));
+    v = max_epu8(v, bslli_si<8>(v));
+    return max_epu8(v, carry_lanes(v));
+  }
+  static inline vector_type prefix_sum_epi8(vector_type v)noexcept{
+    v = add_epi8(v, bslli_si<1>(v));
+    v = add_epi8(v, bslli_si<2>(v));
+    v = add_epi8(v, bslli_si<4>(v));
+    v = add_epi8(v, bslli_si<8>(v));
+    return add_epi8(v, carry_lanes(v));
+  }
+  // the per-block stages of encode_x86, which qoimicrobench also times in isolation
+  template<bool Alpha>
+  static inline pixels_type<Alpha> diff_block(const pixels_type<Alpha>& pxs, const pixels_type<Alpha>& prev)noexcept{
+    pixels_type<Alpha> diff;
+    for(std::size_t i = 0; i < 3+Alpha; ++i)
+      diff.val[i] = sub_epi8(pxs.val[i], prev_vector(pxs.val[i], prev.val[i]));
+    return diff;
+  }
+  // the diff chunk, the first byte of the luma chunk (zero where not encodable) and its second byte
+  struct block_chunks{
+    vector_type diff, luma, luma_rb;
+  };
+  template<bool Alpha>
+  static inline block_chunks classify_block(pixels_type<Alpha> diff)noexcept{
+    const auto zero = setzero();
+    const auto two = set1_epi8(2);
+    diff.val[0] = add_epi8(diff.val[0], two);
+    diff.val[1] = add_epi8(diff.val[1], two);
+    diff.val[2] = add_epi8(diff.val[2], two);
+    const auto diffor = or_si(or_si(diff.val[0], diff.val[1]), diff.val[2]);
+    const auto diffv = and_si(or_si(or_si(set1_epi8(chunk_tag::diff), slli_epi8<4>(diff.val[0])), or_si(slli_epi8<2>(diff.val[1]), diff.val[2])), cmpeq_epi8(and_si(diffor, set1_epi8(0b11)), diffor));
+    const auto eight = set1_epi8(8);
+    diff.val[0] = add_epi8(sub_epi8(diff.val[0], diff.val[1]), eight);
+    diff.val[2] = add_epi8(sub_epi8(diff.val[2], diff.val[1]), eight);
+    diff.val[1] = add_epi8(diff.val[1], set1_epi8(30));
+    const auto lu = and_si(or_si(set1_epi8(chunk_tag::luma), diff.val[1]), cmpeq_epi8(or_si(and_si(or_si(diff.val[0], diff.val[2]), set1_epi8(0xf0)), and_si(diff.val[1], set1_epi8(0xc0))), zero));
+    const auto ma = or_si(slli_epi8<4>(diff.val[0]), diff.val[2]);
+    return {diffv, lu, ma};
+  }
+  template<bool Alpha>
+  static inline vector_type hash_block(const pixels_type<Alpha>& pxs)noexcept{
+    if constexpr(Alpha)
+      return and_si(add_epi8(add_epi8(mul_epi8<3>(pxs.val[0]), mul_epi8<5>(pxs.val[1])), add_epi8(mul_epi8<7>(pxs.val[2]), mul_epi8<11>(pxs.val[3]))), set1_epi8(63));
+    else
+      return and_si(add_epi8(add_epi8(mul_epi8<3>(pxs.val[0]), mul_epi8<5>(pxs.val[1])), add_epi8(mul_epi8<7>(pxs.val[2]), set1_epi8(static_cast<std::uint8_t>(255*11)))), set1_epi8(63));
+  }
+  // the index as byte planes, entries k*simd_lanes to (k+1)*simd_lanes-1 in the k-th vector of each channel (8 ymm or 16 xmm)
+  static constexpr std::size_t index_vectors = index_size/simd_lanes;
+  struct index_registers{
+    vector_type planes[4][index_vectors];
+  };
+  static inline index_registers load_index(const rgba_t (&index)[index_size])noexcept{
+    index_registers x;
+    for(std::size_t k = 0; k < index_vectors; ++k){
+      const auto v = load<true>(reinterpret_cast<const std::uint8_t*>(index + k*simd_lanes));
+      for(std::size_t c = 0; c < 4; ++c)
+        x.planes[c][k] = v.val[c];
+    }
+    return x;
+  }
+  static inline void store_index(rgba_t (&index)[index_size], const index_registers& x)noexcept{
+    alignas(alignof(vector_type)) std::uint32_t rgbas[index_size];
+    for(std::size_t k = 0; k < index_vectors; ++k)
+      store_rgba(rgbas + k*simd_lanes, x.planes[0][k], x.planes[1][k], x.planes[2][k], x.planes[3][k]);
+    std::memcpy(index, rgbas, sizeof(index));
+  }
+  static constexpr std::size_t lookup_quarters = (index_size+simd_lanes)/16;
+  // the bytes selected by idx from the 64 entries of an index plane followed by the lanes of the block (64 and above);
+  // quarter[q] masks the bytes of idx in the q-th 16 byte quarter of these
+  static inline vector_type index_lookup(const vector_type (&plane)[index_vectors], vector_type block, const vector_type (&quarter)[lookup_quarters], vector_type idx)noexcept{
+    vector_type src[lookup_quarters];
+    for(std::size_t k = 0; k < index_vectors; ++k)
+      broadcast_quarters(src + k*(simd_lanes/16), plane[k]);
+    broadcast_quarters(src + index_vectors*(simd_lanes/16), block);
+    auto x = setzero();
+    for(std::size_t q = 0; q < lookup_quarters; ++q)
+      x = blendv_epi8(x, shuffle_epi8(src[q], idx), quarter[q]);
+    return x;
+  }
+  static inline void index_quarters(vector_type (&quarter)[lookup_quarters], vector_type idx)noexcept{
+    const auto q = and_si(srli_epi16<4>(idx), set1_epi8(0x0f));
+    for(std::size_t i = 0; i < lookup_quarters; ++i)
+      quarter[i] = cmpeq_epi8(q, set1_epi8(static_cast<std::uint8_t>(i)));
+  }
+  // resolves the index hits of a block without the index in memory: each non-run lane reads the entry of its hash from the last
+  // preceding lane with that hash, or from the index when there is none, and each entry takes the last lane hashed to it;
+  // returns the lanes that hit
+  template<bool Alpha>
+  static inline std::uint32_t resolve_index(index_registers& index, const pixels_type<Alpha>& pxs, vector_type alpha_plane, vector_type hash, vector_type runv)noexcept{
+    const auto lane = load_si(lane_numbers);
+    vector_type position[index_vectors], src_position[index_vectors];
+    for(std::size_t k = 0; k < index_vectors; ++k)
+      src_position[k] = position[k] = add_epi8(lane, set1_epi8(static_cast<std::uint8_t>(k*simd_lanes)));
+    alignas(alignof(vector_type)) std::uint8_t hashs[simd_lanes];
+    store_si(hashs, hash);
+    const auto non_run = ~movemask_epi8(runv) & all_lanes;
+    auto src = hash;
+    for(std::uint32_t m = non_run; m != 0; m &= m-1){
+      const auto i = std::countr_zero(m);
+      const auto h = set1_epi8(hashs[i]);
+      const auto from = set1_epi8(static_cast<std::uint8_t>(index_size + i));
+      src = blendv_epi8(src, from, and_si(cmpeq_epi8(hash, h), cmpgt_epi8(lane, set1_epi8(static_cast<std::uint8_t>(i)))));
+      for(std::size_t k = 0; k < index_vectors; ++k)
+        src_position[k] = blendv_epi8(src_position[k], from, cmpeq_epi8(position[k], h));
+    }
+    vector_type quarter[lookup_quarters], position_quarter[index_vectors][lookup_quarters];
+    index_quarters(quarter, src);
+    for(std::size_t k = 0; k < index_vectors; ++k)
+      index_quarters(position_quarter[k], src_position[k]);
+    auto eq = set1_epi8(0xff);
+    for(std::size_t c = 0; c < 4; ++c){
+      const auto block = c < 3 ? pxs.val[c] : alpha_plane;
+      eq = and_si(eq, cmpeq_epi8(index_lookup(index.planes[c], block, quarter, src), block));
+      vector_type plane[index_vectors];
+      for(std::size_t k = 0; k < index_vectors; ++k)
+        plane[k] = index_lookup(index.planes[c], block, position_quarter[k], src_position[k]);
+      std::copy(plane, plane + index_vectors, index.planes[c]);
+    }
+    return non_run & movemask_epi8(eq);
+  }
+  template<std::uint_fast8_t Channels, bool RegisterIndex = default_register_index, bool SerialEmit = default_serial_emit, typename Pusher, typename Puller, typename Length>
+  static inline void encode_x86(Pusher& p_, Puller& pixels_, encode_state& state, Length px_len){
+    static constexpr bool Alpha = Channels == 4;
+    std::uint8_t* p = p_.raw_pointer();
+    auto pixels = pixels_.raw_pointer();
+
+    rgba_t index[index_size];
+    std::memcpy(index, state.index, sizeof(index));
+    [[maybe_unused]] index_registers registers;
+    if constexpr(RegisterIndex)
+      registers = load_index(index);
+
+    const auto zero = setzero();
+
+    pixels_type<Alpha> prev;
+    prev.val[0] = set1_epi8(state.px.r);
+    prev.val[1] = set1_epi8(state.px.g);
+    prev.val[2] = set1_epi8(state.px.b);
+    if constexpr(Alpha)
+      prev.val[3] = set1_epi8(state.px.a);
+
+    std::size_t run = state.run;
+    rgba_t px = state.px;
+    auto prev_hash = state.prev_hash;
+
+    const std::size_t tail = px_len % simd_lanes;
+    std::size_t simd_len = px_len / simd_lanes + (tail != 0);
+    pixels_.advance(px_len*Channels);
+    padded_tail<Channels, simd_lanes> tail_buffer;
+    count<&stats::simd_pixels>(px_len);
+    while(simd_len--){
+      count<&stats::simd_blocks>();
+      if(simd_len == 0 && tail != 0)
+        pixels = tail_buffer.pad(pixels, tail);
+      const auto pxs = load<Alpha>(pixels);
+      auto diff = diff_block<Alpha>(pxs, prev);
+      bool alpha = true;
+      if constexpr(Alpha){
+        alpha = testz(diff.val[3]);
+        diff.val[3] = cmpeq_epi8(diff.val[3], zero);
+      }
+      const auto ored = or_si(or_si(diff.val[0], diff.val[1]), diff.val[2]);
+      auto runv = cmpeq_epi8(ored, zero);
+      if(testz(ored) && alpha){
+        count<&stats::run_blocks>();
+        run += simd_lanes;
+        advance_pixels<Channels>(pixels, simd_lanes);
+        continue;
+      }
+      if constexpr(Alpha)
+        runv = and_si(runv, diff.val[3]);
+      const auto r = static_cast<std::size_t>(std::countr_zero(~movemask_epi8(runv)));
+      run += r;
+      if(run > 0){
+        while(run >= 62)[[unlikely]]{
+          static constexpr std::uint8_t x = chunk_tag::run | 61;
+          *p++ = x;
+          run -= 62;
+        }
+        if(run > 1){
+          *p++ = static_cast<std::uint8_t>(chunk_tag::run | (run-1));
+          run = 0;
+        }
+        else if(run == 1){
+          if(prev_hash == index_size)[[unlikely]]
+            *p++ = chunk_tag::run;
+          else
+            *p++ = chunk_tag::index | prev_hash;
+          run = 0;
+        }
+      }
+      const auto [diffv, lu, ma] = classify_block<Alpha>(diff);
+      const auto hash = hash_block<Alpha>(pxs);
+      const auto alpha_plane = Alpha ? pxs.val[3] : set1_epi8(0xff);
+
+      if constexpr(SerialEmit){
+        // the lanes are emitted one by one from the stored planes as encode_neon does
+        alignas(alignof(vector_type)) std::uint8_t runs[simd_lanes], diffs[simd_lanes], lumas[simd_lanes], luma_rbs[simd_lanes], hashs[simd_lanes];
+        [[maybe_unused]] alignas(alignof(vector_type)) std::uint8_t alphas[simd_lanes];
+        store_si(runs, runv);
+        store_si(diffs, diffv);
+        store_si(lumas, lu);
+        store_si(luma_rbs, ma);
+        store_si(hashs, hash);
+        if constexpr(Alpha)
+          if(!alpha)
+            store_si(alphas, diff.val[3]);
+        [[maybe_unused]] std::uint32_t hits;
+        if constexpr(RegisterIndex)
+          hits = resolve_index<Alpha>(registers, pxs, alpha_plane, hash, runv);
+        advance_pixels<Channels>(pixels, r);
+        for(std::size_t i = r; i < simd_lanes; ++i){
+          if(runs[i]){
+            ++run;
+            advance_pixels<Channels>(pixels, 1);
+            continue;
+          }
+          if(run > 1){
+            *p++ = static_cast<std::uint8_t>(chunk_tag::run | (run-1));
+            run = 0;
+          }
+          else if(run == 1){
+            if(prev_hash == index_size)[[unlikely]]
+              *p++ = chunk_tag::run;
+            else
+              *p++ = chunk_tag::index | prev_hash;
+            run = 0;
+          }
+          const auto index_pos = hashs[i];
+          prev_hash = index_pos;
+          read_pixel<Channels>(&px, pixels);
+          if constexpr(RegisterIndex){
+            if(hits >> i & 1){
+              *p++ = chunk_tag::index | index_pos;
+              continue;
+            }
+          }
+          else{
+            if(index[index_pos] == px){
+              *p++ = chunk_tag::index | index_pos;
+              continue;
+            }
+            index[index_pos] = px;
+          }
+
+          if constexpr(Alpha)
+            if(!alpha && !alphas[i]){
+              *p++ = chunk_tag::rgba;
+              std::memcpy(p, &px, 4);
+              p += 4;
+              continue;
+            }
+          if(diffs[i])
+            *p++ = diffs[i];
+          else if(lumas[i]){
+            *p++ = lumas[i];
+            *p++ = luma_rbs[i];
+          }
+          else{
+            *p++ = chunk_tag::rgb;
+            efficient_memcpy<3>(p, &px);
+            p += 3;
+          }
+        }
+      }
+      else{
+        const auto one = set1_epi8(1);
+        const auto two = set1_epi8(2);
+
+        // index hits depend on the preceding lanes, so they are resolved serially by default; run lanes must not touch the index
+        // (the register index is slower than this loop, see the "index" rows of qoimicrobench)
+        alignas(alignof(vector_type)) std::uint32_t rgbas[simd_lanes];
+        alignas(alignof(vector_type)) std::uint8_t hashs[simd_lanes];
+        std::uint32_t hits = 0;
+        if constexpr(RegisterIndex)
+          hits = resolve_index<Alpha>(registers, pxs, alpha_plane, hash, runv);
+        else{
+          store_rgba(rgbas, pxs.val[0], pxs.val[1], pxs.val[2], alpha_plane);
+          store_si(hashs, hash);
+          for(std::uint32_t m = ~movemask_epi8(runv) & all_lanes; m != 0; m &= m-1){
+            const auto i = std::countr_zero(m);
+            const auto index_pos = hashs[i];
+            hits |= static_cast<std::uint32_t>(index[index_pos].v() == rgbas[i]) << i;
+            std::memcpy(index + index_pos, rgbas + i, sizeof(rgba_t));
+          }
+        }
+
+        // run length preceding each lane, counted from the last non-run lane
+        const auto lane = add_epi8(load_si(lane_numbers), one);
+        const auto last = prefix_max_epu8(andnot_si(runv, lane));
+        const auto run_len = sub_epi8(sub_epi8(lane, one), prev_vector(last, zero));
+        const auto has_run = andnot_si(cmpeq_epi8(run_len, zero), expand_mask(~0u << r << 1));
+        const auto run_chunk = blendv_epi8(prev_vector(hash, zero), or_si(set1_epi8(chunk_tag::run), sub_epi8(run_len, one)), cmpgt_epi8(run_len, one));
+
+        // the first two bytes of each chunk and its length; the rest are the pixel itself
+        const auto not_diff = cmpeq_epi8(diffv, zero);
+        auto c0 = blendv_epi8(set1_epi8(chunk_tag::rgb), lu, lu);
+        auto c1 = blendv_epi8(pxs.val[0], ma, lu);
+        auto len = blendv_epi8(set1_epi8(4), two, lu);
+        c0 = blendv_epi8(diffv, c0, not_diff);
+        len = blendv_epi8(one, len, not_diff);
+        if constexpr(Alpha){
+          c0 = blendv_epi8(set1_epi8(chunk_tag::rgba), c0, diff.val[3]);
+          c1 = blendv_epi8(pxs.val[0], c1, diff.val[3]);
+          len = blendv_epi8(set1_epi8(5), len, diff.val[3]);
+        }
+        const auto hitv = expand_mask(hits);
+        c0 = blendv_epi8(c0, hash, hitv);
+        len = blendv_epi8(len, one, hitv);
+        len = andnot_si(runv, add_epi8(len, and_si(has_run, one)));
+
+        // one 8-byte slot per lane: the pending run chunk (if any) followed by the pixel chunk
+        const auto s0 = blendv_epi8(c0, run_chunk, has_run);
+        const auto s1 = blendv_epi8(c1, c0, has_run);
+        const auto s2 = blendv_epi8(pxs.val[1], c1, has_run);
+        const auto s3 = blendv_epi8(pxs.val[2], pxs.val[1], has_run);
+        const auto s4 = Alpha ? blendv_epi8(alpha_plane, pxs.val[2], has_run) : and_si(pxs.val[2], has_run);
+        const auto s5 = Alpha ? and_si(alpha_plane, has_run) : zero;
+        const auto s01l = unpacklo_epi8(s0, s1), s01h = unpackhi_epi8(s0, s1);
+        const auto s23l = unpacklo_epi8(s2, s3), s23h = unpackhi_epi8(s2, s3);
+        const auto s45l = unpacklo_epi8(s4, s5), s45h = unpackhi_epi8(s4, s5);
+        const vector_type s0123[4] = {unpacklo_epi16(s01l, s23l), unpackhi_epi16(s01l, s23l), unpacklo_epi16(s01h, s23h), unpackhi_epi16(s01h, s23h)};
+        const vector_type s45[4] = {unpacklo_epi16(s45l, zero), unpackhi_epi16(s45l, zero), unpacklo_epi16(s45h, zero), unpackhi_epi16(s45h, zero)};
+
+        // pack the slots with a prefix sum of the lengths
+        const auto end = prefix_sum_epi8(len);
+        alignas(alignof(vector_type)) std::uint8_t lens[simd_lanes], offsets[simd_lanes];
+        store_si(lens, len);
+        store_si(offsets, sub_epi8(end, len));
+        alignas(alignof(vector_type)) std::uint8_t out[simd_lanes*8];
+        compact_slots(out, s0123, s45, lens, offsets);
+        const auto size = static_cast<std::size_t>(offsets[simd_lanes-1]) + lens[simd_lanes-1];
+        // while another full block follows, the output has room for its worst case (Channels+1 bytes per pixel), so whole vectors can be copied
+        if(simd_len > static_cast<std::size_t>(tail != 0))
+          for(std::size_t i = 0; i < size; i += sizeof(vector_type))
+            storeu_si(p + i, load_si(out + i));
+        else
+          std::memcpy(p, out, size);
+        p += size;
+
+        run = simd_lanes - extract_last(last);
+        if constexpr(RegisterIndex){
+          prev_hash = extract_last(hash);
+          px = {extract_last(pxs.val[0]), extract_last(pxs.val[1]), extract_last(pxs.val[2]), extract_last(alpha_plane)};
+        }
+        else{
+          prev_hash = hashs[simd_lanes-1];
+          std::memcpy(&px, rgbas + simd_lanes-1, sizeof(rgba_t));
+        }
+        advance_pixels<Channels>(pixels, simd_lanes);
+      }
+      prev = pxs;
+    }
+    p_.advance(p-p_.raw_pointer());
+
+    if constexpr(RegisterIndex)
+      store_index(index, registers);
+    std::memcpy(state.index, index, sizeof(index));
+    state.px = px;
+    state.prev_hash = prev_hash;
+    state.run = run - (tail != 0 ? simd_lanes - tail : 0);
+  }
+#endif
+#endif
+
+  // px_len is a std::size_t, or a std::integral_constant from tile_codec so that the block count and the tail of the SIMD encoders are constants
+  template<std::uint_fast8_t Channels, typename Pusher, typename Puller, typename Length>
+  static inline void encode_pixels(Pusher& p, Puller& pixels, encode_state& state, Length px_len){
+#ifndef QOIXX_NO_SIMD
+#if defined(__ARM_FEATURE_SVE) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    if constexpr(Pusher::is_contiguous && detail::simd_accessor<Puller>)
+      switch(svcntb()){
+#define QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(i) case i/8: encode_sve<i, Channels>(p, pixels, state, px_len); break
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(128);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(256);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(384);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(512);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(640);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(768);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(896);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1024);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1152);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1280);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1408);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1536);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1664);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1792);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1920);
+        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(2048);
+#undef QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE
+        default: while(true){/*unreachable*/}
+      }
+    else
+#elif defined(__aarch64__) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    if constexpr(Pusher::is_contiguous && detail::simd_accessor<Puller>)
+      encode_neon<Channels>(p, pixels, state, px_len);
+    else
+#elif defined(__riscv_vector) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    if constexpr(Pusher::is_contiguous && detail::simd_accessor<Puller>)
+      encode_rvv<Channels>(p, pixels, state, px_len);
+    else
+#elif defined(__AVX2__) || defined(__SSE4_1__)
+    if constexpr(Pusher::is_contiguous && detail::simd_accessor<Puller>)
+      encode_x86<Channels>(p, pixels, state, px_len);
+    else
+#endif
+#endif
+      encode_body<Channels>(p, pixels, state, px_len);
+  }
+  // gray and gray+alpha inputs are broadcast to RGB(A) by the loads of the encoders, without an expanded copy
+  template<typename Pusher, typename Puller, typename Length>
+  static inline void encode_pixels(Pusher& p, Puller& pixels, encode_state& state, Length px_len, std::uint8_t channels){
+    if constexpr(!detail::planar_accessor<Puller>)
+      if(channels < 3){
+        if(channels == 2){
+          detail::gray_puller<2, Puller> gray{&pixels};
+          encode_pixels<4>(p, gray, state, px_len);
+        }
+        else{
+          detail::gray_puller<1, Puller> gray{&pixels};
+          encode_pixels<3>(p, gray, state, px_len);
+        }
+        return;
+      }
+    if(channels == 4)
+      encode_pixels<4>(p, pixels, state, px_len);
+    else
+      encode_pixels<3>(p, pixels, state, px_len);
+  }
+
+  template<typename Puller>
+  static inline desc decode_header(Puller& p){
+    desc d;
+    const auto magic_ = read_32(p);
+    d.width = read_32(p);
+    d.height = read_32(p);
+    d.channels = p.pull();
+    d.colorspace = static_cast<qoi::colorspace>(p.pull());
+    if(
+      d.width == 0 || d.height == 0 || magic_ != magic ||
+      d.channels < 3 || d.channels > 4 ||
+      d.height >= pixels_max / d.width
+    )[[unlikely]]
+      throw std::runtime_error("qoixx::qoi::decode: invalid header");
+    return d;
+  }
+
+#ifndef QOIXX_DECODE_WITH_TABLES
+#define QOIXX_HPP_DECODE_WITH_TABLES_NOT_DEFINED
+#ifdef __aarch64__
+#define QOIXX_DECODE_WITH_TABLES 0
+#else
+#define QOIXX_DECODE_WITH_TABLES 1
+#endif
+#endif
+  static constexpr qoi::decoder default_decoder = QOIXX_DECODE_WITH_TABLES ? qoi::decoder::tables : qoi::decoder::arithmetic;
+#ifdef QOIXX_HPP_DECODE_WITH_TABLES_NOT_DEFINED
+#undef QOIXX_DECODE_WITH_TABLES
+#undef QOIXX_HPP_DECODE_WITH_TABLES_NOT_DEFINED
+#endif
+#ifdef QOIXX_DECODE_CALIBRATE
+  static inline std::atomic<qoi::decoder> selected_decoder{qoi::decoder::automatic};
+#else
+  static inline std::atomic<qoi::decoder> selected_decoder{default_decoder};
+#endif
+
+  static constexpr std::size_t hash_table_offset = std::numeric_limits<std::uint8_t>::max()+1 - chunk_tag::diff;
+  static constexpr std::array<int, std::numeric_limits<std::uint8_t>::max()+1+chunk_tag::run-chunk_tag::diff> create_hash_diff_table(){
+    std::array<int, std::numeric_limits<std::uint8_t>::max()+1+chunk_tag::run-chunk_tag::diff> table = {};
+    for(std::size_t i = 0; i <= std::numeric_limits<std::uint8_t>::max(); ++i){
+      constexpr std::uint32_t mask_tail_4 = 0b0000'1111u;
+      const auto vr = (i >> 4);
+      const auto vb = (i & mask_tail_4);
+      table[i] = (vr*3 + vb*7) % index_size;
+    }
+    for(std::size_t i = chunk_tag::diff; i < chunk_tag::luma; ++i){
+      constexpr std::uint32_t mask_tail_2 = 0b0000'0011u;
+      const auto vr = static_cast<int>((i >> 4) & mask_tail_2) - 2;
+      const auto vg = static_cast<int>((i >> 2) & mask_tail_2) - 2;
+      const auto vb = static_cast<int>( i       & mask_tail_2) - 2;
+      table[i+hash_table_offset] = static_cast<std::uint8_t>((vr*3 + vg*5 + vb*7) % index_size);
+    }
+    for(std::size_t i = chunk_tag::luma; i < chunk_tag::run; ++i){
+        constexpr int vgv = chunk_tag::luma+40;
+        const int vg = i - vgv;
+        table[i+hash_table_offset] = static_cast<std::uint8_t>((vg*3 + (vg+8)*5 + vg*7) % index_size);
+    }
+    return table;
+  }
+  static constexpr std::array<std::array<std::uint8_t, 2>, std::numeric_limits<std::uint8_t>::max()+1> create_luma_table(){
+    std::array<std::array<std::uint8_t, 2>, std::numeric_limits<std::uint8_t>::max()+1> table = {};
+    for(std::size_t i = 0; i <= std::numeric_limits<std::uint8_t>::max(); ++i){
+      constexpr std::uint32_t mask_tail_4 = 0b0000'1111u;
+      const auto vr = (i >> 4);
+      const auto vb = (i & mask_tail_4);
+      table[i][0] = static_cast<uint8_t>(vr);
+      table[i][1] = static_cast<uint8_t>(vb);
+    }
+    return table;
+  }
+  static constexpr std::array<std::array<std::int8_t, 3>, chunk_tag::luma> create_diff_table(){
+    std::array<std::array<std::int8_t, 3>, chunk_tag::luma> table = {};
+    for(std::size_t i = chunk_tag::diff; i < chunk_tag::luma; ++i){
+      constexpr std::uint32_t mask_tail_2 = 0b0000'0011u;
+      const auto vr = ((i >> 4) & mask_tail_2) - 2;
+      const auto vg = ((i >> 2) & mask_tail_2) - 2;
+      const auto vb = ( i       & mask_tail_2) - 2;
+      table[i][0] = static_cast<uint8_t>(vr);
+      table[i][1] = static_cast<uint8_t>(vg);
+      table[i][2] = static_cast<uint8_t>(vb);
+    }
+    return table;
+  }
+
+  // pushes px run+1 times
+  template<std::size_t Channels, typename Pusher, typename Pixel>
+  static inline void fill_run(Pusher& pixels, const Pixel& px, std::size_t run){
+#if defined(__aarch64__) and not defined(QOIXX_NO_SIMD)
+    if constexpr(Pusher::is_contiguous){
+      ++run;
+      if(run >= 8){
+        std::conditional_t<Channels == 4, uint8x8x4_t, uint8x8x3_t> data = {vdup_n_u8(px.r), vdup_n_u8(px.g), vdup_n_u8(px.b)};
+        if constexpr(Channels == 4)
+          data.val[3] = vdup_n_u8(px.a);
+        while(run>=8){
+          if constexpr(Channels == 4)
+            vst4_u8(pixels.raw_pointer(), data);
+          else
+            vst3_u8(pixels.raw_pointer(), data);
+          pixels.advance(Channels*8);
+          run -= 8;
+        }
+      }
+      while(run--){push<Channels>(pixels, &px);}
+    }
+    else
+#elif defined(__riscv_vector) and defined(QOIXX_EXPERIMENTAL_SIMD) and not defined(QOIXX_NO_SIMD)
+    if constexpr(Pusher::is_contiguous){
+      ++run;
+      if(run >= 8){
+        const auto vlmax = __riscv_vsetvlmax_e8m1();
+        const auto r = __riscv_vmv_v_x_u8m1(px.r, vlmax);
+        const auto g = __riscv_vmv_v_x_u8m1(px.g, vlmax);
+        const auto b = __riscv_vmv_v_x_u8m1(px.b, vlmax);
+        if constexpr(Channels == 4){
+          const auto data = __riscv_vcreate_v_u8m1x4(r, g, b, __riscv_vmv_v_x_u8m1(px.a, vlmax));
+          while(run>=8){
+            const auto vl = __riscv_vsetvl_e8m1(run);
+            __riscv_vsseg4e8_v_u8m1x4(pixels.raw_pointer(), data, vl);
+            pixels.advance(Channels*vl);
+            run -= vl;
+          }
+        }
+        else{
+          const auto data = __riscv_vcreate_v_u8m1x3(r, g, b);
+          while(run>=8){
+            const auto vl = __riscv_vsetvl_e8m1(run);
+            __riscv_vsseg3e8_v_u8m1x3(pixels.raw_pointer(), data, vl);
+            pixels.advance(Channels*vl);
+            run -= vl;
+          }
+        }
+      }
+      while(run--){push<Channels>(pixels, &px);}
+    }
+    else
+#endif
+    if constexpr(detail::pixel_pusher<Pusher>)
+      pixels.template fill<Channels>(reinterpret_cast<const std::uint8_t*>(&px), run+1);
+    else
+      do{push<Channels>(pixels, &px);}while(run--);
+  }
+  template<std::size_t Channels, bool WithTables, typename Pusher, typename Puller>
+  static inline void decode_impl(Pusher& pixels, Puller& p, std::size_t px_len, std::size_t size){
+#ifndef __aarch64__
+    using rgba_t = std::conditional_t<Channels == 4, qoi::rgba_t, qoi::rgb_t>;
+#endif
     rgba_t px = {};
     if constexpr(std::is_same<rgba_t, qoi::rgba_t>::value)
       px.a = 255;
@@ -1135,264 +3071,1966 @@ class qoi{
       index[(0*3+0*5+0*7+255*11)%index_size] = px;
     }
     else
-      index[(0*3+0*5+0*7+255*11)%index_size] = {};
+      index[(0*3+0*5+0*7+255*11)%index_size] = {};
+
+    [[maybe_unused]] auto hash = px.hash() % index_size;
+    static constexpr auto luma_hash_diff_table = create_hash_diff_table();
+    static constexpr auto hash_diff_table = luma_hash_diff_table.data() + hash_table_offset;
+
+    const auto f = [&pixels, &p, &px_len, &size, &px, &index, &hash]{
+      const auto b1 = p.pull();
+      --size;
+
+      if(b1 >= chunk_tag::run){
+        if(b1 < chunk_tag::rgb){
+          /*run*/
+          static constexpr std::uint32_t mask_tail_6 = 0b0011'1111u;
+          std::size_t run = b1 & mask_tail_6;
+          count_run(run+1);
+          if(run >= px_len)[[unlikely]]
+            run = px_len;
+          px_len -= run;
+          fill_run<Channels>(pixels, px, run);
+          return;
+        }
+        if(b1 == chunk_tag::rgb){
+          count<&stats::rgb>();
+          pull<3>(&px, p);
+          size -= 3;
+          if constexpr(WithTables)
+            hash = px.hash() % index_size;
+        }
+        if constexpr(Channels == 4){
+          if(b1 == chunk_tag::rgba){
+            count<&stats::rgba>();
+            pull<4>(&px, p);
+            size -= 4;
+            if constexpr(WithTables)
+              hash = px.hash() % index_size;
+          }
+        }
+        else{
+          if(b1 == chunk_tag::rgba)[[unlikely]]{
+            count<&stats::rgba>();
+            pull<3>(&px, p);
+            p.advance(1);
+            size -= 4;
+            if constexpr(WithTables)
+              hash = px.hash() % index_size;
+          }
+        }
+      }
+      else if(b1 < chunk_tag::diff){
+        /*index*/
+        count<&stats::index>();
+        if constexpr(std::is_same<rgba_t, qoi::rgba_t>::value)
+          px = index[b1];
+        else
+          efficient_memcpy<Channels>(&px, index + b1);
+        push<Channels>(pixels, &px);
+        if constexpr(WithTables)
+          hash = b1;
+        return;
+      }
+      else if(b1 >= chunk_tag::luma){
+        /*luma*/
+        count<&stats::luma>();
+        const auto b2 = p.pull();
+        --size;
+        static constexpr int vgv = chunk_tag::luma+40;
+        const int vg = b1 - vgv;
+        if constexpr(WithTables){
+          static constexpr auto table = create_luma_table();
+          const auto drb = table[b2];
+          px.r += vg + drb[0];
+          px.g += vg + 8;
+          px.b += vg + drb[1];
+          hash = (static_cast<int>(hash)+hash_diff_table[b1]+luma_hash_diff_table[b2]) % index_size;
+        }
+        else{
+          static constexpr std::uint32_t mask_tail_4 = 0b0000'1111u;
+          px.r += vg + (b2 >> 4);
+          px.g += vg + 8;
+          px.b += vg + (b2 & mask_tail_4);
+        }
+      }
+      else{
+        /*diff*/
+        count<&stats::diff>();
+        if constexpr(WithTables){
+          static constexpr auto table = create_diff_table();
+          const auto drgb = table[b1];
+          px.r += drgb[0];
+          px.g += drgb[1];
+          px.b += drgb[2];
+          hash = (static_cast<int>(hash)+hash_diff_table[b1]) % index_size;
+        }
+        else{
+          static constexpr std::uint32_t mask_tail_2 = 0b0000'0011u;
+          px.r += ((b1 >> 4) & mask_tail_2) - 2;
+          px.g += ((b1 >> 2) & mask_tail_2) - 2;
+          px.b += ( b1       & mask_tail_2) - 2;
+        }
+      }
+      const auto h = WithTables ? hash : px.hash() % index_size;
+      if constexpr(std::is_same<rgba_t, qoi::rgba_t>::value)
+        index[h] = px;
+      else
+        efficient_memcpy<Channels>(index + h, &px);
+
+      push<Channels>(pixels, &px);
+    };
+
+    while(px_len--)[[likely]]{
+      f();
+      if(size < sizeof(padding))[[unlikely]]{
+        throw std::runtime_error("qoixx::qoi::decode: insufficient input data");
+      }
+    }
+  }
+  // decode_dispatch keeps the current pixel as four 16 bit lanes (r, g, b, a from the lowest), so that a diff/luma chunk is one add and one mask
+  static constexpr std::uint64_t lane_mask = 0x00ff'00ff'00ff'00ffull;
+  static constexpr std::uint64_t lanes(std::uint64_t r, std::uint64_t g, std::uint64_t b, std::uint64_t a = 0)noexcept{
+    return (r & 0xffu) | (g & 0xffu) << 16 | (b & 0xffu) << 32 | (a & 0xffu) << 48;
+  }
+  static constexpr std::array<std::uint64_t, 64> create_diff_lanes_table(){
+    std::array<std::uint64_t, 64> table = {};
+    for(std::size_t i = 0; i < 64; ++i)
+      table[i] = lanes(((i >> 4) & 3u) - 2, ((i >> 2) & 3u) - 2, (i & 3u) - 2);
+    return table;
+  }
+  static constexpr std::array<std::uint64_t, 64> create_luma_g_lanes_table(){
+    std::array<std::uint64_t, 64> table = {};
+    for(std::size_t i = 0; i < 64; ++i)
+      table[i] = lanes(i - 40, i - 32, i - 40);
+    return table;
+  }
+  static constexpr std::array<std::uint64_t, std::numeric_limits<std::uint8_t>::max()+1> create_luma_rb_lanes_table(){
+    std::array<std::uint64_t, std::numeric_limits<std::uint8_t>::max()+1> table = {};
+    for(std::size_t i = 0; i <= std::numeric_limits<std::uint8_t>::max(); ++i)
+      table[i] = lanes(i >> 4, 0, i & 0b0000'1111u);
+    return table;
+  }
+  static inline std::uint32_t pack_lanes(std::uint64_t px)noexcept{
+    if constexpr(std::endian::native == std::endian::little){
+      px = (px | px >> 8) & 0x0000'ffff'0000'ffffull;
+      return static_cast<std::uint32_t>(px | px >> 16);
+    }
+    else
+      return std::bit_cast<std::uint32_t>(std::array<std::uint8_t, 4>{
+        static_cast<std::uint8_t>(px), static_cast<std::uint8_t>(px >> 16), static_cast<std::uint8_t>(px >> 32), static_cast<std::uint8_t>(px >> 48),
+      });
+  }
 
-#if QOIXX_DECODE_WITH_TABLES
-#define QOIXX_HPP_WITH_TABLES(...) __VA_ARGS__
-#define QOIXX_HPP_WITHOUT_TABLES(...)
-#else
-#define QOIXX_HPP_WITH_TABLES(...)
-#define QOIXX_HPP_WITHOUT_TABLES(...) __VA_ARGS__
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
 #endif
+  // dispatches on the opcode byte through a 256 entry table (computed goto with GCC/Clang, a switch elsewhere)
+  // and checks the input size once per batch of chunks instead of once per chunk
+  template<std::size_t Channels, typename Pusher, typename Puller>
+  requires Puller::is_contiguous
+  static inline void decode_dispatch(Pusher& pixels, Puller& p, std::size_t px_len, std::size_t size){
+    static constexpr auto diff_lanes = create_diff_lanes_table();
+    static constexpr auto luma_g_lanes = create_luma_g_lanes_table();
+    static constexpr auto luma_rb_lanes = create_luma_rb_lanes_table();
+    static constexpr std::uint64_t hash_multiplier = 3ull << 48 | 5ull << 32 | 7ull << 16 | 11ull;
+    static constexpr std::size_t max_chunk_size = 5;
+    static constexpr std::size_t prefetch_batch = 64;
+    std::uint64_t px = lanes(0, 0, 0, 255);
+    std::uint32_t packed = pack_lanes(px);
+    std::uint64_t index[index_size] = {};
+    std::uint32_t packed_index[index_size] = {};
+    if constexpr(Channels == 3){
+      std::ranges::fill(index, px);
+      std::ranges::fill(packed_index, packed);
+    }
+    index[(0*3+0*5+0*7+255*11)%index_size] = px;
+    packed_index[(0*3+0*5+0*7+255*11)%index_size] = packed;
+    const std::uint8_t* const begin = p.raw_pointer();
+    const std::uint8_t* in = begin;
+    std::uint8_t* out = nullptr;
+    if constexpr(Pusher::is_contiguous)
+      out = pixels.raw_pointer();
+    std::size_t k;
 
-    QOIXX_HPP_WITH_TABLES(
-    auto hash = px.hash() % index_size;
-    static constexpr auto luma_hash_diff_table = create_hash_diff_table();
-    static constexpr auto hash_diff_table = luma_hash_diff_table.data() + hash_table_offset;
-    )
-
-    const auto f = [&pixels, &p, &px_len, &size, &px, &index QOIXX_HPP_WITH_TABLES(, &hash)]{
-      const auto b1 = p.pull();
-      --size;
-
-#if defined(__aarch64__) and not defined(QOIXX_NO_SIMD)
-#define QOIXX_HPP_DECODE_RUN(px, run) { \
+#define QOIXX_HPP_EMIT() \
     if constexpr(Pusher::is_contiguous){ \
-      ++run; \
-      if(run >= 8){ \
-        std::conditional_t<Channels == 4, uint8x8x4_t, uint8x8x3_t> data = {vdup_n_u8(px.r), vdup_n_u8(px.g), vdup_n_u8(px.b)}; \
-        if constexpr(Channels == 4) \
-          data.val[3] = vdup_n_u8(px.a); \
-        while(run>=8){ \
-          if constexpr(Channels == 4) \
-            vst4_u8(pixels.raw_pointer(), data); \
-          else \
-            vst3_u8(pixels.raw_pointer(), data); \
-          pixels.advance(Channels*8); \
-          run -= 8; \
-        } \
-      } \
-      while(run--){push<Channels>(pixels, &px);} \
+      if(Channels == 4 || px_len > 1)[[likely]] \
+        std::memcpy(out, &packed, sizeof(packed)); \
+      else \
+        efficient_memcpy<Channels>(out, &packed); \
+      out += Channels; \
     } \
     else \
-      do{push<Channels>(pixels, &px);}while(run--); \
+      push<Channels>(pixels, &packed)
+#define QOIXX_HPP_UPDATE() { \
+      packed = pack_lanes(px); \
+      const auto hash = (px * hash_multiplier) >> 48 & (index_size-1); \
+      index[hash] = px; \
+      packed_index[hash] = packed; \
+      QOIXX_HPP_EMIT(); \
+    }
+#define QOIXX_HPP_CHUNK_DONE() --px_len; if(--k == 0) continue
+#if defined(__GNUC__)
+#define QOIXX_HPP_X4(x) x, x, x, x
+#define QOIXX_HPP_X16(x) QOIXX_HPP_X4(x), QOIXX_HPP_X4(x), QOIXX_HPP_X4(x), QOIXX_HPP_X4(x)
+#define QOIXX_HPP_X64(x) QOIXX_HPP_X16(x), QOIXX_HPP_X16(x), QOIXX_HPP_X16(x), QOIXX_HPP_X16(x)
+    static const void* const labels[] = {
+      QOIXX_HPP_X64(&&op_index),
+      QOIXX_HPP_X64(&&op_diff),
+      QOIXX_HPP_X64(&&op_luma),
+      QOIXX_HPP_X16(&&op_run), QOIXX_HPP_X16(&&op_run), QOIXX_HPP_X16(&&op_run),
+      QOIXX_HPP_X4(&&op_run), QOIXX_HPP_X4(&&op_run), QOIXX_HPP_X4(&&op_run), &&op_run, &&op_run,
+      &&op_rgb, &&op_rgba,
+    };
+    static_assert(std::size(labels) == std::numeric_limits<std::uint8_t>::max()+1);
+#undef QOIXX_HPP_X64
+#undef QOIXX_HPP_X16
+#undef QOIXX_HPP_X4
+#define QOIXX_HPP_DISPATCH() goto *labels[in[0]]
+#else
+#define QOIXX_HPP_DISPATCH() \
+    switch(in[0] >> 6){ \
+      case chunk_tag::index >> 6: goto op_index; \
+      case chunk_tag::diff  >> 6: goto op_diff; \
+      case chunk_tag::luma  >> 6: goto op_luma; \
+      default: \
+        if(in[0] == chunk_tag::rgb) goto op_rgb; \
+        if(in[0] == chunk_tag::rgba) goto op_rgba; \
+        goto op_run; \
+    }
+#endif
+
+    for(;;){
+      {
+        // every chunk is at most max_chunk_size bytes and emits at least one pixel, so k chunks can be decoded without checks
+        const auto consumed = static_cast<std::size_t>(in - begin);
+        if(size - consumed < sizeof(padding))[[unlikely]]
+          throw std::runtime_error("qoixx::qoi::decode: insufficient input data");
+        if(px_len == 0)
+          break;
+        k = std::clamp<std::size_t>((size - consumed - sizeof(padding)) / max_chunk_size, 1, std::min(px_len, prefetch_batch));
+#if defined(__GNUC__)
+        // a batch reads at most prefetch_batch*max_chunk_size bytes; request them prefetch_distance ahead of use
+        constexpr std::size_t prefetch_distance = 1024;
+        for(std::size_t off = 0; off < prefetch_batch*max_chunk_size; off += 64)
+          __builtin_prefetch(in + prefetch_distance + off);
+#endif
+      }
+      QOIXX_HPP_DISPATCH();
+     op_index:
+      count<&stats::index>();
+      px = index[*in];
+      packed = packed_index[*in];
+      ++in;
+      QOIXX_HPP_EMIT();
+      QOIXX_HPP_CHUNK_DONE();
+      QOIXX_HPP_DISPATCH();
+     op_diff:
+      count<&stats::diff>();
+      px = (px + diff_lanes[*in - chunk_tag::diff]) & lane_mask;
+      ++in;
+      QOIXX_HPP_UPDATE();
+      QOIXX_HPP_CHUNK_DONE();
+      QOIXX_HPP_DISPATCH();
+     op_luma:
+      count<&stats::luma>();
+      px = (px + luma_g_lanes[in[0] - chunk_tag::luma] + luma_rb_lanes[in[1]]) & lane_mask;
+      in += 2;
+      QOIXX_HPP_UPDATE();
+      QOIXX_HPP_CHUNK_DONE();
+      QOIXX_HPP_DISPATCH();
+     op_run:
+      {
+        static constexpr std::uint32_t mask_tail_6 = 0b0011'1111u;
+        count_run((*in & mask_tail_6) + 1u);
+        const auto run = std::min<std::size_t>(*in++ & mask_tail_6, px_len-1);
+        px_len -= run;
+        k = std::min(k, px_len);
+        if constexpr(Pusher::is_contiguous){
+          auto n = run+1;
+          if constexpr(Channels == 4){
+            // at least 4 more pixels follow the run, so the last 16 byte block may overshoot into them
+            if(px_len > 4){
+              const std::array<std::uint32_t, 4> block = {packed, packed, packed, packed};
+              for(std::size_t i = 0; i < n; i += 4)
+                std::memcpy(out + i*Channels, block.data(), sizeof(block));
+              out += n*Channels;
+              n = 0;
+            }
+          }
+          for(; n > 0; --n, out += Channels)
+            efficient_memcpy<Channels>(out, &packed);
+        }
+        else
+          fill_run<Channels>(pixels, std::bit_cast<rgba_t>(packed), run);
+      }
+      QOIXX_HPP_CHUNK_DONE();
+      QOIXX_HPP_DISPATCH();
+     op_rgb:
+      count<&stats::rgb>();
+      px = lanes(in[1], in[2], in[3]) | (px & lanes(0, 0, 0, 255));
+      in += 4;
+      QOIXX_HPP_UPDATE();
+      QOIXX_HPP_CHUNK_DONE();
+      QOIXX_HPP_DISPATCH();
+     op_rgba:
+      count<&stats::rgba>();
+      if constexpr(Channels == 4)
+        px = lanes(in[1], in[2], in[3], in[4]);
+      else
+        px = lanes(in[1], in[2], in[3]) | (px & lanes(0, 0, 0, 255));
+      in += 5;
+      QOIXX_HPP_UPDATE();
+      QOIXX_HPP_CHUNK_DONE();
+      QOIXX_HPP_DISPATCH();
+    }
+#undef QOIXX_HPP_DISPATCH
+#undef QOIXX_HPP_CHUNK_DONE
+#undef QOIXX_HPP_UPDATE
+#undef QOIXX_HPP_EMIT
+    if constexpr(Pusher::is_contiguous)
+      pixels.advance(static_cast<std::size_t>(out - pixels.raw_pointer()));
+    p.advance(static_cast<std::size_t>(in - begin));
+  }
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+  template<std::size_t Channels, typename Pusher, typename Puller>
+  static inline void decode_selected(Pusher& pixels, Puller& p, std::size_t px_len, std::size_t size){
+    auto d = selected_decoder.load(std::memory_order_relaxed);
+    if(d == qoi::decoder::automatic)[[unlikely]]
+      d = calibrate_decoder();
+    if constexpr(Puller::is_contiguous)
+      if(d == qoi::decoder::dispatch){
+        decode_dispatch<Channels>(pixels, p, px_len, size);
+        return;
+      }
+    if(d == qoi::decoder::tables || (d == qoi::decoder::dispatch && default_decoder == qoi::decoder::tables))
+      decode_impl<Channels, true>(pixels, p, px_len, size);
+    else
+      decode_impl<Channels, false>(pixels, p, px_len, size);
+  }
+  template<qoi::decoder Decoder>
+  static inline std::chrono::steady_clock::duration decode_time(const std::vector<std::uint8_t>& encoded, std::vector<std::uint8_t>& out, std::size_t px_len){
+    using co = container_operator<std::vector<std::uint8_t>>;
+    auto puller = co::create_puller(encoded);
+    decode_header(puller);
+    auto pusher = co::create_pusher(out);
+    const auto begin = std::chrono::steady_clock::now();
+    if constexpr(Decoder == qoi::decoder::dispatch)
+      decode_dispatch<4>(pusher, puller, px_len, encoded.size());
+    else
+      decode_impl<4, Decoder == qoi::decoder::tables>(pusher, puller, px_len, encoded.size());
+    return std::chrono::steady_clock::now() - begin;
+  }
+  static inline std::size_t mismatch(const std::uint8_t* a, const std::uint8_t* b, std::size_t n)noexcept{
+    std::size_t i = 0;
+#ifndef QOIXX_NO_SIMD
+#if defined(__ARM_FEATURE_SVE) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    for(; i < n; i += svcntb()){
+      const auto pg = svwhilelt_b8_u64(i, n);
+      const auto ne = svcmpne_u8(pg, svld1_u8(pg, a+i), svld1_u8(pg, b+i));
+      if(svptest_any(pg, ne))
+        return i + svcntp_b8(pg, svbrkb_b_z(pg, ne));
+    }
+#elif defined(__aarch64__) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    for(; i + 16 <= n; i += 16){
+      const auto ne = vmvnq_u8(vceqq_u8(vld1q_u8(a+i), vld1q_u8(b+i)));
+      const auto bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(ne), 4)), 0);
+      if(bits != 0)
+        return i + std::countr_zero(bits)/4;
+    }
+#elif defined(__AVX2__)
+    for(; i + 32 <= n; i += 32){
+      const auto eq = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a+i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b+i)))));
+      if(eq != 0xffffffffu)
+        return i + std::countr_one(eq);
+    }
+#elif defined(__riscv_vector) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    for(std::size_t vl; i < n; i += vl){
+      vl = __riscv_vsetvl_e8m8(n - i);
+      const auto first = __riscv_vfirst_m_b1(__riscv_vmsne_vv_u8m8_b1(__riscv_vle8_v_u8m8(a+i, vl), __riscv_vle8_v_u8m8(b+i, vl), vl), vl);
+      if(first >= 0)
+        return i + static_cast<std::size_t>(first);
+    }
+#elif defined(__SSE4_1__)
+    for(; i + 16 <= n; i += 16){
+      const auto eq = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a+i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b+i)))));
+      if(eq != 0xffffu)
+        return i + std::countr_one(eq);
+    }
+#endif
+#endif
+    for(; i + sizeof(std::uint64_t) <= n; i += sizeof(std::uint64_t)){
+      std::uint64_t x, y;
+      std::memcpy(&x, a+i, sizeof(x));
+      std::memcpy(&y, b+i, sizeof(y));
+      if(x != y){
+        if constexpr(std::endian::native == std::endian::little)
+          return i + std::countr_zero(x^y)/8;
+        else
+          return i + std::countl_zero(x^y)/8;
+      }
+    }
+    for(; i < n; ++i)
+      if(a[i] != b[i])
+        return i;
+    return n;
+  }
+  template<typename Puller>
+  struct chunk_reader{
+    Puller* p;
+    std::size_t size;
+    rgba_t px = {0, 0, 0, 255};
+    rgba_t index[index_size] = {};
+    chunk_reader(Puller& p, std::size_t size):p{&p}, size{size}{}
+    inline void consume(std::size_t n){
+      if(size < n)[[unlikely]]
+        throw std::runtime_error("qoixx::qoi: insufficient input data");
+      size -= n;
+    }
+    // reads one chunk and returns the number of pixels it covers
+    inline std::size_t next(){
+      consume(1);
+      const auto b1 = p->pull();
+      if(b1 >= chunk_tag::run){
+        if(b1 < chunk_tag::rgb){
+          static constexpr std::uint32_t mask_tail_6 = 0b0011'1111u;
+          return (b1 & mask_tail_6) + 1;
+        }
+        consume(b1 == chunk_tag::rgb ? 3 : 4);
+        px.r = p->pull();
+        px.g = p->pull();
+        px.b = p->pull();
+        if(b1 == chunk_tag::rgba)
+          px.a = p->pull();
+      }
+      else if(b1 < chunk_tag::diff){
+        px = index[b1];
+        return 1;
+      }
+      else if(b1 >= chunk_tag::luma){
+        consume(1);
+        const auto b2 = p->pull();
+        static constexpr int vgv = chunk_tag::luma+40;
+        const int vg = b1 - vgv;
+        static constexpr std::uint32_t mask_tail_4 = 0b0000'1111u;
+        px.r += vg + (b2 >> 4);
+        px.g += vg + 8;
+        px.b += vg + (b2 & mask_tail_4);
+      }
+      else{
+        static constexpr std::uint32_t mask_tail_2 = 0b0000'0011u;
+        px.r += ((b1 >> 4) & mask_tail_2) - 2;
+        px.g += ((b1 >> 2) & mask_tail_2) - 2;
+        px.b += ( b1       & mask_tail_2) - 2;
+      }
+      index[px.hash() % index_size] = px;
+      return 1;
+    }
+  };
+  static constexpr std::size_t max_encoded_size(const desc& desc)noexcept{
+    return static_cast<std::size_t>(desc.width) * desc.height * (stream_channels(desc.channels) + 1) + header_size + sizeof(padding);
+  }
+  template<typename U>
+  static inline void check_decode_argument(const U& u, std::uint8_t channels){
+    using coU = container_operator<U>;
+    if(!coU::valid(u) || coU::size(u) < header_size + sizeof(padding) || channels > 4)[[unlikely]]
+      throw std::invalid_argument{"qoixx::qoi::decode: invalid argument"};
+  }
+  template<typename U>
+  static inline void check_encode_argument(const U& u, const desc& desc, std::uint8_t min_channels = 3){
+    using coU = container_operator<U>;
+    if(!coU::valid(u) || coU::size(u) < desc.width*desc.height*desc.channels || desc.width == 0 || desc.height == 0 || desc.channels < min_channels || desc.channels > 4 || desc.height >= pixels_max / desc.width)[[unlikely]]
+      throw std::invalid_argument{"qoixx::qoi::encode: invalid argument"};
+    if constexpr(detail::planar_accessor<typename coU::puller>)
+      if(desc.channels != coU::puller::channels)[[unlikely]]
+        throw std::invalid_argument{"qoixx::qoi::encode: invalid argument"};
+  }
+  // gray and gray+alpha inputs are stored as RGB and RGBA
+  static constexpr std::uint8_t stream_channels(std::uint8_t channels)noexcept{
+    return channels < 3 ? channels + 2 : channels;
+  }
+  template<typename Pusher>
+  static inline void encode_header(Pusher& p, const desc& desc){
+    write_32(p, magic);
+    write_32(p, desc.width);
+    write_32(p, desc.height);
+    p.push(stream_channels(desc.channels));
+    p.push(static_cast<std::uint8_t>(desc.colorspace));
+  }
+  template<typename Puller>
+  static inline void skip_bytes(Puller& src, std::size_t n){
+    if constexpr(requires{src.advance(n);})
+      src.advance(n);
+    else
+      while(n --> 0)
+        src.pull();
+  }
+  template<typename Pusher, typename Puller>
+  static inline void copy_bytes(Pusher& dst, Puller& src, std::size_t n){
+    if constexpr(Pusher::is_contiguous && Puller::is_contiguous){
+      std::memcpy(dst.raw_pointer(), src.raw_pointer(), n);
+      dst.advance(n);
+      src.advance(n);
+    }
+    else
+      while(n --> 0)
+        dst.push(src.pull());
+  }
+  template<std::size_t Channels, typename Pusher>
+  struct downscale_pusher{
+    static constexpr bool is_contiguous = false;
+    Pusher* out;
+    std::uint32_t width;
+    std::uint32_t shift;
+    std::vector<std::uint16_t> acc;
+    std::uint32_t x = 0;
+    std::uint32_t y = 0;
+    downscale_pusher(Pusher& out, std::uint32_t width, std::uint32_t shift):out{&out}, width{width}, shift{shift}, acc(((width + (1u << shift) - 1) >> shift) * Channels){}
+    inline void accumulate(const std::uint8_t* px, std::uint32_t begin, std::uint32_t end)noexcept{
+      for(auto c = begin >> shift; begin < end; ++c){
+        const auto next = std::min(end, (c+1) << shift);
+        for(std::size_t k = 0; k < Channels; ++k)
+          acc[c*Channels+k] += static_cast<std::uint16_t>(px[k] * (next-begin));
+        begin = next;
+      }
+    }
+    inline void flush(){
+      if(y == 0)
+        return;
+      std::uint8_t px[Channels];
+      for(std::uint32_t c = 0; c < acc.size() / Channels; ++c){
+        const auto cnt = (std::min(width, (c+1) << shift) - (c << shift)) * y;
+        for(std::size_t k = 0; k < Channels; ++k)
+          px[k] = static_cast<std::uint8_t>((acc[c*Channels+k] + cnt/2) / cnt);
+        push<Channels>(*out, px);
+      }
+      std::ranges::fill(acc, 0);
+      y = 0;
+    }
+    inline void next_row(){
+      x = 0;
+      if(++y == 1u << shift)
+        flush();
+    }
+    template<std::size_t Size>
+    inline void push_pixel(const std::uint8_t* px){
+      const auto c = (x >> shift) * Channels;
+      for(std::size_t k = 0; k < Size; ++k)
+        acc[c+k] += px[k];
+      if(++x == width)
+        next_row();
+    }
+    template<std::size_t Size>
+    inline void fill(const std::uint8_t* px, std::size_t n){
+      while(n > 0){
+        const auto end = static_cast<std::uint32_t>(std::min<std::size_t>(width, x + n));
+        accumulate(px, x, end);
+        n -= end - x;
+        x = end;
+        if(x == width)
+          next_row();
+      }
+    }
+  };
+  static constexpr std::size_t stream_alignment = 32;
+  // copies n bytes (a multiple of stream_alignment) from an aligned src to an aligned dst with non-temporal stores
+  static inline void stream_copy(std::uint8_t* dst, const std::uint8_t* src, std::size_t n)noexcept{
+#ifndef QOIXX_NO_SIMD
+#if defined(__aarch64__) && defined(__GNUC__) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    for(std::size_t i = 0; i < n; i += stream_alignment){
+      const auto lo = vld1q_u8(src+i);
+      const auto hi = vld1q_u8(src+i+16);
+      asm volatile("stnp %q0, %q1, [%2]" :: "w"(lo), "w"(hi), "r"(dst+i) : "memory");
+    }
+    return;
+#elif defined(__AVX2__)
+    for(std::size_t i = 0; i < n; i += stream_alignment)
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(dst+i), _mm256_load_si256(reinterpret_cast<const __m256i*>(src+i)));
+    return;
+#elif defined(__SSE2__)
+    for(std::size_t i = 0; i < n; i += 16)
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst+i), _mm_load_si128(reinterpret_cast<const __m128i*>(src+i)));
+    return;
+#endif
+#endif
+    std::memcpy(dst, src, n);
+  }
+  static inline void stream_fence()noexcept{
+#ifndef QOIXX_NO_SIMD
+#if defined(__aarch64__) && defined(__GNUC__) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    asm volatile("dmb ishst" ::: "memory");
+#elif defined(__SSE2__)
+    _mm_sfence();
+#endif
+#endif
+  }
+  // collects the pixels in a cache-resident block and writes each full block to the contiguous output with non-temporal stores,
+  // so that a decode output larger than the last level cache does not evict the data of other threads
+  template<typename Pusher>
+  struct streaming_pusher{
+    static constexpr bool is_contiguous = false;
+    static constexpr std::size_t block_size = 4096;
+    Pusher* out;
+    std::uint8_t* dst;
+    std::size_t written = 0;
+    std::size_t pos = 0;
+    std::size_t capacity;
+    alignas(64) std::uint8_t block[block_size + 64];
+    explicit streaming_pusher(Pusher& out)noexcept:out{&out}, dst{out.raw_pointer()}, capacity{block_size - (reinterpret_cast<std::uintptr_t>(dst) & (stream_alignment-1))}{}
+    inline void flush_block()noexcept{
+      if((reinterpret_cast<std::uintptr_t>(dst+written) & (stream_alignment-1)) == 0)
+        stream_copy(dst+written, block, capacity);
+      else
+        std::memcpy(dst+written, block, capacity);
+      written += capacity;
+      pos -= capacity;
+      std::memcpy(block, block+capacity, pos);
+      capacity = block_size;
+    }
+    template<std::size_t Size>
+    inline void push_pixel(const std::uint8_t* px)noexcept{
+      std::memcpy(block+pos, px, Size);
+      pos += Size;
+      if(pos >= capacity)[[unlikely]]
+        flush_block();
+    }
+    template<std::size_t Size>
+    inline void fill(const std::uint8_t* px, std::size_t n)noexcept{
+      while(n--)
+        push_pixel<Size>(px);
+    }
+    inline void flush()noexcept{
+      std::size_t n = 0;
+      if((reinterpret_cast<std::uintptr_t>(dst+written) & (stream_alignment-1)) == 0){
+        n = pos & ~(stream_alignment-1);
+        stream_copy(dst+written, block, n);
+      }
+      std::memcpy(dst+written+n, block+n, pos-n);
+      stream_fence();
+      out->advance(written+pos);
+    }
+  };
+#if !defined(QOIXX_NO_SIMD) && ((defined(__aarch64__) && defined(__GNUC__) && defined(QOIXX_EXPERIMENTAL_SIMD)) || defined(__SSE2__))
+  static constexpr bool has_stream_stores = true;
+#else
+  static constexpr bool has_stream_stores = false;
+#endif
+#ifdef QOIXX_DECODE_STREAMING_THRESHOLD
+  static inline std::atomic<std::size_t> streaming_threshold{QOIXX_DECODE_STREAMING_THRESHOLD};
+#else
+  // without non-temporal stores the staging block is only an extra copy, so it is off unless requested
+  static inline std::atomic<std::size_t> streaming_threshold{has_stream_stores ? std::size_t{64} << 20 : std::numeric_limits<std::size_t>::max()};
+#endif
+
+  // "qoi+lz" container: the magic "qoiz", then the plain QOI stream (header, chunks and padding) in independently compressed blocks
+  //   "qoiz" | block | block | ... | 0
+  // the 14 byte QOI header is not stored in front of the blocks: it is the start of the first block, compressed with the chunks
+  // every block starts with a big endian 32 bit word: the size of the block data, with the top bit set for a block stored uncompressed
+  // a zero word ends the stream
+  // a compressed block is a sequence of LZ4 style sequences:
+  //   token (high nibble: literal length, low nibble: match length - 4; 15 continues with 255-terminated extra bytes)
+  //   literals, 16 bit little endian match offset, extra match length bytes
+  // and its last sequence has only the literals
+  static constexpr std::uint32_t lz_magic =
+    113u /*q*/ << 24 | 111u /*o*/ << 16 | 105u /*i*/ <<  8 | 122u /*z*/ ;
+  static constexpr std::size_t lz_block_size = std::size_t{1} << 16;
+  static constexpr std::uint32_t lz_stored_flag = 0x8000'0000u;
+  static constexpr std::size_t lz_min_match = 4;
+  static constexpr std::size_t lz_hash_bits = 12;
+  // returns the size written to dst, or 0 when the block does not fit in dst_size bytes
+  static inline std::size_t lz_compress(const std::uint8_t* src, std::size_t n, std::uint8_t* dst, std::size_t dst_size)noexcept{
+    std::uint16_t table[std::size_t{1} << lz_hash_bits] = {};
+    std::size_t out = 0;
+    const auto put_length = [&](std::size_t len)noexcept{
+      for(; len >= 255; len -= 255){
+        if(out == dst_size)
+          return false;
+        dst[out++] = 255;
+      }
+      if(out == dst_size)
+        return false;
+      dst[out++] = static_cast<std::uint8_t>(len);
+      return true;
+    };
+    const auto put_literals = [&](std::uint8_t token_match, const std::uint8_t* lit, std::size_t lit_len)noexcept{
+      if(out == dst_size)
+        return false;
+      dst[out++] = static_cast<std::uint8_t>(std::min<std::size_t>(lit_len, 15) << 4 | token_match);
+      if(lit_len >= 15 && !put_length(lit_len - 15))
+        return false;
+      if(dst_size - out < lit_len)
+        return false;
+      std::memcpy(dst + out, lit, lit_len);
+      out += lit_len;
+      return true;
+    };
+    std::size_t anchor = 0, i = 0;
+    while(i + lz_min_match <= n){
+      std::uint32_t seq;
+      std::memcpy(&seq, src + i, sizeof(seq));
+      auto& entry = table[(seq * 2654435761u) >> (32 - lz_hash_bits)];
+      const std::size_t candidate = entry;
+      entry = static_cast<std::uint16_t>(i);
+      if(candidate >= i || std::memcmp(src + candidate, src + i, lz_min_match) != 0){
+        // the longer nothing matched, the faster the scan skips ahead
+        i += 1 + ((i - anchor) >> 6);
+        continue;
+      }
+      std::size_t len = lz_min_match;
+      while(i + len + sizeof(std::uint64_t) <= n){
+        std::uint64_t x, y;
+        std::memcpy(&x, src + candidate + len, sizeof(x));
+        std::memcpy(&y, src + i + len, sizeof(y));
+        if(x != y){
+          len += static_cast<std::size_t>(std::endian::native == std::endian::little ? std::countr_zero(x ^ y) : std::countl_zero(x ^ y)) / 8;
+          break;
+        }
+        len += sizeof(std::uint64_t);
+      }
+      if(i + len + sizeof(std::uint64_t) > n)
+        while(i + len < n && src[candidate + len] == src[i + len])
+          ++len;
+      const auto match = len - lz_min_match;
+      if(!put_literals(static_cast<std::uint8_t>(std::min<std::size_t>(match, 15)), src + anchor, i - anchor))
+        return 0;
+      if(dst_size - out < 2)
+        return 0;
+      const auto offset = i - candidate;
+      dst[out++] = static_cast<std::uint8_t>(offset);
+      dst[out++] = static_cast<std::uint8_t>(offset >> 8);
+      if(match >= 15 && !put_length(match - 15))
+        return 0;
+      i += len;
+      anchor = i;
+    }
+    if(!put_literals(0, src + anchor, n - anchor))
+      return 0;
+    return out;
+  }
+  // returns the size written to dst, throws when the block is malformed or expands beyond dst_size bytes
+  static inline std::size_t lz_decompress(const std::uint8_t* src, std::size_t n, std::uint8_t* dst, std::size_t dst_size){
+    std::size_t in = 0, out = 0;
+    const auto corrupted = []{
+      throw std::runtime_error("qoixx::qoi::decode_lz: corrupted block");
+    };
+    const auto get_length = [&](std::size_t len){
+      std::uint8_t b;
+      do{
+        if(in == n)
+          corrupted();
+        b = src[in++];
+        len += b;
+      }while(b == 255);
+      return len;
+    };
+    for(;;){
+      if(in == n)
+        corrupted();
+      const auto token = src[in++];
+      std::size_t lit_len = token >> 4;
+      if(lit_len == 15)
+        lit_len = get_length(lit_len);
+      if(n - in < lit_len || dst_size - out < lit_len)
+        corrupted();
+      std::memcpy(dst + out, src + in, lit_len);
+      in += lit_len;
+      out += lit_len;
+      if(in == n)
+        return out;
+      if(n - in < 2)
+        corrupted();
+      const std::size_t offset = src[in] | std::size_t{src[in+1]} << 8;
+      in += 2;
+      std::size_t len = token & 0x0fu;
+      if(len == 15)
+        len = get_length(len);
+      len += lz_min_match;
+      if(offset == 0 || offset > out || dst_size - out < len)
+        corrupted();
+      if(offset >= len)
+        std::memcpy(dst + out, dst + out - offset, len);
+      else
+        for(std::size_t k = 0; k < len; ++k)
+          dst[out + k] = dst[out + k - offset];
+      out += len;
+    }
+  }
+  template<typename Pusher>
+  static inline void push_bytes(Pusher& p, const std::uint8_t* src, std::size_t n){
+    if constexpr(Pusher::is_contiguous){
+      std::memcpy(p.raw_pointer(), src, n);
+      p.advance(n);
+    }
+    else
+      while(n --> 0)
+        p.push(*src++);
+  }
+  // pulls the plain QOI stream out of a qoi+lz container one block at a time
+  template<typename Puller>
+  struct lz_puller{
+    static constexpr bool is_contiguous = false;
+    Puller src;
+    std::size_t remaining;
+    std::unique_ptr<std::uint8_t[]> block = std::make_unique_for_overwrite<std::uint8_t[]>(lz_block_size);
+    std::unique_ptr<std::uint8_t[]> compressed;
+    const std::uint8_t* cur = nullptr;
+    const std::uint8_t* end = nullptr;
+    lz_puller(Puller src, std::size_t size):src{src}, remaining{size}{
+      if(read_32(this->src) != lz_magic)
+        throw std::runtime_error("qoixx::qoi::decode_lz: invalid header");
+      remaining -= sizeof(lz_magic);
+    }
+    inline void refill(){
+      if(remaining < sizeof(std::uint32_t))[[unlikely]]
+        throw std::runtime_error("qoixx::qoi::decode: insufficient input data");
+      const auto word = read_32(src);
+      remaining -= sizeof(word);
+      const std::size_t size = word & ~lz_stored_flag;
+      if(word == 0 || size > lz_block_size || size > remaining)[[unlikely]]
+        throw std::runtime_error("qoixx::qoi::decode: insufficient input data");
+      remaining -= size;
+      const std::uint8_t* data;
+      if constexpr(Puller::is_contiguous){
+        data = src.raw_pointer();
+        src.advance(size);
+      }
+      else{
+        if(!compressed)
+          compressed = std::make_unique_for_overwrite<std::uint8_t[]>(lz_block_size);
+        for(std::size_t i = 0; i < size; ++i)
+          compressed[i] = src.pull();
+        data = compressed.get();
+      }
+      if(word & lz_stored_flag){
+        cur = data;
+        end = data + size;
+      }
+      else{
+        cur = block.get();
+        end = cur + lz_decompress(data, size, block.get(), lz_block_size);
+      }
+    }
+    inline std::uint8_t pull(){
+      while(cur == end)[[unlikely]]
+        refill();
+      return *cur++;
+    }
+    inline void advance(std::size_t n){
+      while(n --> 0)
+        pull();
+    }
+  };
+  template<typename T, typename U, typename Construct>
+  static inline T encode_with(const U& u, const desc& desc, Construct&& construct){
+    check_encode_argument(u, desc, 1);
+
+    const auto max_size = max_encoded_size(desc);
+    using coT = container_operator<T>;
+    static_assert(!detail::planar_accessor<typename coT::pusher>, "qoixx::qoi::encode: planar containers cannot hold encoded data");
+    T data = construct(max_size);
+    auto p = coT::create_pusher(data);
+    encode_to(p, u, desc);
+    return p.finalize();
+  }
+  template<typename Pusher, typename U>
+  static inline void encode_to(Pusher& p, const U& u, const desc& desc){
+    auto puller = container_operator<U>::create_puller(u);
+
+    encode_header(p, desc);
+
+#if !defined(QOIXX_NO_SIMD) && defined(__aarch64__) && !defined(QOIXX_EXPERIMENTAL_SIMD)
+    // the NEON and SVE kernels as originally shipped encode a whole interleaved image, padding included;
+    // every other input takes the scalar path until the newer kernels are verified on aarch64
+    if constexpr(Pusher::is_contiguous && decltype(puller)::is_contiguous)
+      if(desc.channels >= 3){
+        [[maybe_unused]] const auto chunks = p.raw_pointer();
+        const std::size_t px_len = static_cast<std::size_t>(desc.width) * desc.height;
+#if defined(__ARM_FEATURE_SVE)
+        count<&stats::simd_pixels>(px_len);
+        switch(svcntb()){
+#define QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(i) case i/8: desc.channels == 4 ? encode_sve<i, 4>(p, puller, desc) : encode_sve<i, 3>(p, puller, desc); break
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(128);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(256);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(384);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(512);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(640);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(768);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(896);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1024);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1152);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1280);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1408);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1536);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1664);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1792);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1920);
+          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(2048);
+#undef QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE
+          default: while(true){/*unreachable*/}
+        }
+#else
+        count<&stats::simd_pixels>(px_len / simd_lanes * simd_lanes);
+        if(desc.channels == 4)
+          encode_neon<4>(p, puller, desc);
+        else
+          encode_neon<3>(p, puller, desc);
+#endif
+        count_chunks(chunks, p.raw_pointer() - sizeof(padding));
+        return;
+      }
+#endif
+    encode_state state;
+    const std::size_t px_len = static_cast<std::size_t>(desc.width) * desc.height;
+    [[maybe_unused]] const std::uint8_t* chunks = nullptr;
+    if constexpr(stats_enabled && Pusher::is_contiguous)
+      chunks = p.raw_pointer();
+    encode_pixels(p, puller, state, px_len, desc.channels);
+    push_run(p, state.run);
+    if constexpr(stats_enabled && Pusher::is_contiguous)
+      count_chunks(chunks, p.raw_pointer());
+
+    push<sizeof(padding)>(p, padding);
+  }
+  template<typename T, typename U, typename Construct>
+  static inline std::pair<T, desc> decode_with(const U& u, std::uint8_t channels, Construct&& construct){
+    using coU = container_operator<U>;
+    check_decode_argument(u, channels);
+    auto puller = coU::create_puller(u);
+    return decode_from<T>(puller, coU::size(u), channels, construct);
+  }
+  template<typename T, typename Puller, typename Construct>
+  static inline std::pair<T, desc> decode_from(Puller& puller, std::size_t size, std::uint8_t channels, Construct&& construct){
+    using coT = container_operator<T>;
+    if constexpr(detail::planar_accessor<typename coT::pusher>){
+      if(channels != 0 && channels != coT::pusher::channels)[[unlikely]]
+        throw std::invalid_argument{"qoixx::qoi::decode: invalid argument"};
+      channels = coT::pusher::channels;
+    }
+
+    const auto d = decode_header(puller);
+    if(channels == 0)
+      channels = d.channels;
+
+    const std::size_t px_len = static_cast<std::size_t>(d.width) * d.height;
+    T data = construct(px_len*channels);
+    auto p = coT::create_pusher(data);
+    decode_to(p, puller, px_len, size, channels);
+    return std::make_pair(std::move(p.finalize()), d);
+  }
+  template<typename Pusher, typename Puller>
+  static inline void decode_to(Pusher& p, Puller& puller, std::size_t px_len, std::size_t size, std::uint8_t channels){
+    if constexpr(Pusher::is_contiguous)
+      if(px_len*channels >= streaming_threshold.load(std::memory_order_relaxed)){
+        streaming_pusher<Pusher> sp{p};
+        decode_channels(sp, puller, px_len, size, channels);
+        sp.flush();
+        return;
+      }
+    decode_channels(p, puller, px_len, size, channels);
+  }
+  // 1 and 2 channel outputs take the gray value (and the alpha) of a gray stream
+  template<typename Pusher, typename Puller>
+  static inline void decode_channels(Pusher& p, Puller& puller, std::size_t px_len, std::size_t size, std::uint8_t channels){
+    if constexpr(!detail::planar_accessor<Pusher>)
+      if(channels < 3){
+        if(channels == 2){
+          detail::gray_pusher<2, Pusher> gray{&p};
+          decode_selected<4>(gray, puller, px_len, size);
+        }
+        else{
+          detail::gray_pusher<1, Pusher> gray{&p};
+          decode_selected<3>(gray, puller, px_len, size);
+        }
+        return;
+      }
+    if(channels == 4)
+      decode_selected<4>(p, puller, px_len, size);
+    else
+      decode_selected<3>(p, puller, px_len, size);
+  }
+  // static_encode and static_decode run in constant evaluation, so they work on plain bytes without memcpy, tables or SIMD
+  struct static_pixel{
+    std::uint8_t r = 0, g = 0, b = 0, a = 0;
+    constexpr bool operator==(const static_pixel&)const noexcept = default;
+    constexpr std::size_t hash()const noexcept{
+      return (r*3u + g*5u + b*7u + a*11u) % index_size;
+    }
+  };
+  template<typename U>
+  static constexpr std::uint8_t static_byte(const U& u, std::size_t i)noexcept{
+    return static_cast<std::uint8_t>(u[i]);
+  }
+  // calls emit with each byte of the encoded image; the chunks are the ones encode_body chooses, so the output matches encode
+  template<typename U, typename Emit>
+  static constexpr void static_encode_to(const U& u, const desc& desc, Emit&& emit){
+    if(desc.width == 0 || desc.height == 0 || desc.channels < 1 || desc.channels > 4 || desc.height >= pixels_max / desc.width || std::size(u) < static_cast<std::size_t>(desc.width)*desc.height*desc.channels)
+      throw std::invalid_argument{"qoixx::qoi::static_encode: invalid argument"};
+    const auto emit_32 = [&emit](std::uint32_t x){
+      emit(static_cast<std::uint8_t>(x >> 24));
+      emit(static_cast<std::uint8_t>(x >> 16));
+      emit(static_cast<std::uint8_t>(x >>  8));
+      emit(static_cast<std::uint8_t>(x      ));
+    };
+    emit_32(magic);
+    emit_32(desc.width);
+    emit_32(desc.height);
+    emit(stream_channels(desc.channels));
+    emit(static_cast<std::uint8_t>(desc.colorspace));
+
+    static_pixel index[index_size] = {};
+    static_pixel prev = {0, 0, 0, 255};
+    std::size_t prev_hash = index_size;
+    std::size_t run = 0;
+    const std::size_t px_len = static_cast<std::size_t>(desc.width) * desc.height;
+    const std::size_t channels = desc.channels;
+    for(std::size_t i = 0; i < px_len; ++i){
+      const auto at = i*channels;
+      static_pixel px = {static_byte(u, at), 0, 0, 255};
+      if(channels < 3){
+        px.g = px.b = px.r;
+        if(channels == 2)
+          px.a = static_byte(u, at+1);
+      }
+      else{
+        px.g = static_byte(u, at+1);
+        px.b = static_byte(u, at+2);
+        if(channels == 4)
+          px.a = static_byte(u, at+3);
+      }
+      if(px == prev){
+        ++run;
+        continue;
+      }
+      for(; run >= 62; run -= 62)
+        emit(chunk_tag::run | 61);
+      if(run > 1)
+        emit(chunk_tag::run | (run-1));
+      else if(run == 1)
+        emit(prev_hash == index_size ? std::size_t{chunk_tag::run} : chunk_tag::index | prev_hash);
+      run = 0;
+
+      const auto index_pos = px.hash();
+      prev_hash = index_pos;
+      if(index[index_pos] == px)
+        emit(chunk_tag::index | index_pos);
+      else{
+        index[index_pos] = px;
+        const auto vg_2 = static_cast<int>(px.g) - static_cast<int>(prev.g);
+        const auto vr = static_cast<int>(px.r) - static_cast<int>(prev.r) + 2;
+        const auto vg = vg_2 + 2;
+        const auto vb = static_cast<int>(px.b) - static_cast<int>(prev.b) + 2;
+        const auto vg_r = vr - vg + 8;
+        const auto vg_b = vb - vg + 8;
+        if(px.a != prev.a){
+          emit(chunk_tag::rgba);
+          emit(px.r);
+          emit(px.g);
+          emit(px.b);
+          emit(px.a);
+        }
+        else if(static_cast<std::uint8_t>(vg_2+32) < 64 && static_cast<std::uint8_t>(vr|vg|vb) < 4)
+          emit(chunk_tag::diff | vr << 4 | vg << 2 | vb);
+        else if(static_cast<std::uint8_t>(vg_2+32) < 64 && static_cast<std::uint8_t>(vg_r|vg_b) < 16){
+          emit(chunk_tag::luma | static_cast<std::uint8_t>(vg_2+32));
+          emit(vg_r << 4 | vg_b);
+        }
+        else{
+          emit(chunk_tag::rgb);
+          emit(px.r);
+          emit(px.g);
+          emit(px.b);
+        }
+      }
+      prev = px;
+    }
+    for(; run >= 62; run -= 62)
+      emit(chunk_tag::run | 61);
+    if(run > 0)
+      emit(chunk_tag::run | (run-1));
+    for(auto x : padding)
+      emit(x);
+  }
+  template<typename U>
+  static constexpr std::size_t static_encoded_size(const U& u, const desc& desc){
+    std::size_t size = 0;
+    static_encode_to(u, desc, [&size](std::uint8_t){++size;});
+    return size;
+  }
+  template<typename U>
+  static constexpr desc static_decode_header(const U& u){
+    if(std::size(u) < header_size + sizeof(padding))
+      throw std::invalid_argument{"qoixx::qoi::static_decode: invalid argument"};
+    const auto read_32 = [&u](std::size_t i){
+      return static_cast<std::uint32_t>(static_byte(u, i)) << 24 | static_cast<std::uint32_t>(static_byte(u, i+1)) << 16 |
+             static_cast<std::uint32_t>(static_byte(u, i+2)) <<  8 | static_cast<std::uint32_t>(static_byte(u, i+3));
+    };
+    const desc d = {read_32(4), read_32(8), static_byte(u, 12), static_cast<qoi::colorspace>(static_byte(u, 13))};
+    if(
+      d.width == 0 || d.height == 0 || read_32(0) != magic ||
+      d.channels < 3 || d.channels > 4 ||
+      d.height >= pixels_max / d.width
+    )
+      throw std::runtime_error("qoixx::qoi::static_decode: invalid header");
+    return d;
   }
-#else
-#define QOIXX_HPP_DECODE_RUN(px, run) do{push<Channels>(pixels, &px);}while(run--);
-#endif
-
+  // the chunks are read as chunk_reader does, with the index also updated by runs as in the reference decoder
+  template<typename U, typename T>
+  static constexpr void static_decode_to(T& out, const U& u, std::size_t px_len, std::uint8_t channels){
+    const std::size_t size = std::size(u);
+    std::size_t pos = header_size;
+    const auto next = [&u, &pos, size]{
+      if(size - pos <= sizeof(padding))
+        throw std::runtime_error("qoixx::qoi::static_decode: insufficient input data");
+      return static_byte(u, pos++);
+    };
+    static_pixel index[index_size] = {};
+    static_pixel px = {0, 0, 0, 255};
+    std::size_t o = 0;
+    for(std::size_t i = 0; i < px_len;){
+      const auto b1 = next();
+      std::size_t n = 1;
       if(b1 >= chunk_tag::run){
         if(b1 < chunk_tag::rgb){
-          /*run*/
-          static constexpr std::uint32_t mask_tail_6 = 0b0011'1111u;
-          std::size_t run = b1 & mask_tail_6;
-          if(run >= px_len)[[unlikely]]
-            run = px_len;
-          px_len -= run;
-          QOIXX_HPP_DECODE_RUN(px, run)
-          return;
-        }
-        if(b1 == chunk_tag::rgb){
-          pull<3>(&px, p);
-          size -= 3;
-          QOIXX_HPP_WITH_TABLES(hash = px.hash() % index_size;)
-        }
-        if constexpr(Channels == 4){
-          if(b1 == chunk_tag::rgba){
-            pull<4>(&px, p);
-            size -= 4;
-            QOIXX_HPP_WITH_TABLES(hash = px.hash() % index_size;)
-          }
+          constexpr std::uint32_t mask_tail_6 = 0b0011'1111u;
+          n = (b1 & mask_tail_6) + 1;
         }
         else{
-          if(b1 == chunk_tag::rgba)[[unlikely]]{
-            pull<3>(&px, p);
-            p.advance(1);
-            size -= 4;
-            QOIXX_HPP_WITH_TABLES(hash = px.hash() % index_size;)
-          }
+          px.r = next();
+          px.g = next();
+          px.b = next();
+          if(b1 == chunk_tag::rgba)
+            px.a = next();
         }
       }
-      else if(b1 < chunk_tag::diff){
-        /*index*/
-        if constexpr(std::is_same<rgba_t, qoi::rgba_t>::value)
-          px = index[b1];
-        else
-          efficient_memcpy<Channels>(&px, index + b1);
-        push<Channels>(pixels, &px);
-        QOIXX_HPP_WITH_TABLES(hash = b1;)
-        return;
-      }
+      else if(b1 < chunk_tag::diff)
+        px = index[b1];
       else if(b1 >= chunk_tag::luma){
-        /*luma*/
-        const auto b2 = p.pull();
-        --size;
-        QOIXX_HPP_WITH_TABLES(
-        static constexpr auto table = create_luma_table();
-        const auto drb = table[b2];
-        )
-        static constexpr int vgv = chunk_tag::luma+40;
+        const auto b2 = next();
+        constexpr int vgv = chunk_tag::luma+40;
         const int vg = b1 - vgv;
-        QOIXX_HPP_WITH_TABLES(
-        px.r += vg + drb[0];
-        px.g += vg + 8;
-        px.b += vg + drb[1];
-        hash = (static_cast<int>(hash)+hash_diff_table[b1]+luma_hash_diff_table[b2]) % index_size;
-        ) QOIXX_HPP_WITHOUT_TABLES(
-        static constexpr std::uint32_t mask_tail_4 = 0b0000'1111u;
+        constexpr std::uint32_t mask_tail_4 = 0b0000'1111u;
         px.r += vg + (b2 >> 4);
         px.g += vg + 8;
         px.b += vg + (b2 & mask_tail_4);
-        )
       }
       else{
-        /*diff*/
-        QOIXX_HPP_WITH_TABLES(
-        static constexpr auto table = create_diff_table();
-        const auto drgb = table[b1];
-        px.r += drgb[0];
-        px.g += drgb[1];
-        px.b += drgb[2];
-        hash = (static_cast<int>(hash)+hash_diff_table[b1]) % index_size;
-        ) QOIXX_HPP_WITHOUT_TABLES(
-        static constexpr std::uint32_t mask_tail_2 = 0b0000'0011u;
+        constexpr std::uint32_t mask_tail_2 = 0b0000'0011u;
         px.r += ((b1 >> 4) & mask_tail_2) - 2;
         px.g += ((b1 >> 2) & mask_tail_2) - 2;
         px.b += ( b1       & mask_tail_2) - 2;
-        )
       }
-#undef QOIXX_HPP_DECODE_RUN
-      if constexpr(std::is_same<rgba_t, qoi::rgba_t>::value)
-        index[QOIXX_HPP_WITH_TABLES(hash) QOIXX_HPP_WITHOUT_TABLES(px.hash() % index_size)] = px;
-      else
-        efficient_memcpy<Channels>(index + QOIXX_HPP_WITH_TABLES(hash) QOIXX_HPP_WITHOUT_TABLES(px.hash() % index_size), &px);
-#undef QOIXX_HPP_WITHOUT_TABLES
-#undef QOIXX_HPP_WITH_TABLES
-#ifdef QOIXX_HPP_DECODE_WITH_TABLES_NOT_DEFINED
-#undef QOIXX_DECODE_WITH_TABLES
-#undef QOIXX_HPP_DECODE_WITH_TABLES_NOT_DEFINED
-#endif
-
-      push<Channels>(pixels, &px);
-    };
-
-    while(px_len--)[[likely]]{
-      f();
-      if(size < sizeof(padding))[[unlikely]]{
-        throw std::runtime_error("qoixx::qoi::decode: insufficient input data");
+      index[px.hash()] = px;
+      if(channels < 3 && (px.r != px.g || px.g != px.b))
+        throw std::runtime_error("qoixx::qoi::static_decode: the image is not gray");
+      for(const auto end = std::min(i+n, px_len); i < end; ++i){
+        out[o++] = px.r;
+        if(channels == 2)
+          out[o++] = px.a;
+        if(channels < 3)
+          continue;
+        out[o++] = px.g;
+        out[o++] = px.b;
+        if(channels == 4)
+          out[o++] = px.a;
       }
     }
   }
  public:
   template<typename T, typename U>
   static inline T encode(const U& u, const desc& desc){
+    return encode_with<T>(u, desc, [](std::size_t size){return container_operator<T>::construct(size);});
+  }
+  // the output is allocated by container_operator<T>::construct(size, alloc), e.g. std::pmr::vector<std::uint8_t> from a std::pmr::memory_resource*
+  template<typename T, typename U, typename Allocator>
+  requires detail::allocator_constructible<T, Allocator>
+  static inline T encode(const U& u, const desc& desc, const Allocator& alloc){
+    return encode_with<T>(u, desc, [&](std::size_t size){return container_operator<T>::construct(size, alloc);});
+  }
+  template<typename T, typename U>
+  requires(sizeof(U) == 1)
+  static inline T encode(const U* pixels, std::size_t size, const desc& desc){
+    return encode<T>(std::make_pair(pixels, size), desc);
+  }
+  template<typename T, typename U, typename Allocator>
+  requires(sizeof(U) == 1) && detail::allocator_constructible<T, Allocator>
+  static inline T encode(const U* pixels, std::size_t size, const desc& desc, const Allocator& alloc){
+    return encode<T>(std::make_pair(pixels, size), desc, alloc);
+  }
+  // encodes a standard QOI stream whose pixels differ from the input by at most tol per channel,
+  // trading exactness for more run, index, diff and luma chunks
+  template<typename T, typename U>
+  static inline T encode_near_lossless(const U& u, const desc& desc, const tolerance& tol){
+    if(tol == tolerance{})
+      return encode<T>(u, desc);
+    check_encode_argument(u, desc);
+    using coT = container_operator<T>;
+    static_assert(!detail::planar_accessor<typename coT::pusher>, "qoixx::qoi::encode: planar containers cannot hold encoded data");
+    T data = coT::construct(max_encoded_size(desc));
+    auto p = coT::create_pusher(data);
+    auto puller = container_operator<U>::create_puller(u);
+
+    encode_header(p, desc);
+    const std::size_t px_len = static_cast<std::size_t>(desc.width) * desc.height;
+    [[maybe_unused]] const std::uint8_t* chunks = nullptr;
+    if constexpr(stats_enabled && coT::pusher::is_contiguous)
+      chunks = p.raw_pointer();
+    count<&stats::scalar_pixels>(px_len);
+    if(desc.channels == 4)
+      encode_near_lossless_body<4>(p, puller, px_len, tol);
+    else
+      encode_near_lossless_body<3>(p, puller, px_len, tol);
+    if constexpr(stats_enabled && coT::pusher::is_contiguous)
+      count_chunks(chunks, p.raw_pointer());
+    push<sizeof(padding)>(p, padding);
+
+    return p.finalize();
+  }
+  template<typename T, typename U>
+  requires(sizeof(U) == 1)
+  static inline T encode_near_lossless(const U* pixels, std::size_t size, const desc& desc, const tolerance& tol){
+    return encode_near_lossless<T>(std::make_pair(pixels, size), desc, tol);
+  }
+  // encodes into the qoi+lz container: the QOI stream is produced one cache sized block at a time and each block is compressed right away
+  // plain QOI decoders cannot read it, use decode_lz
+  template<typename T, typename U>
+  static inline T encode_lz(const U& u, const desc& desc){
+    check_encode_argument(u, desc, 1);
+    using coT = container_operator<T>;
+    static_assert(!detail::planar_accessor<typename coT::pusher>, "qoixx::qoi::encode: planar containers cannot hold encoded data");
+    const auto raw_max = max_encoded_size(desc);
+    T data = coT::construct(sizeof(lz_magic) + raw_max + (raw_max / lz_block_size + 2) * sizeof(std::uint32_t));
+    auto p = coT::create_pusher(data);
+    write_32(p, lz_magic);
+
+    // a slice of pixels never encodes to more than lz_block_size bytes, so the buffer holds a partial block, a slice and the slack of the SIMD encoders
+    const std::size_t slice = lz_block_size / (stream_channels(desc.channels) + 1u);
+    const auto raw = std::make_unique_for_overwrite<std::uint8_t[]>(lz_block_size * 2 + 256);
+    const auto compressed = std::make_unique_for_overwrite<std::uint8_t[]>(lz_block_size);
+    typename frame_buffer::pusher bp{raw.get()};
+    const auto flush_block = [&](std::size_t n){
+      const auto size = lz_compress(raw.get(), n, compressed.get(), n - 1);
+      if(size == 0){
+        write_32(p, static_cast<std::uint32_t>(n) | lz_stored_flag);
+        push_bytes(p, raw.get(), n);
+      }
+      else{
+        write_32(p, static_cast<std::uint32_t>(size));
+        push_bytes(p, compressed.get(), size);
+      }
+      std::memmove(raw.get(), raw.get() + n, bp.i - n);
+      bp.i -= n;
+    };
+
+    encode_header(bp, desc);
+    encode_state state;
+    auto puller = container_operator<U>::create_puller(u);
+    for(std::size_t px_len = static_cast<std::size_t>(desc.width) * desc.height; px_len > 0;){
+      const auto n = std::min(slice, px_len);
+      // the chunks are counted before a block boundary can split them
+      [[maybe_unused]] const auto chunks = raw.get() + bp.i;
+      encode_pixels(bp, puller, state, n, desc.channels);
+      count_chunks(chunks, raw.get() + bp.i);
+      px_len -= n;
+      while(bp.i >= lz_block_size)
+        flush_block(lz_block_size);
+    }
+    [[maybe_unused]] const auto run_chunks = raw.get() + bp.i;
+    push_run(bp, state.run);
+    count_chunks(run_chunks, raw.get() + bp.i);
+    push<sizeof(padding)>(bp, padding);
+    while(bp.i >= lz_block_size)
+      flush_block(lz_block_size);
+    if(bp.i > 0)
+      flush_block(bp.i);
+    write_32(p, 0);
+
+    return p.finalize();
+  }
+  template<typename T, typename U>
+  requires(sizeof(U) == 1)
+  static inline T encode_lz(const U* pixels, std::size_t size, const desc& desc){
+    return encode_lz<T>(std::make_pair(pixels, size), desc);
+  }
+  template<typename T, typename U, typename V, std::ranges::input_range R>
+  requires std::integral<std::ranges::range_value_t<R>>
+  static inline T encode_incremental(const U& u, const desc& desc, const V& previous, const R& dirty_rows){
     using coU = container_operator<U>;
-    if(!coU::valid(u) || coU::size(u) < desc.width*desc.height*desc.channels || desc.width == 0 || desc.height == 0 || desc.channels < 3 || desc.channels > 4 || desc.height >= pixels_max / desc.width)[[unlikely]]
-      throw std::invalid_argument{"qoixx::qoi::encode: invalid argument"};
+    using coV = container_operator<V>;
+    check_encode_argument(u, desc);
+    const auto previous_size = coV::size(previous);
+    if(!coV::valid(previous) || previous_size < header_size + sizeof(padding))[[unlikely]]
+      throw std::invalid_argument{"qoixx::qoi::encode_incremental: invalid argument"};
+    std::uint32_t first = desc.height, last = desc.height;
+    for(auto y : dirty_rows){
+      if(std::cmp_less(y, 0) || std::cmp_greater_equal(y, desc.height))[[unlikely]]
+        throw std::invalid_argument{"qoixx::qoi::encode_incremental: invalid argument"};
+      const auto row = static_cast<std::uint32_t>(y);
+      if(first == desc.height || row < first)
+        first = row;
+      if(last == desc.height || row > last)
+        last = row;
+    }
+    auto old_puller = coV::create_puller(previous);
+    if(decode_header(old_puller) != desc)
+      return encode<T>(u, desc);
+
+    const std::size_t px_len = static_cast<std::size_t>(desc.width) * desc.height;
+    const std::size_t dirty_begin = static_cast<std::size_t>(first) * desc.width;
+    const std::size_t dirty_end = first == desc.height ? px_len : static_cast<std::size_t>(last+1) * desc.width;
+
+    // the chunks of the clean leading rows are reusable up to the last one which doesn't belong to a pending run
+    chunk_reader<decltype(old_puller)> old{old_puller, previous_size - header_size};
+    std::size_t covered = 0, reused_px = 0, reused_size = 0;
+    bool synchronizable = false;
+    while(covered < dirty_begin){
+      const auto px = old.px;
+      covered += std::min(old.next(), px_len - covered);
+      synchronizable = old.px != px;
+      if(synchronizable && covered <= dirty_begin){
+        reused_px = covered;
+        reused_size = previous_size - header_size - old.size;
+      }
+    }
 
-    const auto max_size = static_cast<std::size_t>(desc.width) * desc.height * (desc.channels + 1) + header_size + sizeof(padding);
     using coT = container_operator<T>;
-    T data = coT::construct(max_size);
+    T data = coT::construct(header_size + reused_size + (px_len - reused_px) * (desc.channels + 1) + sizeof(padding));
     auto p = coT::create_pusher(data);
+    encode_header(p, desc);
+    {
+      auto reused = coV::create_puller(previous);
+      skip_bytes(reused, header_size);
+      copy_bytes(p, reused, reused_size);
+    }
+
+    encode_state state;
+    std::ranges::copy(old.index, state.index);
+    state.px = old.px;
+    if(reused_px > 0)
+      state.prev_hash = static_cast<std::uint8_t>(old.px.hash() % index_size);
     auto puller = coU::create_puller(u);
+    skip_bytes(puller, reused_px * desc.channels);
+    // only the chunks encoded here are counted, like the pixels; the reused ones were counted when they were encoded
+    [[maybe_unused]] const std::uint8_t* chunks = nullptr;
+    if constexpr(stats_enabled && coT::pusher::is_contiguous)
+      chunks = p.raw_pointer();
 
-    write_32(p, magic);
-    write_32(p, desc.width);
-    write_32(p, desc.height);
-    p.push(desc.channels);
-    p.push(static_cast<std::uint8_t>(desc.colorspace));
+    const auto encode_range = [&](std::size_t n){
+      if(desc.channels == 4)
+        encode_pixels<4>(p, puller, state, n);
+      else
+        encode_pixels<3>(p, puller, state, n);
+    };
+    encode_range(dirty_end - reused_px);
+
+    // after the dirty rows, the rest of the previous stream is reusable once both encoders are in the same state at a row boundary
+    for(auto boundary = dirty_end; boundary < px_len; boundary += desc.width){
+      while(covered < boundary){
+        const auto px = old.px;
+        covered += std::min(old.next(), px_len - covered);
+        synchronizable = old.px != px;
+      }
+      if(
+        covered == boundary && synchronizable && state.run == 0 && state.px == old.px &&
+        std::memcmp(state.index, old.index, sizeof(state.index)) == 0 &&
+        old.size <= (px_len - boundary) * (desc.channels + 1) + sizeof(padding)
+      ){
+        if constexpr(stats_enabled && coT::pusher::is_contiguous)
+          count_chunks(chunks, p.raw_pointer());
+        copy_bytes(p, old_puller, old.size);
+        return p.finalize();
+      }
+      encode_range(std::min<std::size_t>(desc.width, px_len - boundary));
+    }
+    push_run(p, state.run);
+    if constexpr(stats_enabled && coT::pusher::is_contiguous)
+      count_chunks(chunks, p.raw_pointer());
+
+    push<sizeof(padding)>(p, padding);
 
+    return p.finalize();
+  }
+  template<typename T, typename U>
+  requires (!std::is_pointer_v<U>)
+  static inline std::pair<T, desc> decode(const U& u, std::uint8_t channels = 0){
+    return decode_with<T>(u, channels, [](std::size_t size){return container_operator<T>::construct(size);});
+  }
+  template<typename T, typename U, typename Allocator>
+  requires (!std::is_pointer_v<U>) && detail::allocator_constructible<T, Allocator>
+  static inline std::pair<T, desc> decode(const U& u, std::uint8_t channels, const Allocator& alloc){
+    return decode_with<T>(u, channels, [&](std::size_t size){return container_operator<T>::construct(size, alloc);});
+  }
+  template<typename T, typename U>
+  requires(sizeof(U) == 1)
+  static inline std::pair<T, desc> decode(const U* pixels, std::size_t size, std::uint8_t channels = 0){
+    return decode<T>(std::make_pair(pixels, size), channels);
+  }
+  template<typename T, typename U, typename Allocator>
+  requires(sizeof(U) == 1) && detail::allocator_constructible<T, Allocator>
+  static inline std::pair<T, desc> decode(const U* pixels, std::size_t size, std::uint8_t channels, const Allocator& alloc){
+    return decode<T>(std::make_pair(pixels, size), channels, alloc);
+  }
+  // decodes the qoi+lz container written by encode_lz; the blocks are decompressed one at a time into the decoder
+  template<typename T, typename U>
+  requires (!std::is_pointer_v<U>)
+  static inline std::pair<T, desc> decode_lz(const U& u, std::uint8_t channels = 0){
+    using coU = container_operator<U>;
+    const auto size = coU::size(u);
+    if(!coU::valid(u) || size < sizeof(lz_magic) + sizeof(std::uint32_t) || channels > 4)[[unlikely]]
+      throw std::invalid_argument{"qoixx::qoi::decode_lz: invalid argument"};
+    lz_puller<typename coU::puller> puller{coU::create_puller(u), size};
+    // the blocks end the stream instead of the size
+    return decode_from<T>(puller, std::numeric_limits<std::size_t>::max(), channels, [](std::size_t size){return container_operator<T>::construct(size);});
+  }
+  template<typename T, typename U>
+  requires(sizeof(U) == 1)
+  static inline std::pair<T, desc> decode_lz(const U* pixels, std::size_t size, std::uint8_t channels = 0){
+    return decode_lz<T>(std::make_pair(pixels, size), channels);
+  }
+  // the SIMD instruction set of the encoder in this build
+  static constexpr const char* simd_backend()noexcept{
 #ifndef QOIXX_NO_SIMD
 #if defined(__ARM_FEATURE_SVE)
-    if constexpr(coT::pusher::is_contiguous && coU::puller::is_contiguous)
-      if(desc.channels == 4)
-#define QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH \
-        switch(svcntb()){ \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(128); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(256); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(384); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(512); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(640); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(768); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(896); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1024); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1152); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1280); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1408); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1536); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1664); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1792); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(1920); \
-          QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(2048); \
-          default: while(true){/*unreachable*/} \
-        }
-#define QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(i) case i/8: encode_sve<i, 4>(p, puller, desc); break
-        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH
-#undef QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE
-      else
-#define QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE(i) case i/8: encode_sve<i, 3>(p, puller, desc); break;
-        QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH
-#undef QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH_CASE
-#undef QOIXX_HPP_SVE_REGISTER_SIZE_SWITCH
-    else
+    return "SVE";
 #elif defined(__aarch64__)
-    if constexpr(coT::pusher::is_contiguous && coU::puller::is_contiguous)
-      if(desc.channels == 4)
-        encode_neon<4>(p, puller, desc);
-      else
-        encode_neon<3>(p, puller, desc);
-    else
+    return "NEON";
+#elif defined(__riscv_vector) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    return "RVV";
 #elif defined(__AVX2__)
-    if constexpr(coT::pusher::is_contiguous && coU::puller::is_contiguous)
-      if(desc.channels == 4)
-        encode_avx2<4>(p, puller, desc);
-      else
-        encode_avx2<3>(p, puller, desc);
-    else
+    return "AVX2";
+#elif defined(__SSE4_1__)
+    return "SSE4.1";
+#else
+    return "scalar";
 #endif
+#else
+    return "scalar (QOIXX_NO_SIMD)";
 #endif
-      if(desc.channels == 4)
-        encode_impl<4>(p, puller, desc);
-      else
-        encode_impl<3>(p, puller, desc);
+  }
+  static inline qoi::decoder get_decoder()noexcept{
+    return selected_decoder.load(std::memory_order_relaxed);
+  }
+  // decoder::automatic makes the next decode call calibrate_decoder()
+  static inline void set_decoder(qoi::decoder d)noexcept{
+    selected_decoder.store(d, std::memory_order_relaxed);
+  }
+  // decode outputs of at least this many bytes into a contiguous container are written with non-temporal stores; 0 streams every output
+  static inline std::size_t get_streaming_threshold()noexcept{
+    return streaming_threshold.load(std::memory_order_relaxed);
+  }
+  static inline void set_streaming_threshold(std::size_t bytes)noexcept{
+    streaming_threshold.store(bytes, std::memory_order_relaxed);
+  }
+  // returns the counters collected on the calling thread since the previous call and resets them; they stay zero without QOIXX_STATS
+  static inline stats take_stats()noexcept{
+    return std::exchange(thread_stats(), stats{});
+  }
+  // decodes a small synthetic stream with every decoder, selects the fastest one and returns it
+  static inline qoi::decoder calibrate_decoder(){
+    // the synthetic image is not part of the caller's statistics
+    const auto caller_stats = take_stats();
+    static constexpr std::uint32_t width = 256, height = 128;
+    static constexpr desc d = {width, height, 4, colorspace::srgb};
+    static constexpr std::size_t px_len = static_cast<std::size_t>(width)*height;
+    std::vector<std::uint8_t> pixels(px_len*d.channels);
+    // roughly the chunk mix of photographs and screenshots: runs, small and luma differences, and some literal pixels
+    std::uint32_t seed = 0x9e3779b9u;
+    rgba_t px = {0, 0, 0, 255};
+    for(std::size_t i = 0; i < px_len; ++i){
+      seed = seed * 1664525u + 1013904223u;
+      const auto r = seed >> 24;
+      if(r < 64){}
+      else if(r < 160){
+        px.r += (seed >>  8 & 3u) - 2;
+        px.g += (seed >> 10 & 3u) - 2;
+        px.b += (seed >> 12 & 3u) - 2;
+      }
+      else if(r < 240){
+        const auto dg = (seed >> 8 & 31u) - 16;
+        px.r += dg + (seed >> 13 & 7u) - 4;
+        px.g += dg;
+        px.b += dg + (seed >> 16 & 7u) - 4;
+      }
+      else{
+        px.r = static_cast<std::uint8_t>(seed >> 4);
+        px.g = static_cast<std::uint8_t>(seed >> 8);
+        px.b = static_cast<std::uint8_t>(seed >> 12);
+      }
+      std::memcpy(pixels.data() + i*d.channels, &px, d.channels);
+    }
+    const auto encoded = encode<std::vector<std::uint8_t>>(pixels, d);
+    auto with_tables = std::chrono::steady_clock::duration::max();
+    auto without_tables = with_tables;
+    auto dispatch = with_tables;
+    for(int i = 0; i < 5; ++i){
+      with_tables = std::min(with_tables, decode_time<qoi::decoder::tables>(encoded, pixels, px_len));
+      without_tables = std::min(without_tables, decode_time<qoi::decoder::arithmetic>(encoded, pixels, px_len));
+      dispatch = std::min(dispatch, decode_time<qoi::decoder::dispatch>(encoded, pixels, px_len));
+    }
+    auto result = with_tables <= without_tables ? qoi::decoder::tables : qoi::decoder::arithmetic;
+    if(dispatch < std::min(with_tables, without_tables))
+      result = qoi::decoder::dispatch;
+    set_decoder(result);
+    thread_stats() = caller_stats;
+    return result;
+  }
+  template<typename U, typename V>
+  requires (!std::is_pointer_v<U> && !std::is_pointer_v<V>)
+  static inline std::optional<std::size_t> compare(const U& a, const V& b){
+    using coU = container_operator<U>;
+    using coV = container_operator<V>;
+    const auto size_a = coU::size(a);
+    const auto size_b = coV::size(b);
+    if(!coU::valid(a) || !coV::valid(b) || size_a < header_size + sizeof(padding) || size_b < header_size + sizeof(padding))[[unlikely]]
+      throw std::invalid_argument{"qoixx::qoi::compare: invalid argument"};
+    auto puller_a = coU::create_puller(a);
+    auto puller_b = coV::create_puller(b);
+    const auto da = decode_header(puller_a);
+    const auto db = decode_header(puller_b);
+    if(da.width != db.width || da.height != db.height)
+      return 0;
 
-    return p.finalize();
+    const std::size_t px_len = static_cast<std::size_t>(da.width) * da.height;
+    chunk_reader<decltype(puller_a)> ra{puller_a, size_a - header_size};
+    chunk_reader<decltype(puller_b)> rb{puller_b, size_b - header_size};
+    ra.index[(0*3+0*5+0*7+255*11)%index_size] = ra.px;
+    rb.index[(0*3+0*5+0*7+255*11)%index_size] = rb.px;
+    std::size_t pos = 0;
+    if constexpr(coU::puller::is_contiguous && coV::puller::is_contiguous){
+      const auto n = std::min(ra.size, rb.size);
+      const auto m = mismatch(puller_a.raw_pointer(), puller_b.raw_pointer(), n);
+      if(m == n && ra.size == rb.size)
+        return std::nullopt;
+      static constexpr std::size_t max_chunk_size = 5;
+      const auto begin = ra.size;
+      while(pos < px_len && begin - ra.size + max_chunk_size <= m)
+        pos += std::min(ra.next(), px_len - pos);
+      const auto consumed = begin - ra.size;
+      puller_b.advance(consumed);
+      rb.size -= consumed;
+      rb.px = ra.px;
+      std::ranges::copy(ra.index, rb.index);
+    }
+    std::size_t na = 0, nb = 0;
+    while(pos < px_len){
+      if(na == 0)
+        na = std::min(ra.next(), px_len - pos);
+      if(nb == 0)
+        nb = std::min(rb.next(), px_len - pos);
+      if(ra.px != rb.px)
+        return pos;
+      const auto n = std::min(na, nb);
+      pos += n;
+      na -= n;
+      nb -= n;
+    }
+    return std::nullopt;
   }
-  template<typename T, typename U>
-  requires(sizeof(U) == 1)
-  static inline T encode(const U* pixels, std::size_t size, const desc& desc){
-    return encode<T>(std::make_pair(pixels, size), desc);
+  template<typename U, typename V>
+  requires(sizeof(U) == 1 && sizeof(V) == 1)
+  static inline std::optional<std::size_t> compare(const U* a, std::size_t size_a, const V* b, std::size_t size_b){
+    return compare(std::make_pair(a, size_a), std::make_pair(b, size_b));
   }
   template<typename T, typename U>
   requires (!std::is_pointer_v<U>)
-  static inline std::pair<T, desc> decode(const U& u, std::uint8_t channels = 0){
+  static inline std::pair<T, desc> decode_downscaled(const U& u, std::uint32_t scale, std::uint8_t channels = 0){
     using coU = container_operator<U>;
     const auto size = coU::size(u);
-    if(!coU::valid(u) || size < header_size + sizeof(padding) || (channels != 0 && channels != 3 && channels != 4))[[unlikely]]
-      throw std::invalid_argument{"qoixx::qoi::decode: invalid argument"};
+    if(!coU::valid(u) || size < header_size + sizeof(padding) || (channels != 0 && channels != 3 && channels != 4) || (scale != 2 && scale != 4 && scale != 8))[[unlikely]]
+      throw std::invalid_argument{"qoixx::qoi::decode_downscaled: invalid argument"};
+    using coT = container_operator<T>;
+    if constexpr(detail::planar_accessor<typename coT::pusher>){
+      if(channels != 0 && channels != coT::pusher::channels)[[unlikely]]
+        throw std::invalid_argument{"qoixx::qoi::decode_downscaled: invalid argument"};
+      channels = coT::pusher::channels;
+    }
     auto puller = coU::create_puller(u);
 
-    const auto d = decode_header(puller);
+    auto d = decode_header(puller);
     if(channels == 0)
       channels = d.channels;
 
     const std::size_t px_len = static_cast<std::size_t>(d.width) * d.height;
-    using coT = container_operator<T>;
-    T data = coT::construct(px_len*channels);
+    const auto shift = static_cast<std::uint32_t>(std::countr_zero(scale));
+    const desc scaled = {
+      .width = (d.width + scale - 1) >> shift,
+      .height = (d.height + scale - 1) >> shift,
+      .channels = d.channels,
+      .colorspace = d.colorspace,
+    };
+    T data = coT::construct(static_cast<std::size_t>(scaled.width)*scaled.height*channels);
     auto p = coT::create_pusher(data);
 
-    if(channels == 4)
-      decode_impl<4>(p, puller, px_len, size);
-    else
-      decode_impl<3>(p, puller, px_len, size);
+    if(channels == 4){
+      downscale_pusher<4, decltype(p)> ds{p, d.width, shift};
+      decode_selected<4>(ds, puller, px_len, size);
+      ds.flush();
+    }
+    else{
+      downscale_pusher<3, decltype(p)> ds{p, d.width, shift};
+      decode_selected<3>(ds, puller, px_len, size);
+      ds.flush();
+    }
 
-    return std::make_pair(std::move(p.finalize()), d);
+    return std::make_pair(std::move(p.finalize()), scaled);
   }
   template<typename T, typename U>
   requires(sizeof(U) == 1)
-  static inline std::pair<T, desc> decode(const U* pixels, std::size_t size, std::uint8_t channels = 0){
-    return decode<T>(std::make_pair(pixels, size), channels);
+  static inline std::pair<T, desc> decode_downscaled(const U* pixels, std::size_t size, std::uint32_t scale, std::uint8_t channels = 0){
+    return decode_downscaled<T>(std::make_pair(pixels, size), scale, channels);
+  }
+  // encode and decode in constant evaluation, so that assets are embedded without any decoding at startup, e.g.
+  //   static constexpr std::array<std::uint8_t, 16*16*4> icon_pixels = {...};
+  //   static constexpr auto icon = qoi::static_encode<icon_pixels, qoi::desc{16, 16, 4, qoi::colorspace::srgb}>();
+  //   static constexpr auto decoded = qoi::static_decode<icon>(); // std::pair<std::array<std::uint8_t, 16*16*4>, qoi::desc>
+  // the arguments refer to constexpr byte arrays (std::array or built-in arrays) with static storage duration,
+  // and the results are std::arrays of the exact size; the bytes are the same as those of encode and decode
+  template<const auto& Pixels, desc Desc>
+  static constexpr auto static_encode(){
+    std::array<std::uint8_t, static_encoded_size(Pixels, Desc)> data = {};
+    std::size_t size = 0;
+    static_encode_to(Pixels, Desc, [&data, &size](std::uint8_t x){data[size++] = x;});
+    return data;
   }
+  template<const auto& Qoi, std::uint8_t Channels = 0>
+  requires(Channels <= 4)
+  static constexpr auto static_decode(){
+    constexpr auto d = static_decode_header(Qoi);
+    constexpr std::size_t px_len = static_cast<std::size_t>(d.width) * d.height;
+    constexpr std::uint8_t channels = Channels == 0 ? d.channels : Channels;
+    std::array<std::uint8_t, px_len*channels> data = {};
+    static_decode_to(data, Qoi, px_len, channels);
+    return std::make_pair(data, d);
+  }
+ private:
+  // a buffer owned by frame_encoder / frame_decoder; grows to the largest frame and is never shrunk
+  class frame_buffer{
+    std::unique_ptr<std::uint8_t[]> buffer;
+    std::size_t capacity = 0;
+   public:
+    struct pusher{
+      static constexpr bool is_contiguous = true;
+      std::uint8_t* p;
+      std::size_t i = 0;
+      inline void push(std::uint8_t x)noexcept{
+        p[i++] = x;
+      }
+      template<typename U>
+      requires std::unsigned_integral<U> && (sizeof(U) != 1)
+      inline void push(U t)noexcept{
+        this->push(static_cast<std::uint8_t>(t));
+      }
+      inline std::uint8_t* raw_pointer()noexcept{
+        return p+i;
+      }
+      inline void advance(std::size_t n)noexcept{
+        i += n;
+      }
+    };
+    inline void reserve(std::size_t size){
+      if(size > capacity){
+        buffer = std::make_unique_for_overwrite<std::uint8_t[]>(size);
+        capacity = size;
+      }
+    }
+    inline pusher create_pusher(std::size_t size){
+      reserve(size);
+      return {buffer.get()};
+    }
+    inline std::uint8_t* data()noexcept{
+      return buffer.get();
+    }
+  };
+ public:
+  // encodes repeated frames into an owned buffer, which is reused while the frames fit in it
+  class frame_encoder{
+    frame_buffer buffer;
+   public:
+    frame_encoder() = default;
+    explicit frame_encoder(const desc& desc){
+      reserve(desc);
+    }
+    inline void reserve(const desc& desc){
+      buffer.reserve(max_encoded_size(desc));
+    }
+    // the returned span is valid until the next encode call
+    template<typename U>
+    inline std::span<const std::uint8_t> encode(const U& u, const desc& desc){
+      check_encode_argument(u, desc, 1);
+      auto p = buffer.create_pusher(max_encoded_size(desc));
+      encode_to(p, u, desc);
+      return {p.p, p.i};
+    }
+    template<typename U>
+    requires(sizeof(U) == 1)
+    inline std::span<const std::uint8_t> encode(const U* pixels, std::size_t size, const desc& desc){
+      return encode(std::make_pair(pixels, size), desc);
+    }
+  };
+  // decodes repeated frames into an owned buffer, which is reused while the frames fit in it
+  class frame_decoder{
+    frame_buffer buffer;
+   public:
+    frame_decoder() = default;
+    explicit frame_decoder(const desc& desc, std::uint8_t channels = 0){
+      reserve(desc, channels);
+    }
+    inline void reserve(const desc& desc, std::uint8_t channels = 0){
+      buffer.reserve(static_cast<std::size_t>(desc.width) * desc.height * (channels == 0 ? desc.channels : channels));
+    }
+    // the returned span is valid until the next decode call
+    template<typename U>
+    requires (!std::is_pointer_v<U>)
+    inline std::pair<std::span<std::uint8_t>, desc> decode(const U& u, std::uint8_t channels = 0){
+      using coU = container_operator<U>;
+      check_decode_argument(u, channels);
+      auto puller = coU::create_puller(u);
+      const auto d = decode_header(puller);
+      if(channels == 0)
+        channels = d.channels;
+      const std::size_t px_len = static_cast<std::size_t>(d.width) * d.height;
+      auto p = buffer.create_pusher(px_len*channels);
+      decode_to(p, puller, px_len, coU::size(u), channels);
+      return std::make_pair(std::span<std::uint8_t>{p.p, p.i}, d);
+    }
+    template<typename U>
+    requires(sizeof(U) == 1)
+    inline std::pair<std::span<std::uint8_t>, desc> decode(const U* pixels, std::size_t size, std::uint8_t channels = 0){
+      return decode(std::make_pair(pixels, size), channels);
+    }
+  };
+  // encodes and decodes Width x Height tiles into caller-provided buffers, with the size fixed at compile time:
+  // the header is a constant, the output bound is known to size the buffers, and the SIMD encoders run a constant number of blocks
+  // (without any tail when Width*Height is a multiple of their lanes); nothing is allocated
+  template<std::uint32_t Width, std::uint32_t Height, std::uint8_t Channels, qoi::colorspace Colorspace = qoi::colorspace::srgb>
+  requires(Width > 0 && Height > 0 && Channels >= 1 && Channels <= 4 && Height < pixels_max / Width)
+  class tile_codec{
+    static constexpr std::size_t px_len = static_cast<std::size_t>(Width) * Height;
+    static constexpr std::array<std::uint8_t, header_size> create_header(){
+      std::array<std::uint8_t, header_size> header = {};
+      std::size_t i = 0;
+      for(auto x : {magic, Width, Height})
+        for(int shift = 24; shift >= 0; shift -= 8)
+          header[i++] = static_cast<std::uint8_t>(x >> shift);
+      header[i++] = stream_channels(Channels);
+      header[i++] = static_cast<std::uint8_t>(Colorspace);
+      return header;
+    }
+    static constexpr auto header = create_header();
+   public:
+    static constexpr qoi::desc tile_desc = {Width, Height, Channels, Colorspace};
+    static constexpr std::size_t max_encoded_size = qoi::max_encoded_size(tile_desc);
+    static constexpr std::size_t pixels_size = px_len * Channels;
+    // returns the size of the encoded tile, written to the front of out
+    template<typename U>
+    static inline std::size_t encode(const U& u, std::span<std::uint8_t, max_encoded_size> out){
+      using coU = container_operator<U>;
+      if constexpr(detail::planar_accessor<typename coU::puller>)
+        static_assert(coU::puller::channels == Channels, "qoixx::qoi::tile_codec::encode: the number of planes differs from Channels");
+      if(!coU::valid(u) || coU::size(u) < pixels_size)[[unlikely]]
+        throw std::invalid_argument{"qoixx::qoi::tile_codec::encode: invalid argument"};
+      std::memcpy(out.data(), header.data(), header_size);
+      frame_buffer::pusher p{out.data(), header_size};
+      auto puller = coU::create_puller(u);
+      encode_state state;
+      encode_pixels(p, puller, state, std::integral_constant<std::size_t, px_len>{}, Channels);
+      push_run(p, state.run);
+      count_chunks(out.data() + header_size, p.raw_pointer());
+      push<sizeof(padding)>(p, padding);
+      return p.i;
+    }
+    template<typename U>
+    requires(sizeof(U) == 1)
+    static inline std::size_t encode(const U* pixels, std::span<std::uint8_t, max_encoded_size> out){
+      return encode(std::make_pair(pixels, pixels_size), out);
+    }
+    // the stream must be a Width x Height image; its pixels are written to out with Channels channels
+    template<typename U>
+    requires (!std::is_pointer_v<U>)
+    static inline void decode(const U& u, std::span<std::uint8_t, pixels_size> out){
+      using coU = container_operator<U>;
+      check_decode_argument(u, Channels);
+      auto puller = coU::create_puller(u);
+      const auto d = decode_header(puller);
+      if(d.width != Width || d.height != Height)[[unlikely]]
+        throw std::runtime_error("qoixx::qoi::tile_codec::decode: the image is not a tile of this size");
+      frame_buffer::pusher p{out.data()};
+      decode_channels(p, puller, px_len, coU::size(u), Channels);
+    }
+    template<typename U>
+    requires(sizeof(U) == 1)
+    static inline void decode(const U* qoi, std::size_t size, std::span<std::uint8_t, pixels_size> out){
+      decode(std::make_pair(qoi, size), out);
+    }
+  };
+ private:
+  // multi-frame container: the magic "qoim" and a plain QOI header describing every frame, then the frames
+  // every frame starts with a big endian 32 bit word: the size of its chunks (including the end padding), with the top bit set for a keyframe
+  // a keyframe holds the QOI chunks of its pixels, any other frame those of its XOR with the previous frame,
+  // in which the unchanged pixels are zeros and collapse into runs
+  static constexpr std::uint32_t sequence_magic =
+    113u /*q*/ << 24 | 111u /*o*/ << 16 | 105u /*i*/ <<  8 | 109u /*m*/ ;
+  static constexpr std::uint32_t sequence_keyframe_flag = 0x8000'0000u;
+ public:
+  // encodes a sequence of frames of the same desc, e.g. a screen capture
+  // write header() once, then the data returned by every encode call
+  class sequence_encoder{
+    qoi::desc d;
+    std::size_t keyframe_interval;
+    std::size_t count = 0;
+    std::unique_ptr<std::uint8_t[]> previous;
+    frame_buffer buffer;
+    std::uint8_t header_[sizeof(sequence_magic) + header_size];
+   public:
+    // every keyframe_interval-th frame is a keyframe, from which a decoder can start
+    explicit sequence_encoder(const qoi::desc& desc, std::size_t keyframe_interval = 60):d{desc}, keyframe_interval{keyframe_interval}{
+      if(desc.width == 0 || desc.height == 0 || desc.channels < 3 || desc.channels > 4 || desc.height >= pixels_max / desc.width || keyframe_interval == 0 || max_encoded_size(desc) >= sequence_keyframe_flag)[[unlikely]]
+        throw std::invalid_argument{"qoixx::qoi::sequence_encoder: invalid argument"};
+      previous = std::make_unique_for_overwrite<std::uint8_t[]>(static_cast<std::size_t>(desc.width) * desc.height * desc.channels);
+      buffer.reserve(sizeof(std::uint32_t) + max_encoded_size(desc));
+      typename frame_buffer::pusher p{header_};
+      write_32(p, sequence_magic);
+      encode_header(p, desc);
+    }
+    inline const qoi::desc& description()const noexcept{
+      return d;
+    }
+    inline std::span<const std::uint8_t> header()const noexcept{
+      return header_;
+    }
+    // makes the next frame a keyframe, e.g. at a scene change
+    inline void request_keyframe()noexcept{
+      count = 0;
+    }
+    // the returned span is valid until the next encode call
+    template<typename U>
+    inline std::span<const std::uint8_t> encode(const U& u){
+      using coU = container_operator<U>;
+      static_assert(coU::puller::is_contiguous, "qoixx::qoi::sequence_encoder: frames must be contiguous pixels");
+      check_encode_argument(u, d);
+      const std::size_t px_len = static_cast<std::size_t>(d.width) * d.height;
+      const auto* pixels = reinterpret_cast<const std::uint8_t*>(coU::create_puller(u).raw_pointer());
+      const bool keyframe = count++ % keyframe_interval == 0;
+      auto p = buffer.create_pusher(sizeof(std::uint32_t) + max_encoded_size(d));
+      p.advance(sizeof(std::uint32_t));
+      encode_state state;
+      const auto encode_frame = [&](auto& puller){
+        if(d.channels == 4)
+          encode_pixels<4>(p, puller, state, px_len);
+        else
+          encode_pixels<3>(p, puller, state, px_len);
+      };
+      if(keyframe){
+        detail::contiguous_puller<std::uint8_t> puller{pixels};
+        encode_frame(puller);
+      }
+      else{
+        detail::delta_puller puller{pixels, previous.get()};
+        encode_frame(puller);
+      }
+      push_run(p, state.run);
+      count_chunks(p.p + sizeof(std::uint32_t), p.raw_pointer());
+      push<sizeof(padding)>(p, padding);
+      std::memcpy(previous.get(), pixels, px_len*d.channels);
+      typename frame_buffer::pusher w{p.p};
+      write_32(w, static_cast<std::uint32_t>(p.i - sizeof(std::uint32_t)) | (keyframe ? sequence_keyframe_flag : 0u));
+      return {p.p, p.i};
+    }
+    template<typename U>
+    requires(sizeof(U) == 1)
+    inline std::span<const std::uint8_t> encode(const U* pixels, std::size_t size){
+      return encode(std::make_pair(pixels, size));
+    }
+  };
+  // decodes the frames of a sequence_encoder stream with random access; the frames keep the channels of the stream
+  // the data is referenced, not copied, so it has to outlive the decoder
+  class sequence_decoder{
+    const std::uint8_t* data;
+    qoi::desc d;
+    std::vector<std::size_t> offsets;
+    frame_buffer buffer;
+    std::size_t current;
+    inline std::uint32_t frame_word(std::size_t i)const noexcept{
+      detail::contiguous_puller<std::uint8_t> p{data + offsets[i]};
+      return read_32(p);
+    }
+    inline void decode_frame(std::size_t i){
+      const auto word = frame_word(i);
+      detail::contiguous_puller<std::uint8_t> puller{data + offsets[i] + sizeof(std::uint32_t)};
+      const std::size_t px_len = static_cast<std::size_t>(d.width) * d.height;
+      const std::size_t size = word & ~sequence_keyframe_flag;
+      const auto decode_chunks = [&](auto& p){
+        if(d.channels == 4)
+          decode_selected<4>(p, puller, px_len, size);
+        else
+          decode_selected<3>(p, puller, px_len, size);
+      };
+      auto p = buffer.create_pusher(px_len*d.channels);
+      if(word & sequence_keyframe_flag)
+        decode_chunks(p);
+      else{
+        detail::delta_pusher dp{p.p};
+        decode_chunks(dp);
+      }
+    }
+   public:
+    template<typename U>
+    requires (!std::is_pointer_v<U>)
+    explicit sequence_decoder(const U& u){
+      using coU = container_operator<U>;
+      static_assert(coU::puller::is_contiguous, "qoixx::qoi::sequence_decoder: the stream must be contiguous");
+      const std::size_t size = coU::size(u);
+      if(!coU::valid(u) || size < sizeof(sequence_magic) + header_size)[[unlikely]]
+        throw std::invalid_argument{"qoixx::qoi::sequence_decoder: invalid argument"};
+      data = reinterpret_cast<const std::uint8_t*>(coU::create_puller(u).raw_pointer());
+      detail::contiguous_puller<std::uint8_t> puller{data};
+      if(read_32(puller) != sequence_magic)[[unlikely]]
+        throw std::runtime_error("qoixx::qoi::sequence_decoder: invalid header");
+      d = decode_header(puller);
+      for(std::size_t pos = sizeof(sequence_magic) + header_size; pos < size;){
+        if(size - pos < sizeof(std::uint32_t))[[unlikely]]
+          throw std::runtime_error("qoixx::qoi::sequence_decoder: insufficient input data");
+        offsets.push_back(pos);
+        const auto word = frame_word(offsets.size()-1);
+        const std::size_t n = word & ~sequence_keyframe_flag;
+        if(n > size - pos - sizeof(std::uint32_t) || (offsets.size() == 1 && !(word & sequence_keyframe_flag)))[[unlikely]]
+          throw std::runtime_error("qoixx::qoi::sequence_decoder: invalid frame");
+        pos += sizeof(std::uint32_t) + n;
+      }
+      current = offsets.size();
+    }
+    template<typename U>
+    requires(sizeof(U) == 1)
+    sequence_decoder(const U* data, std::size_t size):sequence_decoder(std::make_pair(data, size)){}
+    inline const qoi::desc& description()const noexcept{
+      return d;
+    }
+    inline std::size_t frame_count()const noexcept{
+      return offsets.size();
+    }
+    inline bool is_keyframe(std::size_t i)const noexcept{
+      return (frame_word(i) & sequence_keyframe_flag) != 0;
+    }
+    // decodes from the closest keyframe at or before i, or from the last decoded frame when that is closer
+    // the returned span is valid until the next decode call
+    inline std::span<const std::uint8_t> decode(std::size_t i){
+      if(i >= offsets.size())[[unlikely]]
+        throw std::invalid_argument{"qoixx::qoi::sequence_decoder::decode: invalid argument"};
+      std::size_t from = i;
+      while(!is_keyframe(from))
+        --from;
+      if(current < offsets.size() && from <= current && current <= i)
+        from = current + 1;
+      current = offsets.size();
+      for(auto f = from; f <= i; ++f)
+        decode_frame(f);
+      current = i;
+      return {buffer.data(), static_cast<std::size_t>(d.width) * d.height * d.channels};
+    }
+  };
 };
 
 }
@@ -45,6 +45,22 @@
 #include<utility>
 #include<cstdint>
 #include<iomanip>
+#include<optional>
+#include<array>
+#include<thread>
+#include<string>
+#include<fstream>
+#include<iterator>
+#include<algorithm>
+#include<cmath>
+#include<cctype>
+#include<functional>
+#if defined(__linux__)
+#include<linux/perf_event.h>
+#include<sys/ioctl.h>
+#include<sys/syscall.h>
+#include<unistd.h>
+#endif
 
 struct options{
   bool warmup = true;
@@ -54,6 +70,11 @@ struct options{
   bool decode = true;
   bool recurse = true;
   bool only_totals = false;
+  std::optional<qoixx::qoi::decoder> decoder;
+  bool branch_misses = false;
+  bool stats = false;
+  unsigned instances = 1;
+  std::optional<std::size_t> streaming_threshold;
   unsigned runs;
   bool parse_option(std::string_view argv){
     if(argv == "--nowarmup")
@@ -70,23 +91,112 @@ struct options{
       this->recurse = false;
     else if(argv == "--onlytotals")
       this->only_totals = true;
+    else if(argv == "--decoder=tables")
+      this->decoder = qoixx::qoi::decoder::tables;
+    else if(argv == "--decoder=arithmetic")
+      this->decoder = qoixx::qoi::decoder::arithmetic;
+    else if(argv == "--decoder=dispatch")
+      this->decoder = qoixx::qoi::decoder::dispatch;
+    else if(argv == "--decoder=auto")
+      this->decoder = qoixx::qoi::decoder::automatic;
+    else if(argv == "--branchmisses")
+      this->branch_misses = true;
+    else if(argv == "--stats")
+      this->stats = true;
+    else if(argv.starts_with("--instances=")){
+      const auto n = std::stoi(std::string{argv.substr(sizeof("--instances=")-1)});
+      if(n <= 0)
+        return false;
+      this->instances = static_cast<unsigned>(n);
+    }
+    else if(argv.starts_with("--streaming="))
+      this->streaming_threshold = std::stoull(std::string{argv.substr(sizeof("--streaming=")-1)});
     else
       return false;
     return true;
   }
 };
 
+// counts the branch misses of the calling thread with perf_event_open(2); unavailable on other platforms or without a PMU
+class branch_miss_counter{
+  int fd = -1;
+ public:
+  branch_miss_counter(){
+#if defined(__linux__)
+    ::perf_event_attr attr = {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+  branch_miss_counter(const branch_miss_counter&) = delete;
+  branch_miss_counter& operator=(const branch_miss_counter&) = delete;
+  ~branch_miss_counter(){
+#if defined(__linux__)
+    if(fd >= 0)
+      ::close(fd);
+#endif
+  }
+  explicit operator bool()const noexcept{
+    return fd >= 0;
+  }
+  void start()noexcept{
+#if defined(__linux__)
+    ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+  std::uint64_t stop()noexcept{
+    std::uint64_t count = 0;
+#if defined(__linux__)
+    ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if(::read(fd, &count, sizeof(count)) != sizeof(count))
+      count = 0;
+#endif
+    return count;
+  }
+  static branch_miss_counter& instance(){
+    static branch_miss_counter counter;
+    return counter;
+  }
+};
+
+static inline void accumulate(qoixx::qoi::stats& lhs, const qoixx::qoi::stats& rhs)noexcept{
+  lhs.index += rhs.index;
+  lhs.diff += rhs.diff;
+  lhs.luma += rhs.luma;
+  lhs.run += rhs.run;
+  lhs.rgb += rhs.rgb;
+  lhs.rgba += rhs.rgba;
+  for(std::size_t i = 0; i < lhs.run_lengths.size(); ++i)
+    lhs.run_lengths[i] += rhs.run_lengths[i];
+  lhs.simd_pixels += rhs.simd_pixels;
+  lhs.scalar_pixels += rhs.scalar_pixels;
+  lhs.simd_blocks += rhs.simd_blocks;
+  lhs.run_blocks += rhs.run_blocks;
+}
+
+static constexpr std::array<qoixx::qoi::decoder, 3> decoders = {qoixx::qoi::decoder::arithmetic, qoixx::qoi::decoder::tables, qoixx::qoi::decoder::dispatch};
+static constexpr std::array<const char*, 3> decoder_names = {"arithmetic", "tables", "dispatch"};
+
 struct benchmark_result_t{
   struct lib_t{
     std::size_t size;
     std::chrono::duration<double, std::nano> encode_time;
     std::chrono::duration<double, std::nano> decode_time;
   };
+  std::chrono::duration<double, std::nano> qoixx_instances_decode_time = {};
   std::size_t count;
   std::size_t raw_size, px;
   std::uint32_t w, h;
   std::uint8_t c;
   lib_t qoi, qoixx;
+  std::array<std::uint64_t, decoders.size()> decode_branch_misses = {};
+  qoixx::qoi::stats encode_stats = {}, decode_stats = {};
   benchmark_result_t():count{0}, raw_size{0}, px{0}, qoi{0, {}, {}}, qoixx{0, {}, {}}{}
   benchmark_result_t(const qoixx::qoi::desc& dc):count{1}, raw_size{static_cast<std::size_t>(dc.width)*dc.height*dc.channels}, px{static_cast<std::size_t>(dc.width)*dc.height}, w{dc.width}, h{dc.height}, c{dc.channels}, qoi{}, qoixx{}{}
   benchmark_result_t& operator+=(const benchmark_result_t& rhs)noexcept{
@@ -99,6 +209,11 @@ struct benchmark_result_t{
     this->qoixx.size += rhs.qoixx.size;
     this->qoixx.encode_time += rhs.qoixx.encode_time;
     this->qoixx.decode_time += rhs.qoixx.decode_time;
+    this->qoixx_instances_decode_time += rhs.qoixx_instances_decode_time;
+    for(std::size_t i = 0; i < decoders.size(); ++i)
+      this->decode_branch_misses[i] += rhs.decode_branch_misses[i];
+    accumulate(this->encode_stats, rhs.encode_stats);
+    accumulate(this->decode_stats, rhs.decode_stats);
     return *this;
   }
   struct printer{
@@ -114,6 +229,24 @@ struct benchmark_result_t{
         return os;
       }
     };
+    static void print_stats(std::ostream& os, const char* label, const qoixx::qoi::stats& st){
+      const auto chunks = static_cast<double>(st.index + st.diff + st.luma + st.run + st.rgb + st.rgba);
+      const auto percent = [&](std::uint64_t x, double total){
+        return total != 0. ? static_cast<double>(x) / total * 100. : 0.;
+      };
+      os << label << " chunks %:  index " << manip{0, 1} << percent(st.index, chunks) << "  diff " << percent(st.diff, chunks) << "  luma " << percent(st.luma, chunks) << "  run " << percent(st.run, chunks) << "  rgb " << percent(st.rgb, chunks) << "  rgba " << percent(st.rgba, chunks) << '\n';
+      // runs of 1, 2-3, 4-7, 8-15, 16-31 and 32-62 pixels
+      std::uint64_t run_px = 0;
+      std::array<std::uint64_t, 6> buckets = {};
+      for(std::size_t i = 0; i < st.run_lengths.size(); ++i){
+        run_px += st.run_lengths[i] * (i+1);
+        buckets[static_cast<std::size_t>(std::bit_width(i+1))-1] += st.run_lengths[i];
+      }
+      const auto runs = static_cast<double>(st.run);
+      os << label << " runs:  mean " << manip{0, 2} << (st.run != 0 ? static_cast<double>(run_px) / runs : 0.) << " px, % by length  1 " << manip{0, 1} << percent(buckets[0], runs) << "  2-3 " << percent(buckets[1], runs) << "  4-7 " << percent(buckets[2], runs) << "  8-15 " << percent(buckets[3], runs) << "  16-31 " << percent(buckets[4], runs) << "  32-62 " << percent(buckets[5], runs) << '\n';
+      if(st.simd_pixels + st.scalar_pixels != 0)
+        os << label << " pixels:  simd " << manip{0, 1} << percent(st.simd_pixels, static_cast<double>(st.simd_pixels + st.scalar_pixels)) << "%  all-run blocks skipped " << percent(st.run_blocks, static_cast<double>(st.simd_blocks)) << "% of " << st.simd_blocks << '\n';
+    }
     friend std::ostream& operator<<(std::ostream& os, const printer& printer){
       const auto& res = *printer.result;
       const auto px = static_cast<double>(res.px) / res.count;
@@ -132,6 +265,23 @@ struct benchmark_result_t{
       if(printer.opt->reference)
         os << "qoi:     " << manip{8, 4} << qoi_dtime.count() << "    " << manip{8, 4} << qoi_etime.count() << "      " << manip{8, 3} << qoi_dmpps << "      " << manip{8, 3} << qoi_empps << "  " << manip{8} << qoi_size/1024 << "   " << manip{4, 1} << static_cast<double>(qoi_size)/raw_size*100. << "%\n";
       os << "qoixx:   " << manip{8, 4} << qoixx_dtime.count() << "    " << manip{8, 4} << qoixx_etime.count() << "      " << manip{8, 3} << qoixx_dmpps << "      " << manip{8, 3} << qoixx_empps << "  " << manip{8} << qoixx_size/1024 << "   " << manip{4, 1} << static_cast<double>(qoixx_size)/raw_size*100. << "%\n";
+      if(printer.opt->instances > 1 && printer.opt->decode){
+        const auto itime = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(res.qoixx_instances_decode_time) / res.count;
+        const auto label = "qoixx x" + std::to_string(printer.opt->instances) + ':';
+        os << label << std::string(label.size() < 9 ? 9 - label.size() : 1, ' ') << manip{8, 4} << itime.count() << "                  " << manip{8, 3} << px * printer.opt->instances / std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(itime).count() << " (aggregate)\n";
+      }
+      if(printer.opt->branch_misses && printer.opt->decode){
+        os << "qoixx decode branch misses/px:";
+        for(std::size_t i = 0; i < decoders.size(); ++i)
+          os << "  " << decoder_names[i] << ' ' << manip{0, 4} << static_cast<double>(res.decode_branch_misses[i])/static_cast<double>(res.px);
+        os << '\n';
+      }
+      if(printer.opt->stats){
+        if(printer.opt->encode)
+          print_stats(os, "qoixx encode", res.encode_stats);
+        if(printer.opt->decode)
+          print_stats(os, "qoixx decode", res.decode_stats);
+      }
       return os;
     }
   };
@@ -190,6 +340,8 @@ static inline benchmark_result_t benchmark_image(const std::filesystem::path& p,
       const auto [pixs, desc] = qoixx::qoi::decode<std::vector<std::uint8_t>>(qoi.get(), size);
       if(desc != qoixx_desc || std::memcmp(pixels.get(), pixs.data(), desc.width*desc.height*desc.channels) != 0)
         throw std::runtime_error("QOIxx decoder pixel mismatch for " + p.string());
+      if(qoixx::qoi::compare(qoi.get(), static_cast<std::size_t>(size), encoded_qoixx.first.get(), encoded_qoixx.second))
+        throw std::runtime_error("QOIxx compare mismatch for " + p.string());
     }
     {// qoixx.encode -> qoi.decode == pixels
       ::qoi_desc dc;
@@ -214,6 +366,37 @@ static inline benchmark_result_t benchmark_image(const std::filesystem::path& p,
     BENCHMARK(opt, result.qoixx.decode_time,
       const auto [pixs, desc] = qoixx::qoi::decode<std::pair<std::unique_ptr<std::uint8_t[]>, std::size_t>>(encoded_qoixx);
     );
+    if(opt.instances > 1){
+      // every instance decodes the image opt.runs times at once; the wall time covers the slowest one
+      const auto start = std::chrono::high_resolution_clock::now();
+      {
+        std::vector<std::jthread> workers;
+        workers.reserve(opt.instances);
+        for(unsigned n = 0; n < opt.instances; ++n)
+          workers.emplace_back([&]{
+            for(unsigned i = 0; i < opt.runs; ++i)
+              const auto [pixs, desc] = qoixx::qoi::decode<std::pair<std::unique_ptr<std::uint8_t[]>, std::size_t>>(encoded_qoixx);
+          });
+      }
+      const auto end = std::chrono::high_resolution_clock::now();
+      result.qoixx_instances_decode_time = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(end - start)/opt.runs;
+    }
+    if(opt.branch_misses){
+      const auto selected = qoixx::qoi::get_decoder();
+      auto& counter = branch_miss_counter::instance();
+      for(std::size_t i = 0; i < decoders.size(); ++i){
+        qoixx::qoi::set_decoder(decoders[i]);
+        counter.start();
+        const auto [pixs, desc] = qoixx::qoi::decode<std::pair<std::unique_ptr<std::uint8_t[]>, std::size_t>>(encoded_qoixx);
+        result.decode_branch_misses[i] = counter.stop();
+      }
+      qoixx::qoi::set_decoder(selected);
+    }
+    if(opt.stats){
+      qoixx::qoi::take_stats();
+      const auto [pixs, desc] = qoixx::qoi::decode<std::pair<std::unique_ptr<std::uint8_t[]>, std::size_t>>(encoded_qoixx);
+      result.decode_stats = qoixx::qoi::take_stats();
+    }
   }
 
   if(opt.encode){
@@ -227,6 +410,11 @@ static inline benchmark_result_t benchmark_image(const std::filesystem::path& p,
       const auto encoded_qoixx = qoixx::qoi::encode<std::pair<std::unique_ptr<std::uint8_t[]>, std::size_t>>(pixels.get(), raw_size, qoixx_desc);
       result.qoixx.size = encoded_qoixx.second;
     );
+    if(opt.stats){
+      qoixx::qoi::take_stats();
+      const auto encoded_qoixx = qoixx::qoi::encode<std::pair<std::unique_ptr<std::uint8_t[]>, std::size_t>>(pixels.get(), raw_size, qoixx_desc);
+      result.encode_stats = qoixx::qoi::take_stats();
+    }
   }
 
   return result;
@@ -266,6 +454,371 @@ static inline benchmark_result_t benchmark_directory(const std::filesystem::path
   return results;
 }
 
+// perfcheck: a fixed synthetic corpus, timed for the encoder and each decoder and compared with a stored baseline
+namespace perf{
+
+static constexpr const char* backend = qoixx::qoi::simd_backend();
+static constexpr const char* compiler =
+#if defined(__VERSION__)
+  __VERSION__;
+#else
+  "unknown";
+#endif
+
+struct image{
+  std::string name;
+  qoixx::qoi::desc desc;
+  std::vector<std::uint8_t> pixels;
+};
+
+// deterministic stand-ins for the usual inputs: photographs (with and without alpha), screenshots, gradients, noise and flat images
+static std::vector<image> corpus(){
+  static constexpr std::uint32_t w = 512, h = 512;
+  std::uint32_t seed = 0x2545f491u;
+  const auto random = [&]{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+  };
+  const auto make = [&](std::string name, std::uint8_t channels, auto&& pixel){
+    image img{std::move(name), {w, h, channels, qoixx::qoi::colorspace::srgb}, std::vector<std::uint8_t>(static_cast<std::size_t>(w)*h*channels)};
+    for(std::uint32_t y = 0; y < h; ++y)
+      for(std::uint32_t x = 0; x < w; ++x){
+        const std::array<std::uint8_t, 4> px = pixel(img.pixels.data(), x, y);
+        std::memcpy(img.pixels.data() + (static_cast<std::size_t>(y)*w + x)*channels, px.data(), channels);
+      }
+    return img;
+  };
+  const auto smooth = [&](std::uint8_t channels){
+    return [&random, channels](const std::uint8_t* data, std::uint32_t x, std::uint32_t y){
+      std::array<std::uint8_t, 4> px = {128, 128, 128, 255};
+      for(std::uint8_t c = 0; c < channels; ++c){
+        const int left = x > 0 ? data[(static_cast<std::size_t>(y)*w + x-1)*channels + c] : 128;
+        const int up = y > 0 ? data[(static_cast<std::size_t>(y-1)*w + x)*channels + c] : left;
+        const auto r = random();
+        const int noise = c == 3 ? ((r & 255u) < 250 ? 0 : static_cast<int>(r >> 8 & 15u) - 8) : static_cast<int>(r % 9u) - 4;
+        px[c] = static_cast<std::uint8_t>(std::clamp((left + up + 1) / 2 + noise, 0, 255));
+      }
+      return px;
+    };
+  };
+  std::vector<image> images;
+  images.push_back(make("photo", 3, smooth(3)));
+  images.push_back(make("photo-alpha", 4, smooth(4)));
+  images.push_back(make("screenshot", 4, [](const std::uint8_t*, std::uint32_t x, std::uint32_t y)->std::array<std::uint8_t, 4>{
+    static constexpr std::array<std::array<std::uint8_t, 4>, 4> palette = {{{240, 240, 240, 255}, {32, 96, 160, 255}, {255, 255, 255, 255}, {60, 60, 60, 255}}};
+    const auto& bg = palette[(x / 128 + y / 96) % palette.size()];
+    // rows of glyph-like strokes on the light panels
+    if(bg[0] > 200 && y % 16 < 11 && (x * 7 + y * 13) % 29 < 4)
+      return {20, 20, 20, 255};
+    return bg;
+  }));
+  images.push_back(make("gradient", 3, [](const std::uint8_t*, std::uint32_t x, std::uint32_t y)->std::array<std::uint8_t, 4>{
+    return {static_cast<std::uint8_t>(x * 255 / (w-1)), static_cast<std::uint8_t>(y * 255 / (h-1)), static_cast<std::uint8_t>((x + y) * 255 / (w+h-2)), 255};
+  }));
+  images.push_back(make("noise", 3, [&](const std::uint8_t*, std::uint32_t, std::uint32_t)->std::array<std::uint8_t, 4>{
+    const auto r = random();
+    return {static_cast<std::uint8_t>(r), static_cast<std::uint8_t>(r >> 8), static_cast<std::uint8_t>(r >> 16), 255};
+  }));
+  images.push_back(make("flat", 4, [&](const std::uint8_t*, std::uint32_t, std::uint32_t)->std::array<std::uint8_t, 4>{
+    return random() % 4096u == 0 ? std::array<std::uint8_t, 4>{255, 0, 0, 255} : std::array<std::uint8_t, 4>{30, 30, 30, 255};
+  }));
+  return images;
+}
+
+struct entry{
+  std::string image;
+  std::string kernel;
+  std::size_t size = 0;
+  // the fastest round: interference only ever slows a round down
+  double mpps = 0.;
+  // how far the third fastest round falls behind the fastest one, relative to it: how reproducible the fastest round is
+  double spread = 0.;
+};
+
+// every round times each kernel once, for at least sample_ms, so that a drift of the machine speed during the run
+// shows up in the spread of every kernel instead of biasing the kernels measured at that time
+static std::vector<entry> run(unsigned rounds, unsigned sample_ms){
+  struct kernel{
+    entry e;
+    std::function<void()> f;
+    std::size_t px;
+    std::vector<double> mpps;
+    unsigned iterations = 1;
+  };
+  const auto images = corpus();
+  // the kernels refer to the encoded images
+  std::vector<std::vector<std::uint8_t>> encoded;
+  encoded.reserve(images.size());
+  std::vector<kernel> kernels;
+  for(const auto& img : images){
+    const std::size_t px = static_cast<std::size_t>(img.desc.width) * img.desc.height;
+    const auto& qoi = encoded.emplace_back(qoixx::qoi::encode<std::vector<std::uint8_t>>(img.pixels, img.desc));
+    if(qoixx::qoi::decode<std::vector<std::uint8_t>>(qoi).first != img.pixels)
+      throw std::runtime_error("perfcheck: roundtrip mismatch for " + img.name);
+    const auto name = img.name + (img.desc.channels == 4 ? "/rgba" : "/rgb");
+    kernels.push_back({{name, "encode", qoi.size()}, [&img]{
+      const auto e = qoixx::qoi::encode<std::pair<std::unique_ptr<std::uint8_t[]>, std::size_t>>(img.pixels.data(), img.pixels.size(), img.desc);
+    }, px, {}});
+    for(std::size_t i = 0; i < decoders.size(); ++i)
+      kernels.push_back({{name, std::string{"decode/"} + decoder_names[i], qoi.size()}, [&qoi, decoder = decoders[i]]{
+        qoixx::qoi::set_decoder(decoder);
+        const auto d = qoixx::qoi::decode<std::pair<std::unique_ptr<std::uint8_t[]>, std::size_t>>(qoi);
+      }, px, {}});
+  }
+  const auto selected = qoixx::qoi::get_decoder();
+  using us = std::chrono::duration<double, std::micro>;
+  // the first round is a warmup, which also sizes the rounds of each kernel
+  for(auto& k : kernels){
+    const auto start = std::chrono::high_resolution_clock::now();
+    k.f();
+    const auto once = std::chrono::duration_cast<us>(std::chrono::high_resolution_clock::now() - start).count();
+    k.iterations = static_cast<unsigned>(std::ceil(sample_ms * 1000. / std::max(once, 1.)));
+  }
+  for(unsigned r = 0; r < rounds; ++r)
+    for(auto& k : kernels){
+      const auto start = std::chrono::high_resolution_clock::now();
+      for(unsigned i = 0; i < k.iterations; ++i)
+        k.f();
+      const auto end = std::chrono::high_resolution_clock::now();
+      k.mpps.push_back(static_cast<double>(k.px) * k.iterations / std::chrono::duration_cast<us>(end - start).count());
+    }
+  qoixx::qoi::set_decoder(selected);
+  std::vector<entry> entries;
+  for(auto& k : kernels){
+    std::ranges::sort(k.mpps, std::greater<>{});
+    k.e.mpps = k.mpps.front();
+    k.e.spread = 1. - k.mpps[2] / k.e.mpps;
+    entries.push_back(std::move(k.e));
+  }
+  return entries;
+}
+
+static void write(std::ostream& os, const std::vector<entry>& entries){
+  os << "{\n"
+        "  \"backend\": \"" << backend << "\",\n"
+        "  \"compiler\": \"" << compiler << "\",\n"
+        "  \"entries\": [\n";
+  for(std::size_t i = 0; i < entries.size(); ++i){
+    const auto& e = entries[i];
+    os << "    {\"image\": \"" << e.image << "\", \"kernel\": \"" << e.kernel << "\", \"size\": " << e.size
+       << ", \"mpps\": " << std::fixed << std::setprecision(3) << e.mpps << ", \"spread\": " << std::setprecision(4) << e.spread << '}' << (i+1 < entries.size() ? ",\n" : "\n");
+  }
+  os << "  ]\n"
+        "}\n";
+}
+
+// reads the files written by write: an object of strings and an array of flat objects of strings and numbers
+class reader{
+  std::string_view s;
+  [[noreturn]] void fail()const{
+    throw std::runtime_error("perfcheck: malformed baseline");
+  }
+  void skip(){
+    while(!s.empty() && (s[0] == ' ' || s[0] == '\n' || s[0] == '\r' || s[0] == '\t'))
+      s.remove_prefix(1);
+  }
+  bool consume(char c){
+    skip();
+    if(s.empty() || s[0] != c)
+      return false;
+    s.remove_prefix(1);
+    return true;
+  }
+  std::string string(){
+    if(!consume('"'))
+      fail();
+    const auto end = s.find('"');
+    if(end == std::string_view::npos)
+      fail();
+    std::string str{s.substr(0, end)};
+    s.remove_prefix(end+1);
+    return str;
+  }
+  double number(){
+    skip();
+    std::size_t n = 0;
+    while(n < s.size() && (std::isdigit(static_cast<unsigned char>(s[n])) || s[n] == '.' || s[n] == '-' || s[n] == '+' || s[n] == 'e' || s[n] == 'E'))
+      ++n;
+    if(n == 0)
+      fail();
+    const auto x = std::stod(std::string{s.substr(0, n)});
+    s.remove_prefix(n);
+    return x;
+  }
+  entry object(){
+    entry e;
+    if(!consume('{'))
+      fail();
+    do{
+      const auto key = string();
+      if(!consume(':'))
+        fail();
+      if(key == "image")
+        e.image = string();
+      else if(key == "kernel")
+        e.kernel = string();
+      else if(key == "size")
+        e.size = static_cast<std::size_t>(number());
+      else if(key == "mpps")
+        e.mpps = number();
+      else if(key == "spread")
+        e.spread = number();
+      else
+        fail();
+    }while(consume(','));
+    if(!consume('}'))
+      fail();
+    return e;
+  }
+ public:
+  std::string backend, compiler;
+  std::vector<entry> entries;
+  explicit reader(std::string_view str):s{str}{
+    if(!consume('{'))
+      fail();
+    do{
+      const auto key = string();
+      if(!consume(':'))
+        fail();
+      if(key == "backend")
+        backend = string();
+      else if(key == "compiler")
+        compiler = string();
+      else if(key == "entries"){
+        if(!consume('['))
+          fail();
+        if(!consume(']')){
+          do
+            entries.push_back(object());
+          while(consume(','));
+          if(!consume(']'))
+            fail();
+        }
+      }
+      else
+        fail();
+    }while(consume(','));
+    if(!consume('}'))
+      fail();
+  }
+};
+
+struct options{
+  std::optional<std::filesystem::path> check, baseline;
+  unsigned rounds = 31;
+  unsigned sample_ms = 20;
+  double threshold = 5.;
+  double max_threshold = 15.;
+  bool parse_option(std::string_view argv){
+    const auto value = [&](std::string_view prefix){
+      return std::string{argv.substr(prefix.size())};
+    };
+    if(argv.starts_with("--perfcheck="))
+      this->check = value("--perfcheck=");
+    else if(argv.starts_with("--perfbaseline="))
+      this->baseline = value("--perfbaseline=");
+    else if(argv.starts_with("--rounds=")){
+      const auto n = std::stoi(value("--rounds="));
+      if(n < 3)
+        return false;
+      this->rounds = static_cast<unsigned>(n);
+    }
+    else if(argv.starts_with("--sample-ms=")){
+      const auto n = std::stoi(value("--sample-ms="));
+      if(n <= 0)
+        return false;
+      this->sample_ms = static_cast<unsigned>(n);
+    }
+    else if(argv.starts_with("--threshold=")){
+      this->threshold = std::stod(value("--threshold="));
+      if(this->threshold <= 0.)
+        return false;
+    }
+    else if(argv.starts_with("--max-threshold=")){
+      this->max_threshold = std::stod(value("--max-threshold="));
+      if(this->max_threshold <= 0.)
+        return false;
+    }
+    else
+      return false;
+    return this->threshold <= this->max_threshold;
+  }
+  // the noise of the baseline widens the threshold up to max_threshold; a run whose noise needs more than that can't be judged
+  double threshold_for(double spread)const{
+    return std::clamp(300. * spread, threshold, max_threshold);
+  }
+  bool too_noisy(double spread)const{
+    return 300. * spread > max_threshold;
+  }
+};
+
+// a kernel regresses when it is slower than the baseline by more than the threshold (widened to three times the spread of the baseline,
+// up to max_threshold) or encodes to a larger size; kernels measured too noisily to judge are reported, and fail the check, separately
+static int check(const std::filesystem::path& path, const options& opt){
+  std::ifstream ifs{path, std::ios::binary};
+  if(!ifs)
+    throw std::runtime_error("perfcheck: no baseline at " + path.string() + "; record one with make perfbaseline");
+  const std::string text{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+  const reader base{text};
+  std::cout << "# qoixx perfcheck: " << backend << ", " << compiler << "\n"
+               "# baseline " << path.string() << ": " << base.backend << ", " << base.compiler << "\n";
+  if(base.backend != backend){
+    std::cout << "# the baseline was recorded with another encoder backend; record one for " << backend << " with make perfbaseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const auto entries = run(opt.rounds, opt.sample_ms);
+  std::size_t failures = 0, noisy = 0;
+  std::cout << "image             kernel                  MP/s    baseline   change  threshold  size\n";
+  for(const auto& e : entries){
+    const auto it = std::ranges::find_if(base.entries, [&](const entry& b){return b.image == e.image && b.kernel == e.kernel;});
+    std::cout << std::left << std::setw(18) << e.image << std::setw(18) << e.kernel << std::right << std::fixed << std::setprecision(2) << std::setw(10) << e.mpps;
+    if(it == base.entries.end()){
+      std::cout << "           (not in the baseline)\n";
+      continue;
+    }
+    const auto change = (e.mpps / it->mpps - 1.) * 100.;
+    const auto threshold = opt.threshold_for(it->spread);
+    const bool unjudgeable = opt.too_noisy(e.spread) || opt.too_noisy(it->spread);
+    const bool slow = !unjudgeable && change < -threshold;
+    const bool larger = e.size > it->size;
+    std::cout << std::setw(12) << it->mpps << std::showpos << std::setw(8) << std::setprecision(1) << change << '%' << std::noshowpos << std::setw(10) << threshold << '%';
+    if(e.size != it->size)
+      std::cout << "  " << it->size << " -> " << e.size;
+    else
+      std::cout << "  same";
+    if(slow || larger){
+      ++failures;
+      std::cout << "  REGRESSION";
+    }
+    else if(unjudgeable){
+      ++noisy;
+      std::cout << "  too noisy to judge (spread " << std::setprecision(1) << 100. * std::max(e.spread, it->spread) << "%)";
+    }
+    std::cout << '\n';
+  }
+  std::cout << "# " << failures << " of " << entries.size() << " kernels regressed" << std::endl;
+  if(noisy > 0)
+    std::cout << "# " << noisy << " of " << entries.size() << " kernels were too noisy to judge; rerun on a quieter machine or raise --max-threshold" << std::endl;
+  return failures == 0 && noisy == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int record(const std::filesystem::path& path, const options& opt){
+  const auto entries = run(opt.rounds, opt.sample_ms);
+  if(path.has_parent_path())
+    std::filesystem::create_directories(path.parent_path());
+  std::ofstream ofs{path, std::ios::binary};
+  write(ofs, entries);
+  if(!ofs)
+    throw std::runtime_error("perfcheck: cannot write " + path.string());
+  std::cout << "# recorded " << entries.size() << " kernels (" << backend << ", " << compiler << ") to " << path.string() << std::endl;
+  // the spread is recorded as measured, so perfcheck reports these kernels as too noisy to judge instead of judging them loosely
+  if(const auto noisy = std::ranges::count_if(entries, [&](const entry& e){return opt.too_noisy(e.spread);}); noisy > 0)
+    std::cout << "# " << noisy << " of " << entries.size() << " kernels were too noisy to judge against; rerecord on a quieter machine for a full baseline" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+}
+
 static inline int help(const char* argv_0, std::ostream& os = std::cout){
   os << "Usage: " << argv_0 << " <iterations> <directory> [options...]\n"
         "Options:\n"
@@ -276,6 +829,19 @@ static inline int help(const char* argv_0, std::ostream& os = std::cout){
         "    --nodecode ... don't run decoders\n"
         "    --norecurse .. don't descend into directories\n"
         "    --onlytotals . don't print individual image results\n"
+        "    --decoder=tables|arithmetic|dispatch|auto\n"
+        "                   select the qoixx decoder; auto calibrates at startup\n"
+        "    --branchmisses  report branch misses per pixel of each qoixx decoder (Linux perf events)\n"
+        "    --stats ...... report the qoixx chunk mix, run lengths and SIMD coverage of each image (needs QOIXX_STATS)\n"
+        "    --instances=N  also decode with N concurrent qoixx instances and report the aggregate throughput\n"
+        "    --streaming=BYTES\n"
+        "                   write qoixx decode outputs of at least BYTES with non-temporal stores (0: always)\n"
+        "Regression gate (make perfcheck / make perfbaseline):\n"
+        "    " << argv_0 << " --perfcheck=FILE|--perfbaseline=FILE [--rounds=N] [--sample-ms=MS] [--threshold=PCT] [--max-threshold=PCT]\n"
+        "                   time a synthetic corpus (the fastest of N rounds, 31 by default, of at least MS each, 20 by default) and compare it with\n"
+        "                   (or record it as) the baseline FILE; fails when a kernel is slower by more than PCT (5 by default,\n"
+        "                   widened by the noise of the baseline up to --max-threshold, 15 by default) or encodes to a larger size,\n"
+        "                   and reports the kernels too noisy to judge within --max-threshold\n"
         "Examples\n"
         "    ./" << argv_0 << " 10 images/textures/\n"
         "    ./" << argv_0 << " 1 images/textures/ --nowarmup" << std::endl;
@@ -283,6 +849,17 @@ static inline int help(const char* argv_0, std::ostream& os = std::cout){
 }
 
 int main(int argc, char** argv)try{
+  if(argc >= 2 && std::string_view{argv[1]}.starts_with("--perf")){
+    perf::options opt = {};
+    for(int i = 1; i < argc; ++i)
+      if(!opt.parse_option(argv[i])){
+        std::cout << "Unknown option " << argv[i] << '\n';
+        return help(argv[0]);
+      }
+    if(opt.check.has_value() == opt.baseline.has_value())
+      return help(argv[0]);
+    return opt.check ? perf::check(*opt.check, opt) : perf::record(*opt.baseline, opt);
+  }
   if(argc < 3)
     return help(argv[0]);
   options opt = {};
@@ -298,6 +875,23 @@ int main(int argc, char** argv)try{
     return EXIT_FAILURE;
   }
   opt.runs = static_cast<unsigned>(runs);
+  if(opt.decoder)
+    qoixx::qoi::set_decoder(*opt.decoder);
+  if(qoixx::qoi::get_decoder() == qoixx::qoi::decoder::automatic)
+    qoixx::qoi::calibrate_decoder();
+  std::cout << "# qoixx encoder: " << qoixx::qoi::simd_backend() << '\n';
+  std::cout << "# qoixx decoder: " << decoder_names[static_cast<std::size_t>(qoixx::qoi::get_decoder())] << '\n';
+  if(opt.streaming_threshold)
+    qoixx::qoi::set_streaming_threshold(*opt.streaming_threshold);
+  std::cout << "# qoixx streaming threshold: " << qoixx::qoi::get_streaming_threshold() << " bytes\n";
+  if(opt.branch_misses && !branch_miss_counter::instance()){
+    std::cout << "# branch miss counter is not available, --branchmisses is ignored\n";
+    opt.branch_misses = false;
+  }
+  if(opt.stats && !qoixx::qoi::stats_enabled){
+    std::cout << "# qoixx is built without QOIXX_STATS, --stats is ignored\n";
+    opt.stats = false;
+  }
 
   const auto result = benchmark_directory(argv[2], opt);
   if(result.count > 0)
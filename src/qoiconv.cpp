@@ -32,6 +32,32 @@
 #include<variant>
 #include<string>
 #include<string_view>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<deque>
+#include<atomic>
+#include<chrono>
+#include<iomanip>
+#include<optional>
+#include<algorithm>
+#include<bit>
+#include<tuple>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define QOICONV_HAS_IO_URING 1
+#include<linux/io_uring.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<sys/syscall.h>
+#include<sys/uio.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<cerrno>
+#include<cstring>
+#else
+#define QOICONV_HAS_IO_URING 0
+#endif
 
 static inline std::vector<std::byte> load_file(const std::filesystem::path& path){
   std::vector<std::byte> bytes(std::filesystem::file_size(path));
@@ -54,15 +80,17 @@ struct stbi_png{
 
 using image = std::variant<stbi_png, std::pair<std::vector<std::byte>, qoixx::qoi::desc>>;
 
-static inline stbi_png read_png(const std::filesystem::path& file_path){
+static inline stbi_png read_png(const std::vector<std::byte>& bytes, const std::filesystem::path& file_path){
+  const auto* ptr = reinterpret_cast<const ::stbi_uc*>(bytes.data());
+  const auto len = static_cast<int>(bytes.size());
   int w, h, c;
-  if(!::stbi_info(file_path.string().c_str(), &w, &h, &c))
+  if(!::stbi_info_from_memory(ptr, len, &w, &h, &c))
     throw std::runtime_error("decode_png: Couldn't read header " + file_path.string());
 
   if(c != 3)
     c = 4;
 
-  auto loaded = ::stbi_load(file_path.string().c_str(), &w, &h, nullptr, c);
+  auto loaded = ::stbi_load_from_memory(ptr, len, &w, &h, nullptr, c);
   if(loaded == nullptr)
     throw std::runtime_error("decode_png: Couldn't load/decode " + file_path.string());
 
@@ -70,19 +98,26 @@ static inline stbi_png read_png(const std::filesystem::path& file_path){
   return {std::move(pixels), w, h, c};
 }
 
-static inline std::pair<std::vector<std::byte>, qoixx::qoi::desc> read_qoi(const std::filesystem::path& file_path){
-  const auto qoi = load_file(file_path);
+static inline stbi_png read_png(const std::filesystem::path& file_path){
+  return read_png(load_file(file_path), file_path);
+}
+
+static inline std::pair<std::vector<std::byte>, qoixx::qoi::desc> read_qoi(const std::vector<std::byte>& qoi){
   return qoixx::qoi::decode<std::vector<std::byte>>(qoi);
 }
 
+static inline std::pair<std::vector<std::byte>, qoixx::qoi::desc> read_qoi(const std::filesystem::path& file_path){
+  return read_qoi(load_file(file_path));
+}
+
 template<typename... Fs>
 struct overloaded : Fs...{
   using Fs::operator()...;
 };
 template<typename... Fs> overloaded(Fs...) -> overloaded<Fs...>;
 
-static inline void write_png(const std::filesystem::path& file_path, const image& image){
-  auto [ptr, w, h, c] = std::visit(overloaded(
+static inline std::tuple<const void*, int, int, int> png_source(const image& image){
+  return std::visit(overloaded(
     [](const stbi_png& image){
       return std::make_tuple(reinterpret_cast<const void*>(image.pixels.get()), image.width, image.height, image.channels);
     },
@@ -95,11 +130,25 @@ static inline void write_png(const std::filesystem::path& file_path, const image
       );
     }
   ), image);
+}
+
+static inline void write_png(const std::filesystem::path& file_path, const image& image){
+  auto [ptr, w, h, c] = png_source(image);
   if(!::stbi_write_png(file_path.string().c_str(), w, h, c, ptr, 0))
     throw std::runtime_error("write_png: Couldn't write/encode " + file_path.string());
 }
 
-static inline void write_qoi(const std::filesystem::path& file_path, const image& image){
+static inline std::vector<std::byte> encode_png(const std::filesystem::path& file_path, const image& image){
+  auto [ptr, w, h, c] = png_source(image);
+  int len;
+  const auto png = std::unique_ptr<unsigned char, void(*)(unsigned char*)>{::stbi_write_png_to_mem(static_cast<const unsigned char*>(ptr), 0, w, h, c, &len), [](unsigned char* p){STBIW_FREE(p);}};
+  if(png == nullptr)
+    throw std::runtime_error("write_png: Couldn't encode " + file_path.string());
+  const auto* first = reinterpret_cast<const std::byte*>(png.get());
+  return std::vector<std::byte>(first, first + len);
+}
+
+static inline std::vector<std::byte> encode_qoi(const image& image){
   auto [ptr, size, desc] = std::visit(overloaded(
     [](const stbi_png& image){
       return std::make_tuple(
@@ -117,17 +166,451 @@ static inline void write_qoi(const std::filesystem::path& file_path, const image
       return std::make_tuple(image.first.data(), image.first.size(), image.second);
     }
   ), image);
-  const auto encoded = qoixx::qoi::encode<std::vector<std::byte>>(ptr, size, desc);
-  save_file(file_path, encoded);
+  return qoixx::qoi::encode<std::vector<std::byte>>(ptr, size, desc);
+}
+
+static inline void write_qoi(const std::filesystem::path& file_path, const image& image){
+  save_file(file_path, encode_qoi(image));
+}
+
+// bulk conversion of every png/qoi file in a directory
+// the files are read and written by an io_uring (or, where it is not available, by blocking I/O threads)
+// while worker threads decode and encode the ones already in memory
+struct bulk_options{
+  std::filesystem::path in_dir;
+  std::filesystem::path out_dir;
+  bool to_qoi;
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  unsigned depth = 64;
+  bool io_uring = true;
+};
+
+struct bulk_job{
+  std::filesystem::path in, out;
+  std::vector<std::byte> bytes;
+  std::size_t done = 0;
+  int fd = -1;
+  bool writing = false;
+  std::string error;
+#if QOICONV_HAS_IO_URING
+  ::iovec iov;
+#endif
+};
+
+struct bulk_stats{
+  std::atomic<std::size_t> files = 0, failures = 0, bytes_read = 0, bytes_written = 0;
+};
+
+static inline void convert(bulk_job& job, bool to_qoi){
+  const auto im = [&]()->image{
+    if(job.in.extension() == ".png")
+      return read_png(job.bytes, job.in);
+    return read_qoi(job.bytes);
+  }();
+  job.bytes = to_qoi ? encode_qoi(im) : encode_png(job.out, im);
+}
+
+static inline void report_failure(const bulk_job& job, bulk_stats& stats){
+  static std::mutex mtx;
+  std::lock_guard lock{mtx};
+  std::cerr << job.in.string() << ": " << job.error << std::endl;
+  ++stats.failures;
+}
+
+// a queue of jobs between the I/O side and the converter threads
+class job_queue{
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<bulk_job*> jobs;
+  bool closed = false;
+ public:
+  void push(bulk_job* job){
+    {
+      std::lock_guard lock{mtx};
+      jobs.push_back(job);
+    }
+    cv.notify_one();
+  }
+  void close(){
+    {
+      std::lock_guard lock{mtx};
+      closed = true;
+    }
+    cv.notify_all();
+  }
+  bulk_job* pop(){
+    std::unique_lock lock{mtx};
+    cv.wait(lock, [&]{return !jobs.empty() || closed;});
+    if(jobs.empty())
+      return nullptr;
+    auto* job = jobs.front();
+    jobs.pop_front();
+    return job;
+  }
+  std::optional<bulk_job*> try_pop(){
+    std::lock_guard lock{mtx};
+    if(jobs.empty())
+      return std::nullopt;
+    auto* job = jobs.front();
+    jobs.pop_front();
+    return job;
+  }
+};
+
+// each of the --depth blocking I/O threads carries one file from its read to its write, and the --jobs converter threads convert it in between
+static inline void run_with_threads(const std::vector<bulk_job*>& jobs, const bulk_options& opt, bulk_stats& stats){
+  job_queue to_convert;
+  std::mutex converted_mtx;
+  std::condition_variable converted_cv;
+  std::vector<std::jthread> workers;
+  workers.reserve(opt.jobs);
+  for(unsigned i = 0; i < opt.jobs; ++i)
+    workers.emplace_back([&]{
+      while(auto* job = to_convert.pop()){
+        try{
+          convert(*job, opt.to_qoi);
+        }catch(std::exception& e){
+          job->error = e.what();
+        }
+        {
+          std::lock_guard lock{converted_mtx};
+          job->writing = true;
+        }
+        converted_cv.notify_all();
+      }
+    });
+
+  std::atomic<std::size_t> next = 0;
+  {
+    std::vector<std::jthread> io_threads;
+    io_threads.reserve(opt.depth);
+    for(unsigned i = 0; i < opt.depth; ++i)
+      io_threads.emplace_back([&]{
+        for(std::size_t n; (n = next++) < jobs.size();){
+          auto& job = *jobs[n];
+          try{
+            job.bytes = load_file(job.in);
+            stats.bytes_read += job.bytes.size();
+            to_convert.push(&job);
+            {
+              std::unique_lock lock{converted_mtx};
+              converted_cv.wait(lock, [&]{return job.writing;});
+            }
+            if(!job.error.empty())
+              report_failure(job, stats);
+            else{
+              save_file(job.out, job.bytes);
+              stats.bytes_written += job.bytes.size();
+              ++stats.files;
+            }
+          }catch(std::exception& e){
+            job.error = e.what();
+            report_failure(job, stats);
+          }
+          job.bytes = {};
+        }
+      });
+  }
+  to_convert.close();
+}
+
+#if QOICONV_HAS_IO_URING
+// the minimal io_uring setup for positional reads and writes, with the raw system calls so that liburing is not required
+class io_uring{
+  int fd = -1;
+  unsigned sq_entries, cq_entries;
+  void* sq_ring = MAP_FAILED;
+  void* cq_ring = MAP_FAILED;
+  std::size_t sq_ring_size, cq_ring_size;
+  ::io_uring_sqe* sqes = static_cast<::io_uring_sqe*>(MAP_FAILED);
+  unsigned *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  ::io_uring_cqe* cqes;
+  unsigned to_submit = 0;
+  template<typename T>
+  static T* at(void* base, std::size_t offset)noexcept{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+  }
+ public:
+  explicit io_uring(unsigned entries){
+    ::io_uring_params params = {};
+    fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if(fd < 0)
+      throw std::runtime_error(std::string{"io_uring_setup: "} + std::strerror(errno));
+    sq_entries = params.sq_entries;
+    cq_entries = params.cq_entries;
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+      sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(sq_ring == MAP_FAILED)
+      throw std::runtime_error("io_uring: Couldn't map the submission ring");
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+      cq_ring = sq_ring;
+    else{
+      cq_ring = ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if(cq_ring == MAP_FAILED)
+        throw std::runtime_error("io_uring: Couldn't map the completion ring");
+    }
+    sqes = static_cast<::io_uring_sqe*>(::mmap(nullptr, params.sq_entries * sizeof(::io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if(sqes == MAP_FAILED)
+      throw std::runtime_error("io_uring: Couldn't map the submission entries");
+    sq_tail = at<unsigned>(sq_ring, params.sq_off.tail);
+    sq_mask = at<unsigned>(sq_ring, params.sq_off.ring_mask);
+    sq_array = at<unsigned>(sq_ring, params.sq_off.array);
+    cq_head = at<unsigned>(cq_ring, params.cq_off.head);
+    cq_tail = at<unsigned>(cq_ring, params.cq_off.tail);
+    cq_mask = at<unsigned>(cq_ring, params.cq_off.ring_mask);
+    cqes = at<::io_uring_cqe>(cq_ring, params.cq_off.cqes);
+  }
+  io_uring(const io_uring&) = delete;
+  io_uring& operator=(const io_uring&) = delete;
+  ~io_uring(){
+    if(sqes != MAP_FAILED)
+      ::munmap(sqes, sq_entries * sizeof(::io_uring_sqe));
+    if(cq_ring != MAP_FAILED && cq_ring != sq_ring)
+      ::munmap(cq_ring, cq_ring_size);
+    if(sq_ring != MAP_FAILED)
+      ::munmap(sq_ring, sq_ring_size);
+    if(fd >= 0)
+      ::close(fd);
+  }
+  unsigned capacity()const noexcept{
+    return sq_entries;
+  }
+  // queues a readv/writev of job.bytes[job.done..] at file offset job.done; the job is the user data of its completion
+  void prepare(bulk_job& job, bool write)noexcept{
+    const auto tail = *sq_tail;
+    const auto index = tail & *sq_mask;
+    auto& sqe = sqes[index];
+    sqe = {};
+    job.iov = {job.bytes.data() + job.done, job.bytes.size() - job.done};
+    sqe.opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe.fd = job.fd;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(&job.iov);
+    sqe.len = 1;
+    sqe.off = job.done;
+    sqe.user_data = reinterpret_cast<std::uintptr_t>(&job);
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++to_submit;
+  }
+  // submits the queued entries and waits for at least min_complete completions
+  void submit(unsigned min_complete){
+    for(;;){
+      const auto ret = ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+      if(ret >= 0){
+        to_submit -= static_cast<unsigned>(ret);
+        return;
+      }
+      if(errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        throw std::runtime_error(std::string{"io_uring_enter: "} + std::strerror(errno));
+    }
+  }
+  template<typename F>
+  unsigned for_each_completion(F&& f){
+    auto head = *cq_head;
+    const auto tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    unsigned n = 0;
+    for(; head != tail; ++head, ++n){
+      const auto& cqe = cqes[head & *cq_mask];
+      f(*reinterpret_cast<bulk_job*>(static_cast<std::uintptr_t>(cqe.user_data)), cqe.res);
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    return n;
+  }
+};
+
+static inline void run_with_io_uring(io_uring& ring, const std::vector<bulk_job*>& jobs, const bulk_options& opt, bulk_stats& stats){
+  job_queue to_convert, to_write;
+  std::mutex idle_mtx;
+  std::condition_variable idle_cv;
+  std::vector<std::jthread> workers;
+  workers.reserve(opt.jobs);
+  for(unsigned i = 0; i < opt.jobs; ++i)
+    workers.emplace_back([&]{
+      while(auto* job = to_convert.pop()){
+        try{
+          convert(*job, opt.to_qoi);
+        }catch(std::exception& e){
+          job->error = e.what();
+        }
+        {
+          std::lock_guard lock{idle_mtx};
+          to_write.push(job);
+        }
+        idle_cv.notify_one();
+      }
+    });
+
+  // the number of files between the start of their read and the end of their write, bounded by the ring size
+  const unsigned depth = std::min(opt.depth, ring.capacity());
+  unsigned in_pipeline = 0, in_ring = 0;
+  std::size_t next = 0;
+  const auto finish = [&](bulk_job& job){
+    if(job.fd >= 0)
+      ::close(job.fd);
+    job.fd = -1;
+    if(!job.error.empty())
+      report_failure(job, stats);
+    else
+      ++stats.files;
+    job.bytes = {};
+    --in_pipeline;
+  };
+  const auto start_read = [&](bulk_job& job){
+    job.fd = ::open(job.in.c_str(), O_RDONLY | O_CLOEXEC);
+    struct ::stat st;
+    if(job.fd < 0 || ::fstat(job.fd, &st) != 0){
+      job.error = std::strerror(errno);
+      finish(job);
+      return;
+    }
+    job.bytes.resize(static_cast<std::size_t>(st.st_size));
+    ring.prepare(job, false);
+    ++in_ring;
+  };
+  const auto start_write = [&](bulk_job& job){
+    if(!job.error.empty())
+      return finish(job);
+    job.fd = ::open(job.out.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(job.fd < 0){
+      job.error = std::strerror(errno);
+      return finish(job);
+    }
+    job.done = 0;
+    ring.prepare(job, true);
+    ++in_ring;
+  };
+  while(next < jobs.size() || in_pipeline > 0){
+    while(in_pipeline < depth && next < jobs.size()){
+      ++in_pipeline;
+      start_read(*jobs[next++]);
+    }
+    while(const auto job = to_write.try_pop())
+      start_write(**job);
+    if(in_ring == 0){
+      if(in_pipeline == 0)
+        continue;
+      // every file in flight is being converted: wait for a worker
+      std::optional<bulk_job*> job;
+      {
+        std::unique_lock lock{idle_mtx};
+        idle_cv.wait(lock, [&]{return (job = to_write.try_pop()).has_value();});
+      }
+      start_write(**job);
+      continue;
+    }
+    ring.submit(1);
+    in_ring -= ring.for_each_completion([&](bulk_job& job, int res){
+      if(res < 0 || (res == 0 && job.done < job.bytes.size())){
+        job.error = res < 0 ? std::strerror(-res) : "unexpected end of file";
+        return finish(job);
+      }
+      job.done += static_cast<std::size_t>(res);
+      if(job.done < job.bytes.size()){
+        ring.prepare(job, job.writing);
+        ++in_ring;
+        return;
+      }
+      if(job.writing){
+        stats.bytes_written += job.bytes.size();
+        return finish(job);
+      }
+      stats.bytes_read += job.bytes.size();
+      ::close(job.fd);
+      job.fd = -1;
+      job.writing = true;
+      to_convert.push(&job);
+    });
+  }
+  to_convert.close();
+}
+#endif
+
+static inline int convert_directory(const bulk_options& opt){
+  const auto in_ext = opt.to_qoi ? ".png" : ".qoi";
+  const auto out_ext = opt.to_qoi ? ".qoi" : ".png";
+  std::vector<std::unique_ptr<bulk_job>> storage;
+  for(const auto& x : std::filesystem::directory_iterator{opt.in_dir})
+    if(x.is_regular_file() && x.path().extension() == in_ext){
+      auto& job = *storage.emplace_back(std::make_unique<bulk_job>());
+      job.in = x.path();
+      job.out = opt.out_dir / x.path().filename().replace_extension(out_ext);
+    }
+  std::vector<bulk_job*> jobs(storage.size());
+  std::ranges::transform(storage, jobs.begin(), [](const auto& x){return x.get();});
+  std::filesystem::create_directories(opt.out_dir);
+
+  bulk_stats stats;
+  const char* mode = "threads";
+  const auto start = std::chrono::steady_clock::now();
+  [&]{
+#if QOICONV_HAS_IO_URING
+    if(opt.io_uring){
+      std::optional<io_uring> ring;
+      try{
+        ring.emplace(std::bit_ceil(std::max(opt.depth, 1u)));
+      }catch(std::runtime_error& e){
+        std::cerr << "# " << e.what() << ", falling back to blocking I/O threads" << std::endl;
+      }
+      if(ring){
+        mode = "io_uring";
+        return run_with_io_uring(*ring, jobs, opt, stats);
+      }
+    }
+#endif
+    run_with_threads(jobs, opt, stats);
+  }();
+  const auto sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "# " << mode << ", " << opt.jobs << " workers, depth " << opt.depth << '\n'
+            << stats.files << " files converted, " << stats.failures << " failed in " << std::fixed << std::setprecision(3) << sec << " s\n"
+            << std::setprecision(1) << stats.files / sec << " files/s, read " << stats.bytes_read / sec / 1e6 << " MB/s, written " << stats.bytes_written / sec / 1e6 << " MB/s" << std::endl;
+  return stats.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+static inline int usage(const char* argv_0){
+  std::cout << "Usage: " << argv_0 << " <infile> <outfile>\n"
+               "       " << argv_0 << " <indir> <outdir> <png|qoi> [options...]\n"
+               "Options for directories:\n"
+               "    --jobs=N ..... convert with N worker threads (default: the number of hardware threads)\n"
+               "    --depth=N .... keep up to N files in flight (default: 64)\n"
+               "    --nouring .... use blocking I/O threads instead of io_uring\n"
+               "Examples:\n"
+               "  " << argv_0 << " input.png output.qoi\n"
+               "  " << argv_0 << " input.qoi output.png\n"
+               "  " << argv_0 << " images/ qoi_images/ qoi --depth=256" << std::endl;
+  return EXIT_FAILURE;
 }
 
 int main(int argc, char **argv)try{
-  if(argc < 3){
-    std::cout << "Usage: " << argv[0] << " <infile> <outfile>\n"
-                 "Examples:\n"
-                 "  " << argv[0] << " input.png output.qoi\n"
-                 "  " << argv[0] << " input.qoi output.png" << std::endl;
-    return EXIT_FAILURE;
+  if(argc < 3)
+    return usage(argv[0]);
+
+  if(std::filesystem::is_directory(argv[1])){
+    if(argc < 4)
+      return usage(argv[0]);
+    const std::string_view format{argv[3]};
+    if(format != "png" && format != "qoi")
+      return usage(argv[0]);
+    bulk_options opt{.in_dir = argv[1], .out_dir = argv[2], .to_qoi = format == "qoi"};
+    for(int i = 4; i < argc; ++i){
+      const std::string_view arg{argv[i]};
+      if(arg.starts_with("--jobs="))
+        opt.jobs = static_cast<unsigned>(std::max(1, std::stoi(std::string{arg.substr(7)})));
+      else if(arg.starts_with("--depth="))
+        opt.depth = static_cast<unsigned>(std::max(1, std::stoi(std::string{arg.substr(8)})));
+      else if(arg == "--nouring")
+        opt.io_uring = false;
+      else{
+        std::cout << "Unknown option " << arg << '\n';
+        return usage(argv[0]);
+      }
+    }
+    return convert_directory(opt);
   }
 
   const std::string_view in{argv[1]}, out{argv[2]};
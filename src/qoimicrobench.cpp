@@ -0,0 +1,375 @@
+#include"qoixx.hpp"
+
+#include<chrono>
+#include<iostream>
+#include<string_view>
+#include<string>
+#include<cstddef>
+#include<cstdint>
+#include<cstdlib>
+#include<cstring>
+#include<vector>
+#include<array>
+#include<iomanip>
+#include<limits>
+#include<algorithm>
+#include<type_traits>
+#if defined(__linux__)
+#include<linux/perf_event.h>
+#include<sys/ioctl.h>
+#include<sys/syscall.h>
+#include<unistd.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#if defined(_MSC_VER)
+#include<intrin.h>
+#else
+#include<x86intrin.h>
+#endif
+#define QOIXX_MICROBENCH_TSC
+#endif
+
+// core cycles of the calling thread with perf_event_open(2); the TSC on x86 and nanoseconds elsewhere when it is unavailable
+class cycle_counter{
+  int fd = -1;
+ public:
+  cycle_counter(){
+#if defined(__linux__)
+    ::perf_event_attr attr = {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+  cycle_counter(const cycle_counter&) = delete;
+  cycle_counter& operator=(const cycle_counter&) = delete;
+  ~cycle_counter(){
+#if defined(__linux__)
+    if(fd >= 0)
+      ::close(fd);
+#endif
+  }
+  const char* unit()const noexcept{
+    if(fd >= 0)
+      return "core cycles";
+#if defined(QOIXX_MICROBENCH_TSC)
+    return "TSC cycles";
+#else
+    return "nanoseconds";
+#endif
+  }
+  std::uint64_t now()noexcept{
+#if defined(__linux__)
+    if(fd >= 0){
+      std::uint64_t count = 0;
+      if(::read(fd, &count, sizeof(count)) != sizeof(count))
+        count = 0;
+      return count;
+    }
+#endif
+#if defined(QOIXX_MICROBENCH_TSC)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+  }
+};
+
+// keeps the result of a stage alive without storing it anywhere the stage would not
+template<typename T>
+static inline void keep(const T& x)noexcept{
+#if defined(__GNUC__)
+  asm volatile("" : : "r"(&x) : "memory");
+#else
+  static const void* volatile sink;
+  sink = &x;
+#endif
+}
+
+struct bench{
+  cycle_counter counter;
+  unsigned runs;
+  std::size_t px;
+  // the minimum over the runs, per pixel; the inputs are sized to stay in the cache, so this is the cost of the code itself
+  template<typename F>
+  double operator()(F&& f){
+    f();
+    auto best = std::numeric_limits<std::uint64_t>::max();
+    for(unsigned i = 0; i < runs; ++i){
+      const auto start = counter.now();
+      f();
+      best = std::min(best, counter.now() - start);
+    }
+    return static_cast<double>(best) / static_cast<double>(px);
+  }
+};
+
+// roughly the chunk mix of photographs and screenshots, like qoi::calibrate_decoder
+static std::vector<std::uint8_t> make_image(std::size_t px, std::uint8_t channels, bool flat){
+  std::vector<std::uint8_t> image(px*channels);
+  std::uint32_t seed = 0x9e3779b9u;
+  qoixx::qoi::rgba_t p = {0, 0, 0, 255};
+  for(std::size_t i = 0; i < px; ++i){
+    seed = seed * 1664525u + 1013904223u;
+    const auto r = seed >> 24;
+    if(flat || r < 64){}
+    else if(r < 160){
+      p.r += (seed >>  8 & 3u) - 2;
+      p.g += (seed >> 10 & 3u) - 2;
+      p.b += (seed >> 12 & 3u) - 2;
+    }
+    else if(r < 240){
+      const auto dg = (seed >> 8 & 31u) - 16;
+      p.r += dg + (seed >> 13 & 7u) - 4;
+      p.g += dg;
+      p.b += dg + (seed >> 16 & 7u) - 4;
+    }
+    else{
+      p.r = static_cast<std::uint8_t>(seed >> 4);
+      p.g = static_cast<std::uint8_t>(seed >> 8);
+      p.b = static_cast<std::uint8_t>(seed >> 12);
+      if(r >= 252)
+        p.a = static_cast<std::uint8_t>(seed >> 16);
+    }
+    std::memcpy(image.data() + i*channels, &p, channels);
+  }
+  return image;
+}
+
+// the chunks (and the padding) of px pixels encoded with a single opcode
+static std::vector<std::uint8_t> make_chunks(std::uint8_t op, std::size_t px){
+  std::vector<std::uint8_t> chunks;
+  std::uint32_t seed = 12345u;
+  const auto random = [&]{
+    seed = seed * 1103515245u + 12345u;
+    return static_cast<std::uint8_t>(seed >> 16);
+  };
+  for(std::size_t i = 0; i < px;){
+    if(op == 0xfeu || op == 0xffu){
+      chunks.push_back(op);
+      for(int c = op == 0xfeu ? 3 : 4; c > 0; --c)
+        chunks.push_back(random());
+      ++i;
+    }
+    else if(op >= 0xc0u){
+      chunks.push_back(op);
+      i += (op & 0x3fu) + 1u;
+    }
+    else{
+      chunks.push_back(static_cast<std::uint8_t>(op | (random() & 0x3fu)));
+      if(op == 0x80u)
+        chunks.push_back(random());
+      ++i;
+    }
+  }
+  chunks.insert(chunks.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+  return chunks;
+}
+
+namespace qoixx{
+
+struct microbench{
+  static constexpr double none = -1.;
+  struct encode_result{
+    double load = none, classify = none, hash = none, kernel = none, runs = none, scalar = none, serial_index = none, register_index = none, serial_emit = none, packed_emit = none;
+  };
+  template<std::uint_fast8_t Channels>
+  static encode_result encode(bench& b, const std::vector<std::uint8_t>& image, const std::vector<std::uint8_t>& flat){
+    encode_result r;
+    const auto px = b.px;
+    std::vector<std::uint8_t> out(qoi::max_encoded_size({static_cast<std::uint32_t>(px), 1, Channels, qoi::colorspace::srgb}));
+    const auto kernel = [&](const std::vector<std::uint8_t>& input, bool simd){
+      return [&, simd]{
+        auto p = container_operator<std::vector<std::uint8_t>>::create_pusher(out);
+        detail::contiguous_puller<std::uint8_t> puller{input.data()};
+        qoi::encode_state state;
+        if(simd)
+          qoi::encode_pixels<Channels>(p, puller, state, px);
+        else
+          qoi::encode_body<Channels>(p, puller, state, px);
+        keep(p.i);
+      };
+    };
+    r.kernel = b(kernel(image, true));
+    r.runs = b(kernel(flat, true));
+    r.scalar = b(kernel(image, false));
+    stages<Channels>(b, image.data(), r);
+    kernel_variants<Channels>(b, image.data(), out, r);
+    return r;
+  }
+  // the SIMD kernel with the serial index pass and with the index in registers, whatever QOIXX_ENCODE_REGISTER_INDEX selects by default,
+  // and on x86 with the chunks emitted lane by lane and packed, whichever the vector width selects by default
+  template<std::uint_fast8_t Channels>
+  static void kernel_variants([[maybe_unused]] bench& b, [[maybe_unused]] const std::uint8_t* image, [[maybe_unused]] std::vector<std::uint8_t>& out, [[maybe_unused]] encode_result& r){
+#if !defined(QOIXX_NO_SIMD) && ((defined(__aarch64__) && !defined(__ARM_FEATURE_SVE) && defined(QOIXX_EXPERIMENTAL_SIMD)) || defined(__AVX2__) || defined(__SSE4_1__))
+    const auto variant = [&](auto register_index, [[maybe_unused]] auto serial_emit){
+      return b([&]{
+        auto p = container_operator<std::vector<std::uint8_t>>::create_pusher(out);
+        detail::contiguous_puller<std::uint8_t> puller{image};
+        qoi::encode_state state;
+#if defined(__aarch64__)
+        qoi::encode_neon<Channels, register_index()>(p, puller, state, b.px);
+#else
+        qoi::encode_x86<Channels, register_index(), serial_emit()>(p, puller, state, b.px);
+#endif
+        keep(p.i);
+      });
+    };
+#if defined(__aarch64__)
+    using default_emit = std::false_type;
+#else
+    using default_emit = std::bool_constant<qoi::default_serial_emit>;
+#endif
+    r.serial_index = variant(std::false_type{}, default_emit{});
+    r.register_index = variant(std::true_type{}, default_emit{});
+#if !defined(__aarch64__)
+    r.serial_emit = variant(std::false_type{}, std::true_type{});
+    r.packed_emit = variant(std::false_type{}, std::false_type{});
+#endif
+#endif
+  }
+  template<std::uint_fast8_t Channels>
+  static void stages([[maybe_unused]] bench& b, [[maybe_unused]] const std::uint8_t* image, [[maybe_unused]] encode_result& r){
+    [[maybe_unused]] static constexpr bool Alpha = Channels == 4;
+#ifndef QOIXX_NO_SIMD
+#if defined(__ARM_FEATURE_SVE)
+    const std::size_t lanes = svcntb();
+    const auto pg = svptrue_b8();
+    std::uint8_t sink[256];
+    r.load = b([&]{
+      for(std::size_t i = 0; i + lanes <= b.px; i += lanes)
+        svst1_u8(pg, sink, qoi::get<0>(qoi::load<Alpha>(pg, image + i*Channels)));
+      keep(sink);
+    });
+#elif defined(__aarch64__)
+    static constexpr std::size_t lanes = qoi::simd_lanes;
+    r.load = b([&]{
+      for(std::size_t i = 0; i + lanes <= b.px; i += lanes)
+        keep(qoi::load<Alpha>(image + i*Channels));
+    });
+#elif defined(__riscv_vector) && defined(QOIXX_EXPERIMENTAL_SIMD)
+    const auto vl = __riscv_vsetvl_e8m1(qoi::simd_lanes);
+    std::uint8_t sink[qoi::simd_lanes];
+    r.load = b([&]{
+      for(std::size_t i = 0; i + vl <= b.px; i += vl)
+        __riscv_vse8_v_u8m1(sink, qoi::get<0>(qoi::load<Alpha>(image + i*Channels, vl)), vl);
+      keep(sink);
+    });
+#elif defined(__AVX2__) || defined(__SSE4_1__)
+    static constexpr std::size_t lanes = qoi::simd_lanes;
+    const std::size_t blocks = b.px / lanes;
+    std::vector<qoi::pixels_type<Alpha>> planes(blocks);
+    for(std::size_t i = 0; i < blocks; ++i)
+      planes[i] = qoi::load<Alpha>(image + i*lanes*Channels);
+    r.load = b([&]{
+      for(std::size_t i = 0; i < blocks; ++i)
+        keep(qoi::load<Alpha>(image + i*lanes*Channels));
+    });
+    r.classify = b([&]{
+      for(std::size_t i = 1; i < blocks; ++i)
+        keep(qoi::classify_block<Alpha>(qoi::diff_block<Alpha>(planes[i], planes[i-1])));
+    });
+    r.hash = b([&]{
+      for(std::size_t i = 0; i < blocks; ++i)
+        keep(qoi::hash_block<Alpha>(planes[i]));
+    });
+#endif
+#endif
+  }
+  // arithmetic, tables and dispatch, as in qoibench
+  static std::array<double, 3> decode(bench& b, const std::vector<std::uint8_t>& chunks){
+    std::vector<std::uint8_t> out(b.px*4);
+    const auto run = [&](auto decode){
+      return b([&]{
+        auto pusher = container_operator<std::vector<std::uint8_t>>::create_pusher(out);
+        detail::contiguous_puller<std::uint8_t> puller{chunks.data()};
+        decode(pusher, puller);
+        keep(out);
+      });
+    };
+    return {
+      run([&](auto& pusher, auto& puller){ qoi::decode_impl<4, false>(pusher, puller, b.px, chunks.size()); }),
+      run([&](auto& pusher, auto& puller){ qoi::decode_impl<4, true>(pusher, puller, b.px, chunks.size()); }),
+      run([&](auto& pusher, auto& puller){ qoi::decode_dispatch<4>(pusher, puller, b.px, chunks.size()); }),
+    };
+  }
+};
+
+}
+
+struct value{
+  double v;
+  friend std::ostream& operator<<(std::ostream& os, const value& x){
+    if(x.v < 0.)
+      return os << std::setw(12) << '-';
+    return os << std::fixed << std::setprecision(3) << std::setw(12) << x.v;
+  }
+};
+
+static inline int help(const char* argv_0, std::ostream& os = std::cout){
+  os << "Usage: " << argv_0 << " [runs] [options...]\n"
+        "Times the stages of the qoixx encoder of this build and the opcode handlers of the decoders, per pixel (the minimum of runs, 200 by default)\n"
+        "Options:\n"
+        "    --pixels=N ... pixels per measurement (16384 by default); keep the inputs in the cache for stable results\n"
+        "Examples\n"
+        "    ./" << argv_0 << "\n"
+        "    make MARCH=x86-64-v2 qoimicrobench && ./" << argv_0 << " 500" << std::endl;
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char** argv){
+  unsigned runs = 200;
+  std::size_t px = 16384;
+  for(int i = 1; i < argc; ++i){
+    const std::string_view arg = argv[i];
+    if(arg.starts_with("--pixels=")){
+      const auto n = std::stoll(std::string{arg.substr(sizeof("--pixels=")-1)});
+      if(n < 64)
+        return help(argv[0]);
+      px = static_cast<std::size_t>(n);
+    }
+    else if(i == 1 && !arg.empty() && arg.find_first_not_of("0123456789") == std::string_view::npos && std::stoi(std::string{arg}) > 0)
+      runs = static_cast<unsigned>(std::stoi(std::string{arg}));
+    else
+      return help(argv[0]);
+  }
+
+  bench b{{}, runs, px};
+  std::cout << "# qoixx microbench: " << qoixx::qoi::simd_backend() << " encoder, " << px << " pixels, minimum of " << runs << " runs, " << b.counter.unit() << " per pixel\n\n";
+
+  const auto rgb = qoixx::microbench::encode<3>(b, make_image(px, 3, false), make_image(px, 3, true));
+  const auto rgba = qoixx::microbench::encode<4>(b, make_image(px, 4, false), make_image(px, 4, true));
+  using result = qoixx::microbench::encode_result;
+  // index resolution and chunk emission are what remains of a block after the separately timed stages
+  const auto rest = [](const result& r){
+    return r.load < 0. || r.classify < 0. || r.hash < 0. ? -1. : std::max(r.kernel - r.load - r.classify - r.hash, 0.);
+  };
+  std::cout << "encode                   rgb        rgba\n"
+            << "load (deinterleave) " << value{rgb.load} << value{rgba.load} << '\n'
+            << "diff + classify     " << value{rgb.classify} << value{rgba.classify} << '\n'
+            << "hash                " << value{rgb.hash} << value{rgba.hash} << '\n'
+            << "index + emit (rest) " << value{rest(rgb)} << value{rest(rgba)} << '\n'
+            << "kernel              " << value{rgb.kernel} << value{rgba.kernel} << '\n'
+            << "kernel, all runs    " << value{rgb.runs} << value{rgba.runs} << '\n'
+            << "kernel, index serial" << value{rgb.serial_index} << value{rgba.serial_index} << '\n'
+            << "kernel, index in reg" << value{rgb.register_index} << value{rgba.register_index} << '\n'
+            << "kernel, emit by lane" << value{rgb.serial_emit} << value{rgba.serial_emit} << '\n'
+            << "kernel, emit packed " << value{rgb.packed_emit} << value{rgba.packed_emit} << '\n'
+            << "scalar encode_body  " << value{rgb.scalar} << value{rgba.scalar} << "\n\n";
+
+  static constexpr std::array<std::pair<const char*, std::uint8_t>, 7> ops = {{
+    {"index", 0x00u}, {"diff", 0x40u}, {"luma", 0x80u}, {"rgb", 0xfeu}, {"rgba", 0xffu}, {"run of 1", 0xc0u}, {"run of 62", 0xfdu},
+  }};
+  std::cout << "decode to rgba        arithmetic      tables    dispatch\n";
+  const auto print = [](const char* label, const std::array<double, 3>& r){
+    std::cout << label << std::string(std::string_view{label}.size() < 20 ? 20 - std::string_view{label}.size() : 1, ' ') << value{r[0]} << value{r[1]} << value{r[2]} << '\n';
+  };
+  for(const auto& [label, op] : ops)
+    print(label, qoixx::microbench::decode(b, make_chunks(op, px)));
+  const qoixx::qoi::desc d{static_cast<std::uint32_t>(px), 1, 4, qoixx::qoi::colorspace::srgb};
+  const auto encoded = qoixx::qoi::encode<std::vector<std::uint8_t>>(make_image(px, 4, false), d);
+  print("mixed", qoixx::microbench::decode(b, std::vector<std::uint8_t>(encoded.begin() + 14, encoded.end())));
+}
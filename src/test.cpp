@@ -2,6 +2,10 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 
+#include<string>
+#include<memory_resource>
+#include<cstdlib>
+
 template<typename T, typename U>
 static bool equals(const T& t, const U& u){
   const auto t_size = qoixx::container_operator<T>::size(t);
@@ -18,6 +22,98 @@ static bool equals(const T& t, const U& u){
   return true;
 }
 
+template<std::size_t N>
+static std::array<std::vector<std::uint8_t>, N> split_planes(const std::vector<std::uint8_t>& image){
+  std::array<std::vector<std::uint8_t>, N> planes;
+  for(std::size_t i = 0; i < image.size(); ++i)
+    planes[i%N].push_back(image[i]);
+  return planes;
+}
+
+// the fixtures draw their pixels from this linear congruential generator, each from its own seed
+struct lcg{
+  std::uint32_t state;
+  constexpr std::uint32_t operator()(){
+    return state = state * 1103515245u + 12345u;
+  }
+};
+
+// restores the decoder selected before the test even when a REQUIRE fails
+struct decoder_guard{
+  qoixx::qoi::decoder original = qoixx::qoi::get_decoder();
+  ~decoder_guard(){
+    qoixx::qoi::set_decoder(original);
+  }
+};
+
+// calls f with each decoder selected in turn, restoring the original selection afterwards
+template<typename F>
+static void for_each_decoder(F&& f, std::initializer_list<qoixx::qoi::decoder> decoders = {qoixx::qoi::decoder::tables, qoixx::qoi::decoder::arithmetic, qoixx::qoi::decoder::dispatch}){
+  const decoder_guard guard;
+  for(auto decoder : decoders){
+    qoixx::qoi::set_decoder(decoder);
+    f();
+  }
+}
+
+enum class pattern{
+  flat,       // runs of a hundred pixels and more, longer than a SIMD block and than one run chunk
+  stripes,    // three pixels repeating the previous one, then two random ones
+  repeats,    // each byte repeats the one of the previous pixel half of the time
+  drift,      // each byte moves by -2..2 from the one of the previous pixel most of the time
+  walk,       // each byte moves by -3..3 from the one of the previous pixel; the alpha channel rarely changes
+  gradient,   // a value for every 16 pixels with some random bytes
+  periodic,   // rows repeating the pixels 29 to the left, except every fifth row
+  near_black, // small values around transparent black
+};
+
+// the pixels of a fixture, drawn from lcg{seed}; the first pixel is random for the patterns that refer to the previous one
+static std::vector<std::uint8_t> make_image(const qoixx::qoi::desc& d, std::uint32_t seed, pattern p){
+  const std::size_t channels = d.channels;
+  std::vector<std::uint8_t> image(static_cast<std::size_t>(d.width) * d.height * channels);
+  lcg rng{seed};
+  std::uint32_t flat = 0x80285078u;
+  for(std::size_t i = 0; i < image.size(); ++i){
+    const auto r = rng();
+    const auto random = static_cast<std::uint8_t>(r >> 16);
+    const auto previous = i >= channels ? image[i - channels] : random;
+    switch(p){
+    case pattern::flat:
+      if(i % channels == 0 && (r >> 24) < 2)
+        flat = r >> 4 | 0x80000000u;
+      image[i] = static_cast<std::uint8_t>(flat >> i % channels * 8);
+      break;
+    case pattern::stripes:
+      image[i] = (i / channels) % 5 < 3 ? previous : random;
+      break;
+    case pattern::repeats:
+      image[i] = (r >> 28) < 8 ? previous : random;
+      break;
+    case pattern::drift:
+      image[i] = (r >> 28) < 10 ? static_cast<std::uint8_t>(previous + (r >> 16) % 5 - 2) : random;
+      break;
+    case pattern::walk:
+      if(i < channels)
+        image[i] = random;
+      else if(i % channels == 3)
+        image[i] = static_cast<std::uint8_t>(previous + ((r >> 28) == 0 ? (r >> 16) % 7 : 0));
+      else
+        image[i] = static_cast<std::uint8_t>(previous + (r >> 16) % 7 - 3);
+      break;
+    case pattern::gradient:
+      image[i] = (r >> 28) == 0 ? random : static_cast<std::uint8_t>(i / channels / 16);
+      break;
+    case pattern::periodic:
+      image[i] = i >= 29 * channels && (i / channels / d.width) % 5 != 0 ? image[i - 29 * channels] : random;
+      break;
+    case pattern::near_black:
+      image[i] = static_cast<std::uint8_t>((r >> 16) % (i % channels == 3 ? 3 : 6));
+      break;
+    }
+  }
+  return image;
+}
+
 TEST_CASE("3-channel image"){
   constexpr qoixx::qoi::desc d{
     .width = 8,
@@ -64,6 +160,14 @@ TEST_CASE("3-channel image"){
     const auto actual = qoixx::qoi::encode<std::vector<std::byte>>(image.data(), image.size(), d);
     CHECK(equals(actual, expected));
   }
+  SUBCASE("encode planar std::pair<std::array<const std::uint8_t*, 3>, std::size_t>, output as std::vector<std::uint8_t>"){
+    const auto planes = split_planes<3>(image);
+    std::array<const std::uint8_t*, 3> ptrs;
+    for(std::size_t i = 0; i < ptrs.size(); ++i)
+      ptrs[i] = planes[i].data();
+    const auto actual = qoixx::qoi::encode<std::vector<std::uint8_t>>(std::make_pair(ptrs, planes[0].size()), d);
+    CHECK(actual == expected);
+  }
   SUBCASE("decode std::vector<std::uint8_t>, output as std::vector<std::uint8_t>"){
     const auto [actual, desc] = qoixx::qoi::decode<std::vector<std::uint8_t>>(expected);
     CHECK(d == desc);
@@ -85,6 +189,21 @@ TEST_CASE("3-channel image"){
     const auto [actual, desc] = qoixx::qoi::decode<std::vector<std::byte>>(expected.data(), expected.size());
     CHECK(equals(actual, image));
   }
+  SUBCASE("decode std::vector<std::uint8_t>, output as planar std::array<std::vector<std::uint8_t>, 3>"){
+    const auto [actual, desc] = qoixx::qoi::decode<std::array<std::vector<std::uint8_t>, 3>>(expected);
+    CHECK(d == desc);
+    CHECK(actual == split_planes<3>(image));
+  }
+  SUBCASE("decode std::vector<std::uint8_t>, output as normalized planar std::array<std::vector<float>, 3>"){
+    const auto [actual, desc] = qoixx::qoi::decode<std::array<std::vector<float>, 3>>(expected);
+    CHECK(d == desc);
+    const auto planes = split_planes<3>(image);
+    for(std::size_t i = 0; i < planes.size(); ++i){
+      REQUIRE(actual[i].size() == planes[i].size());
+      for(std::size_t j = 0; j < planes[i].size(); ++j)
+        CHECK(actual[i][j] == planes[i][j] / 255.f);
+    }
+  }
 }
 
 TEST_CASE("4-channel image"){
@@ -137,6 +256,14 @@ TEST_CASE("4-channel image"){
     const auto actual = qoixx::qoi::encode<std::vector<std::byte>>(image.data(), image.size(), d);
     CHECK(equals(actual, expected));
   }
+  SUBCASE("encode planar std::pair<std::array<const std::uint8_t*, 4>, std::size_t>, output as std::vector<std::uint8_t>"){
+    const auto planes = split_planes<4>(image);
+    std::array<const std::uint8_t*, 4> ptrs;
+    for(std::size_t i = 0; i < ptrs.size(); ++i)
+      ptrs[i] = planes[i].data();
+    const auto actual = qoixx::qoi::encode<std::vector<std::uint8_t>>(std::make_pair(ptrs, planes[0].size()), d);
+    CHECK(actual == expected);
+  }
   SUBCASE("decode std::vector<std::uint8_t>, output as std::vector<std::uint8_t>"){
     const auto [actual, desc] = qoixx::qoi::decode<std::vector<std::uint8_t>>(expected);
     CHECK(d == desc);
@@ -158,4 +285,515 @@ TEST_CASE("4-channel image"){
     const auto [actual, desc] = qoixx::qoi::decode<std::vector<std::byte>>(expected.data(), expected.size());
     CHECK(equals(actual, image));
   }
+  SUBCASE("decode std::vector<std::uint8_t>, output as planar std::array<std::vector<std::uint8_t>, 4>"){
+    const auto [actual, desc] = qoixx::qoi::decode<std::array<std::vector<std::uint8_t>, 4>>(expected);
+    CHECK(d == desc);
+    CHECK(actual == split_planes<4>(image));
+  }
+  SUBCASE("decode std::vector<std::uint8_t>, output as normalized planar std::array<std::vector<float>, 4>"){
+    const auto [actual, desc] = qoixx::qoi::decode<std::array<std::vector<float>, 4>>(expected);
+    CHECK(d == desc);
+    const auto planes = split_planes<4>(image);
+    for(std::size_t i = 0; i < planes.size(); ++i){
+      REQUIRE(actual[i].size() == planes[i].size());
+      for(std::size_t j = 0; j < planes[i].size(); ++j)
+        CHECK(actual[i][j] == planes[i][j] / 255.f);
+    }
+  }
+}
+
+TEST_CASE("planar decode of long runs"){
+  const auto check = []<std::uint8_t Channels>(){
+    const qoixx::qoi::desc d{.width = 97, .height = 31, .channels = Channels, .colorspace = qoixx::qoi::colorspace::srgb};
+    const auto image = make_image(d, Channels * 131u, pattern::flat);
+    const auto encoded = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+    const auto planes = split_planes<Channels>(image);
+    for_each_decoder([&]{
+      CHECK(qoixx::qoi::decode<std::array<std::vector<std::uint8_t>, Channels>>(encoded).first == planes);
+      const auto [actual, desc] = qoixx::qoi::decode<std::array<std::vector<float>, Channels>>(encoded);
+      CHECK(d == desc);
+      for(std::size_t i = 0; i < planes.size(); ++i){
+        REQUIRE(actual[i].size() == planes[i].size());
+        for(std::size_t j = 0; j < planes[i].size(); ++j)
+          CHECK(actual[i][j] == planes[i][j] / 255.f);
+      }
+    });
+  };
+  check.template operator()<3>();
+  check.template operator()<4>();
+}
+
+TEST_CASE("downscaled decode"){
+  for(std::uint8_t channels = 3; channels <= 4; ++channels){
+    const qoixx::qoi::desc d{.width = 29, .height = 19, .channels = channels, .colorspace = qoixx::qoi::colorspace::srgb};
+    const auto image = make_image(d, 12345, pattern::stripes);
+    const auto encoded = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+    for(std::uint32_t scale : {2u, 4u, 8u}){
+      SUBCASE(("channels " + std::to_string(+channels) + ", scale " + std::to_string(scale)).c_str()){
+        const auto [actual, desc] = qoixx::qoi::decode_downscaled<std::vector<std::uint8_t>>(encoded, scale);
+        CHECK(desc.width == (d.width + scale - 1) / scale);
+        CHECK(desc.height == (d.height + scale - 1) / scale);
+        REQUIRE(actual.size() == desc.width * desc.height * d.channels);
+        for(std::uint32_t y = 0; y < desc.height; ++y)
+          for(std::uint32_t x = 0; x < desc.width; ++x)
+            for(std::size_t k = 0; k < d.channels; ++k){
+              std::uint32_t sum = 0, cnt = 0;
+              for(std::uint32_t yy = y * scale; yy < std::min(d.height, (y + 1) * scale); ++yy)
+                for(std::uint32_t xx = x * scale; xx < std::min(d.width, (x + 1) * scale); ++xx, ++cnt)
+                  sum += image[(yy * d.width + xx) * d.channels + k];
+              CHECK(actual[(y * desc.width + x) * d.channels + k] == (sum + cnt / 2) / cnt);
+            }
+      }
+    }
+  }
+  SUBCASE("invalid scale"){
+    const std::vector<std::uint8_t> image(4 * 4 * 3);
+    const auto encoded = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, {.width = 4, .height = 4, .channels = 3, .colorspace = qoixx::qoi::colorspace::srgb});
+    CHECK_THROWS_AS(qoixx::qoi::decode_downscaled<std::vector<std::uint8_t>>(encoded, 3), std::invalid_argument);
+  }
+}
+
+TEST_CASE("decoder selection"){
+  const qoixx::qoi::desc d{.width = 37, .height = 23, .channels = 4, .colorspace = qoixx::qoi::colorspace::srgb};
+  const auto image = make_image(d, 4321, pattern::drift);
+  const auto encoded = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+  const decoder_guard guard;
+  qoixx::qoi::set_decoder(qoixx::qoi::decoder::tables);
+  const auto downscaled = qoixx::qoi::decode_downscaled<std::vector<std::uint8_t>>(encoded, 2).first;
+  for_each_decoder([&]{
+    CHECK(qoixx::qoi::decode_downscaled<std::vector<std::uint8_t>>(encoded, 2).first == downscaled);
+    for(std::uint8_t channels = 3; channels <= 4; ++channels){
+      const auto [actual, desc] = qoixx::qoi::decode<std::vector<std::uint8_t>>(encoded, channels);
+      REQUIRE(actual.size() == d.width * d.height * channels);
+      for(std::size_t i = 0; i < d.width * d.height; ++i)
+        CHECK(std::memcmp(actual.data() + i * channels, image.data() + i * d.channels, channels) == 0);
+    }
+    CHECK(qoixx::qoi::get_decoder() != qoixx::qoi::decoder::automatic);
+  }, {qoixx::qoi::decoder::tables, qoixx::qoi::decoder::arithmetic, qoixx::qoi::decoder::dispatch, qoixx::qoi::decoder::automatic});
+  // which decoder wins depends on the machine, so only the contract is checked: calibration selects the decoder it returns
+  const auto calibrated = qoixx::qoi::calibrate_decoder();
+  CHECK(calibrated != qoixx::qoi::decoder::automatic);
+  CHECK(qoixx::qoi::get_decoder() == calibrated);
+}
+
+TEST_CASE("streaming decode"){
+  const qoixx::qoi::desc d{.width = 211, .height = 67, .channels = 3, .colorspace = qoixx::qoi::colorspace::srgb};
+  const auto image = make_image(d, 8765, pattern::drift);
+  const auto encoded = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+  const auto original_threshold = qoixx::qoi::get_streaming_threshold();
+  qoixx::qoi::set_streaming_threshold(0);
+  for_each_decoder([&]{
+    for(std::uint8_t channels = 3; channels <= 4; ++channels){
+      const auto [actual, desc] = qoixx::qoi::decode<std::vector<std::uint8_t>>(encoded, channels);
+      REQUIRE(actual.size() == d.width * d.height * channels);
+      for(std::size_t i = 0; i < d.width * d.height; ++i)
+        CHECK(std::memcmp(actual.data() + i * channels, image.data() + i * d.channels, d.channels) == 0);
+    }
+  });
+  qoixx::qoi::set_streaming_threshold(original_threshold);
+}
+
+TEST_CASE("allocator aware output"){
+  const qoixx::qoi::desc d{.width = 29, .height = 17, .channels = 3, .colorspace = qoixx::qoi::colorspace::srgb};
+  const auto image = make_image(d, 2468, pattern::repeats);
+  const auto expected = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+  // the arena never falls back to the heap: null_memory_resource throws on any upstream allocation
+  alignas(std::max_align_t) static std::byte buffer[1 << 16];
+  std::pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer), std::pmr::null_memory_resource()};
+  const auto in_arena = [&](const void* p){
+    return static_cast<const std::byte*>(p) >= buffer && static_cast<const std::byte*>(p) < buffer + sizeof(buffer);
+  };
+  const auto encoded = qoixx::qoi::encode<std::pmr::vector<std::uint8_t>>(image, d, &arena);
+  CHECK(in_arena(encoded.data()));
+  CHECK(equals(encoded, expected));
+  CHECK(equals(qoixx::qoi::encode<std::pmr::vector<std::uint8_t>>(image.data(), image.size(), d, &arena), expected));
+  {
+    const auto [actual, desc] = qoixx::qoi::decode<std::pmr::vector<std::uint8_t>>(encoded, 0, &arena);
+    CHECK(d == desc);
+    CHECK(in_arena(actual.data()));
+    CHECK(equals(actual, image));
+  }
+  {
+    const auto [actual, desc] = qoixx::qoi::decode<std::pmr::vector<std::uint8_t>>(expected.data(), expected.size(), 4, std::pmr::polymorphic_allocator<std::uint8_t>{&arena});
+    REQUIRE(actual.size() == d.width * d.height * 4);
+    CHECK(in_arena(actual.data()));
+    for(std::size_t i = 0; i < d.width * d.height; ++i){
+      CHECK(std::memcmp(actual.data() + i * 4, image.data() + i * d.channels, d.channels) == 0);
+      CHECK(actual[i * 4 + 3] == 255);
+    }
+  }
+  {
+    const auto [actual, desc] = qoixx::qoi::decode<std::array<std::pmr::vector<std::uint8_t>, 3>>(encoded, 0, &arena);
+    const auto planes = split_planes<3>(image);
+    for(std::size_t i = 0; i < planes.size(); ++i){
+      CHECK(in_arena(actual[i].data()));
+      CHECK(equals(actual[i], planes[i]));
+    }
+  }
+}
+
+TEST_CASE("frame encoder and decoder"){
+  qoixx::qoi::frame_encoder encoder;
+  qoixx::qoi::frame_decoder decoder;
+  const std::uint8_t* encoded_buffer = nullptr;
+  const std::uint8_t* decoded_buffer = nullptr;
+  for(std::uint32_t frame = 0; frame < 6; ++frame){
+    const qoixx::qoi::desc d{.width = frame < 4 ? 31u : 13u, .height = 19, .channels = static_cast<std::uint8_t>(frame % 2 ? 4 : 3), .colorspace = qoixx::qoi::colorspace::srgb};
+    const auto image = make_image(d, 1357 + frame, pattern::repeats);
+    const auto expected = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+    const auto encoded = encoder.encode(image, d);
+    CHECK(std::ranges::equal(encoded, expected));
+    const auto [decoded, desc] = decoder.decode(expected);
+    CHECK(d == desc);
+    CHECK(std::ranges::equal(decoded, image));
+    // the buffers were sized by the first frames and are reused for the same and smaller frames
+    if(frame >= 2){
+      CHECK(encoded.data() == encoded_buffer);
+      CHECK(decoded.data() == decoded_buffer);
+    }
+    encoded_buffer = encoded.data();
+    decoded_buffer = decoded.data();
+    CHECK(std::ranges::equal(encoder.encode(image.data(), image.size(), d), expected));
+    const auto [rgba, rgba_desc] = decoder.decode(expected.data(), expected.size(), 4);
+    REQUIRE(rgba.size() == d.width * d.height * 4);
+  }
+}
+
+TEST_CASE("near lossless encode"){
+  for(std::uint8_t channels = 3; channels <= 4; ++channels){
+    const qoixx::qoi::desc d{.width = 53, .height = 41, .channels = channels, .colorspace = qoixx::qoi::colorspace::srgb};
+    const auto image = make_image(d, 97531, pattern::walk);
+    const auto lossless = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+    CHECK(qoixx::qoi::encode_near_lossless<std::vector<std::uint8_t>>(image, d, {}) == lossless);
+    const qoixx::qoi::tolerance tol{.r = 2, .g = 1, .b = 3, .a = 2};
+    const std::uint8_t limits[4] = {tol.r, tol.g, tol.b, tol.a};
+    const auto encoded = qoixx::qoi::encode_near_lossless<std::vector<std::uint8_t>>(image.data(), image.size(), d, tol);
+    CHECK(encoded.size() < lossless.size());
+    const auto [actual, desc] = qoixx::qoi::decode<std::vector<std::uint8_t>>(encoded);
+    CHECK(d == desc);
+    REQUIRE(actual.size() == image.size());
+    for(std::size_t i = 0; i < image.size(); ++i)
+      CHECK(std::abs(static_cast<int>(actual[i]) - static_cast<int>(image[i])) <= limits[i % d.channels]);
+  }
+  SUBCASE("nearly transparent black"){
+    // pixels within the tolerance of the zeroed index slots, which must not be referenced before they are written
+    const qoixx::qoi::desc d{.width = 37, .height = 23, .channels = 4, .colorspace = qoixx::qoi::colorspace::srgb};
+    const auto image = make_image(d, 2468, pattern::near_black);
+    const qoixx::qoi::tolerance tol{.r = 2, .g = 2, .b = 3, .a = 0};
+    const std::uint8_t limits[4] = {tol.r, tol.g, tol.b, tol.a};
+    const auto encoded = qoixx::qoi::encode_near_lossless<std::vector<std::uint8_t>>(image, d, tol);
+    for_each_decoder([&]{
+      const auto actual = qoixx::qoi::decode<std::vector<std::uint8_t>>(encoded).first;
+      REQUIRE(actual.size() == image.size());
+      bool within = true;
+      for(std::size_t i = 0; i < image.size(); ++i)
+        within = within && std::abs(static_cast<int>(actual[i]) - static_cast<int>(image[i])) <= limits[i % d.channels];
+      CHECK(within);
+    });
+  }
+}
+
+TEST_CASE("qoi+lz container"){
+  const qoixx::qoi::desc d{.width = 331, .height = 157, .channels = 4, .colorspace = qoixx::qoi::colorspace::srgb};
+  const auto image = make_image(d, 2718, pattern::periodic);
+  const auto plain = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+  const auto encoded = qoixx::qoi::encode_lz<std::vector<std::uint8_t>>(image, d);
+  CHECK(encoded.size() < plain.size());
+  CHECK(qoixx::qoi::encode_lz<std::vector<std::uint8_t>>(image.data(), image.size(), d) == encoded);
+  for(std::uint8_t channels = 3; channels <= 4; ++channels){
+    const auto [expected, expected_desc] = qoixx::qoi::decode<std::vector<std::uint8_t>>(plain, channels);
+    const auto [actual, desc] = qoixx::qoi::decode_lz<std::vector<std::uint8_t>>(encoded, channels);
+    CHECK(d == desc);
+    CHECK(expected == actual);
+  }
+  const auto [actual, desc] = qoixx::qoi::decode_lz<std::vector<std::uint8_t>>(encoded.data(), encoded.size());
+  CHECK(d == desc);
+  CHECK(image == actual);
+  CHECK_THROWS_AS(qoixx::qoi::decode_lz<std::vector<std::uint8_t>>(plain), std::runtime_error);
+  CHECK_THROWS_AS(qoixx::qoi::decode_lz<std::vector<std::uint8_t>>(encoded.data(), encoded.size() / 2), std::runtime_error);
+}
+
+TEST_CASE("frame sequence"){
+  for(std::uint8_t channels = 3; channels <= 4; ++channels){
+    const qoixx::qoi::desc d{.width = 97, .height = 61, .channels = channels, .colorspace = qoixx::qoi::colorspace::srgb};
+    std::vector<std::vector<std::uint8_t>> frames(1, make_image(d, 4242, pattern::repeats));
+    lcg rng{4242};
+    for(std::size_t f = 1; f < 7; ++f){
+      frames.push_back(frames.back());
+      for(std::size_t y = 5*f; y < 5*f + 9; ++y)
+        for(std::size_t x = 7*f; x < 7*f + 13; ++x){
+          const auto seed = rng();
+          frames.back()[(y*d.width + x)*d.channels + seed % d.channels] ^= static_cast<std::uint8_t>(seed >> 16 | 1);
+        }
+    }
+
+    qoixx::qoi::sequence_encoder encoder{d, 3};
+    std::vector<std::uint8_t> stream(encoder.header().begin(), encoder.header().end());
+    std::vector<std::size_t> sizes;
+    for(std::size_t f = 0; f < frames.size(); ++f){
+      const auto encoded = f % 2 == 0 ? encoder.encode(frames[f]) : encoder.encode(frames[f].data(), frames[f].size());
+      sizes.push_back(encoded.size());
+      stream.insert(stream.end(), encoded.begin(), encoded.end());
+      if(f == 0 || f % 3 == 0)
+        continue;
+      auto delta = frames[f];
+      for(std::size_t i = 0; i < delta.size(); ++i)
+        delta[i] ^= frames[f-1][i];
+      const auto expected = qoixx::qoi::encode<std::vector<std::uint8_t>>(delta, d);
+      CHECK(std::equal(encoded.begin() + 4, encoded.end(), expected.begin() + 14, expected.end()));
+    }
+    CHECK(sizes[1] * 10 < sizes[0]);
+
+    qoixx::qoi::sequence_decoder decoder{stream};
+    CHECK(decoder.description() == d);
+    REQUIRE(decoder.frame_count() == frames.size());
+    for(std::size_t f = 0; f < frames.size(); ++f)
+      CHECK(decoder.is_keyframe(f) == (f % 3 == 0));
+    for(std::size_t f : {0u, 1u, 2u, 5u, 4u, 6u, 6u, 1u}){
+      const auto frame = decoder.decode(f);
+      CHECK(std::equal(frame.begin(), frame.end(), frames[f].begin(), frames[f].end()));
+    }
+    CHECK_THROWS_AS(decoder.decode(frames.size()), std::invalid_argument);
+    CHECK_THROWS_AS((qoixx::qoi::sequence_decoder{stream.data(), stream.size() - 3}), std::runtime_error);
+  }
+}
+
+TEST_CASE("gray image"){
+  for(std::uint8_t channels = 1; channels <= 2; ++channels){
+    const qoixx::qoi::desc d{.width = 77, .height = 45, .channels = channels, .colorspace = qoixx::qoi::colorspace::srgb};
+    const auto image = make_image(d, 1234, pattern::gradient);
+    const qoixx::qoi::desc expanded_desc{.width = d.width, .height = d.height, .channels = static_cast<std::uint8_t>(channels + 2), .colorspace = d.colorspace};
+    std::vector<std::uint8_t> expanded;
+    for(std::size_t i = 0; i < image.size(); i += d.channels){
+      expanded.insert(expanded.end(), 3, image[i]);
+      if(channels == 2)
+        expanded.push_back(image[i+1]);
+    }
+
+    const auto encoded = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+    CHECK(encoded == qoixx::qoi::encode<std::vector<std::uint8_t>>(expanded, expanded_desc));
+    CHECK(encoded == qoixx::qoi::encode<std::vector<std::uint8_t>>(image.data(), image.size(), d));
+    const auto [actual, desc] = qoixx::qoi::decode<std::vector<std::uint8_t>>(encoded, channels);
+    CHECK(desc == expanded_desc);
+    CHECK(actual == image);
+    for_each_decoder([&]{
+      CHECK(qoixx::qoi::decode<std::vector<std::uint8_t>>(encoded.data(), encoded.size(), channels).first == image);
+    });
+
+    expanded[expanded_desc.channels * 1000 + 1] ^= 1;
+    const auto colored = qoixx::qoi::encode<std::vector<std::uint8_t>>(expanded, expanded_desc);
+    CHECK_THROWS_AS(qoixx::qoi::decode<std::vector<std::uint8_t>>(colored, channels), std::runtime_error);
+  }
+}
+
+TEST_CASE("statistics"){
+  const qoixx::qoi::desc d{.width = 123, .height = 37, .channels = 4, .colorspace = qoixx::qoi::colorspace::srgb};
+  const std::size_t px_len = d.width * d.height;
+  const auto image = make_image(d, 42, pattern::gradient);
+
+  qoixx::qoi::take_stats();
+  const auto encoded = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+  const auto encode_stats = qoixx::qoi::take_stats();
+  if constexpr(!qoixx::qoi::stats_enabled){
+    CHECK(encode_stats == qoixx::qoi::stats{});
+    return;
+  }
+  const auto decoded_pixels = [](const qoixx::qoi::stats& st){
+    std::uint64_t px = st.index + st.diff + st.luma + st.rgb + st.rgba;
+    for(std::size_t i = 0; i < st.run_lengths.size(); ++i)
+      px += st.run_lengths[i] * (i+1);
+    return px;
+  };
+  CHECK(decoded_pixels(encode_stats) == px_len);
+  CHECK(encode_stats.simd_pixels + encode_stats.scalar_pixels == px_len);
+  CHECK(encode_stats.run_blocks <= encode_stats.simd_blocks);
+  CHECK(encode_stats.rgba > 0);
+  CHECK(encode_stats.run > 0);
+
+  const auto chunks_of = [](qoixx::qoi::stats st){
+    st.simd_pixels = st.scalar_pixels = st.simd_blocks = st.run_blocks = 0;
+    return st;
+  };
+  const auto chunks = chunks_of(encode_stats);
+  for_each_decoder([&]{
+    CHECK(qoixx::qoi::decode<std::vector<std::uint8_t>>(encoded).first == image);
+    CHECK(qoixx::qoi::take_stats() == chunks);
+  });
+
+  // the other encoders count the chunks they write as well
+  const auto lz = qoixx::qoi::encode_lz<std::vector<std::uint8_t>>(image, d);
+  const auto lz_stats = qoixx::qoi::take_stats();
+  CHECK(lz_stats.simd_pixels + lz_stats.scalar_pixels == px_len);
+  CHECK(chunks_of(lz_stats) == chunks);
+
+  const auto near_lossless = qoixx::qoi::encode_near_lossless<std::vector<std::uint8_t>>(image, d, {.r = 2, .g = 2, .b = 2, .a = 0});
+  const auto near_lossless_stats = qoixx::qoi::take_stats();
+  CHECK(near_lossless_stats.scalar_pixels == px_len);
+  CHECK(decoded_pixels(near_lossless_stats) == px_len);
+  qoixx::qoi::decode<std::vector<std::uint8_t>>(near_lossless);
+  CHECK(qoixx::qoi::take_stats() == chunks_of(near_lossless_stats));
+
+  auto modified = image;
+  modified[(20 * d.width + 7) * d.channels] ^= 0x55;
+  const auto incremental = qoixx::qoi::encode_incremental<std::vector<std::uint8_t>>(modified, d, encoded, std::vector<int>{20});
+  const auto incremental_stats = qoixx::qoi::take_stats();
+  CHECK(incremental == qoixx::qoi::encode<std::vector<std::uint8_t>>(modified, d));
+  qoixx::qoi::take_stats();
+  CHECK(incremental_stats.simd_pixels + incremental_stats.scalar_pixels > 0);
+  CHECK(decoded_pixels(incremental_stats) == incremental_stats.simd_pixels + incremental_stats.scalar_pixels);
+}
+
+TEST_CASE("compare"){
+  const qoixx::qoi::desc d{.width = 67, .height = 23, .channels = 4, .colorspace = qoixx::qoi::colorspace::srgb};
+  const auto image = make_image(d, 42, pattern::stripes);
+  const auto encoded = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+  SUBCASE("identical streams"){
+    const auto copied = encoded;
+    CHECK(qoixx::qoi::compare(encoded, copied) == std::nullopt);
+    CHECK(qoixx::qoi::compare(encoded.data(), encoded.size(), copied.data(), copied.size()) == std::nullopt);
+  }
+  SUBCASE("first differing pixel"){
+    for(std::size_t px : {0u, 1u, 31u, 32u, 777u, 67u*23u-1u}){
+      auto modified = image;
+      modified[px*d.channels+1] ^= 0x10;
+      const auto other = qoixx::qoi::encode<std::vector<std::uint8_t>>(modified, d);
+      CHECK(qoixx::qoi::compare(encoded, other) == px);
+      CHECK(qoixx::qoi::compare(other, encoded) == px);
+    }
+  }
+  SUBCASE("different dimensions"){
+    const auto other = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, {.width = 23, .height = 67, .channels = 4, .colorspace = qoixx::qoi::colorspace::srgb});
+    CHECK(qoixx::qoi::compare(encoded, other) == 0u);
+  }
+  SUBCASE("same pixels with different chunks"){
+    const std::vector<std::uint8_t> rgb = {
+      113, 111, 105, 102, 0, 0, 0, 3, 0, 0, 0, 1, 3, 0,
+      254, 1, 1, 1, 254, 5, 5, 5, 0b0100'0000 | 2 << 4 | 2 << 2 | 2,
+      0, 0, 0, 0, 0, 0, 0, 1
+    };
+    const std::vector<std::uint8_t> diff = {
+      113, 111, 105, 102, 0, 0, 0, 3, 0, 0, 0, 1, 3, 0,
+      0b0100'0000 | 3 << 4 | 3 << 2 | 3, 254, 5, 5, 5, 0b1100'0000,
+      0, 0, 0, 0, 0, 0, 0, 1
+    };
+    auto changed = diff;
+    changed[17] = 6;
+    CHECK(qoixx::qoi::compare(rgb, diff) == std::nullopt);
+    CHECK(qoixx::qoi::compare(rgb, changed) == 1u);
+  }
+}
+
+TEST_CASE("incremental encode"){
+  for(std::uint8_t channels : {3, 4}){
+    const qoixx::qoi::desc d{.width = 53, .height = 29, .channels = channels, .colorspace = qoixx::qoi::colorspace::srgb};
+    const auto image = make_image(d, 7, pattern::stripes);
+    const auto previous = qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d);
+    SUBCASE(("channels " + std::to_string(+channels) + ", no dirty rows").c_str()){
+      CHECK(qoixx::qoi::encode_incremental<std::vector<std::uint8_t>>(image, d, previous, std::vector<int>{}) == previous);
+    }
+    SUBCASE(("channels " + std::to_string(+channels) + ", modified rows").c_str()){
+      for(const auto& rows : std::vector<std::vector<int>>{{0}, {3}, {11, 12, 13}, {28}, {20, 5}, {0, 28}}){
+        auto modified = image;
+        for(auto y : rows)
+          for(std::size_t x = 0; x < d.width; x += 3)
+            modified[(y*d.width+x)*d.channels] ^= 0x21;
+        const auto full = qoixx::qoi::encode<std::vector<std::uint8_t>>(modified, d);
+        CHECK(qoixx::qoi::encode_incremental<std::vector<std::uint8_t>>(modified, d, previous, rows) == full);
+      }
+    }
+    SUBCASE(("channels " + std::to_string(+channels) + ", resolution change").c_str()){
+      const qoixx::qoi::desc other{.width = d.height, .height = d.width, .channels = d.channels, .colorspace = d.colorspace};
+      CHECK(qoixx::qoi::encode_incremental<std::vector<std::uint8_t>>(image, other, previous, std::vector<int>{0}) == qoixx::qoi::encode<std::vector<std::uint8_t>>(image, other));
+    }
+    SUBCASE(("channels " + std::to_string(+channels) + ", out of range row").c_str()){
+      CHECK_THROWS_AS(qoixx::qoi::encode_incremental<std::vector<std::uint8_t>>(image, d, previous, std::vector<int>{29}), std::invalid_argument);
+      CHECK_THROWS_AS(qoixx::qoi::encode_incremental<std::vector<std::uint8_t>>(image, d, previous, std::vector<int>{-1}), std::invalid_argument);
+    }
+  }
+}
+
+template<std::uint8_t Channels>
+static constexpr std::array<std::uint8_t, 41*29*Channels> static_image(){
+  std::array<std::uint8_t, 41*29*Channels> image = {};
+  lcg rng{99};
+  for(std::size_t i = 0; i < image.size(); ++i){
+    const auto seed = rng();
+    const auto px = i / Channels;
+    if(px % 200 < 90)
+      image[i] = static_cast<std::uint8_t>(px / 200);
+    else if((seed >> 30) == 0)
+      image[i] = static_cast<std::uint8_t>(seed >> 16);
+    else
+      image[i] = static_cast<std::uint8_t>(px % 17 + (i % Channels == 1 ? 0 : seed >> 29));
+  }
+  return image;
+}
+template<std::uint8_t Channels>
+static constexpr qoixx::qoi::desc static_desc{41, 29, Channels, qoixx::qoi::colorspace::linear};
+static constexpr auto static_image_1 = static_image<1>();
+static constexpr auto static_image_2 = static_image<2>();
+static constexpr auto static_image_3 = static_image<3>();
+static constexpr auto static_image_4 = static_image<4>();
+static constexpr auto static_qoi_1 = qoixx::qoi::static_encode<static_image_1, static_desc<1>>();
+static constexpr auto static_qoi_2 = qoixx::qoi::static_encode<static_image_2, static_desc<2>>();
+static constexpr auto static_qoi_3 = qoixx::qoi::static_encode<static_image_3, static_desc<3>>();
+static constexpr auto static_qoi_4 = qoixx::qoi::static_encode<static_image_4, static_desc<4>>();
+static_assert(qoixx::qoi::static_decode<static_qoi_1, 1>().first == static_image_1);
+static_assert(qoixx::qoi::static_decode<static_qoi_2, 2>().first == static_image_2);
+static_assert(qoixx::qoi::static_decode<static_qoi_3>().first == static_image_3);
+static_assert(qoixx::qoi::static_decode<static_qoi_4>().first == static_image_4);
+static_assert(qoixx::qoi::static_decode<static_qoi_4>().second == qoixx::qoi::desc{41, 29, 4, qoixx::qoi::colorspace::linear});
+
+TEST_CASE("compile-time encode and decode"){
+  const auto check = [](const auto& image, const auto& qoi, const qoixx::qoi::desc& d){
+    CHECK(equals(qoixx::qoi::encode<std::vector<std::uint8_t>>(image, d), qoi));
+    const auto [actual, desc] = qoixx::qoi::decode<std::vector<std::uint8_t>>(qoi, d.channels);
+    CHECK(equals(actual, image));
+    CHECK(desc.colorspace == d.colorspace);
+  };
+  check(static_image_1, static_qoi_1, static_desc<1>);
+  check(static_image_2, static_qoi_2, static_desc<2>);
+  check(static_image_3, static_qoi_3, static_desc<3>);
+  check(static_image_4, static_qoi_4, static_desc<4>);
+
+  static constexpr auto rgb = qoixx::qoi::static_decode<static_qoi_4, 3>();
+  static constexpr auto rgba = qoixx::qoi::static_decode<static_qoi_3, 4>();
+  std::vector<std::uint8_t> stripped;
+  for(std::size_t i = 0; i < static_image_4.size(); ++i)
+    if(i % 4 != 3)
+      stripped.push_back(static_image_4[i]);
+  CHECK(equals(rgb.first, stripped));
+  CHECK(equals(rgba.first, qoixx::qoi::decode<std::vector<std::uint8_t>>(static_qoi_3, 4).first));
+  static constexpr std::uint8_t icon[] = {
+    113, 111, 105, 102, 0, 0, 0, 2, 0, 0, 0, 1, 3, 0, 254, 10, 20, 30, 0xc0, 0, 0, 0, 0, 0, 0, 0, 1,
+  };
+  static constexpr auto decoded = qoixx::qoi::static_decode<icon>();
+  CHECK(decoded.first == std::array<std::uint8_t, 6>{10, 20, 30, 10, 20, 30});
+}
+
+TEST_CASE("tile codec"){
+  const auto check = []<std::uint32_t Width, std::uint32_t Height, std::uint8_t Channels>(){
+    using codec = qoixx::qoi::tile_codec<Width, Height, Channels>;
+    const auto image = make_image(codec::tile_desc, Width * 7 + Height + Channels, pattern::gradient);
+    std::vector<std::uint8_t> encoded(codec::max_encoded_size);
+    const auto size = codec::encode(image, std::span<std::uint8_t, codec::max_encoded_size>{encoded});
+    encoded.resize(size);
+    CHECK(encoded == qoixx::qoi::encode<std::vector<std::uint8_t>>(image, codec::tile_desc));
+    std::vector<std::uint8_t> decoded(codec::pixels_size);
+    codec::decode(encoded, std::span<std::uint8_t, codec::pixels_size>{decoded});
+    CHECK(decoded == image);
+    return encoded;
+  };
+  const auto tile = check.template operator()<64, 64, 4>();
+  check.template operator()<64, 64, 3>();
+  check.template operator()<13, 7, 4>();
+  check.template operator()<1, 1, 3>();
+  check.template operator()<19, 5, 1>();
+  check.template operator()<19, 5, 2>();
+
+  using codec = qoixx::qoi::tile_codec<32, 128, 4>;
+  std::vector<std::uint8_t> out(codec::pixels_size);
+  CHECK_THROWS_AS(codec::decode(tile, std::span<std::uint8_t, codec::pixels_size>{out}), std::runtime_error);
+  std::vector<std::uint8_t> encoded(codec::max_encoded_size);
+  CHECK_THROWS_AS(codec::encode(std::vector<std::uint8_t>(codec::pixels_size - 1), std::span<std::uint8_t, codec::max_encoded_size>{encoded}), std::invalid_argument);
 }